@@ -0,0 +1,121 @@
+
+//==================================================
+// @title        bench.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "jmx.h"
+#include "host.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+/**
+ * Benchmarks of jmx outside Matlab, on the host runtime (see host.h):
+ *
+ *      jmx_bench [n=1000000] [repeat=20]
+ *
+ * Each case runs the same code paths as in a Mex file, and prints the median and minimum
+ * time over repetitions. Build with -DJMX_PROFILE=ON to also print the profiler report.
+ */
+
+// y = sqrt(abs(x)), in parallel
+void mexFunction( int nargout, mxArray *out[], int nargin, const mxArray *in[] )
+{
+    Arguments args( nargout, out, nargin, in );
+    args.verify( 1, 1, [](){ println("Usage: y = gateway(x)"); } );
+
+    auto x = args.getvec<double>(0);
+    auto y = get_vector_rw<double>( args.out.assign( 0, make_vector(x.numel(),true) ) );
+    parallel_for( 0, x.numel(), [&]( index_t i ) { y[i] = std::sqrt(std::abs(x[i])); } );
+}
+
+// ----------  =====  ----------
+
+template <class F>
+void bench( const char *name, index_t repeat, F&& fn )
+{
+    using clock_t = std::chrono::steady_clock;
+
+    std::vector<double> t;
+    for ( index_t r = 0; r < repeat; ++r )
+    {
+        const clock_t::time_point start = clock_t::now();
+        fn();
+        t.push_back( std::chrono::duration<double,std::milli>( clock_t::now() - start ).count() );
+    }
+
+    std::sort( t.begin(), t.end() );
+    std::printf( "%-24s %10.3f ms  (min %.3f)\n", name, t[t.size()/2], t.front() );
+}
+
+int main( int argc, char *argv[] )
+{
+    const index_t n = argc > 1 ? std::strtoull( argv[1], nullptr, 10 ) : 1000000;
+    const index_t repeat = argc > 2 ? std::max<index_t>( std::strtoull( argv[2], nullptr, 10 ), 1 ) : 20;
+
+    host::catch_sigint();
+    host::set_name( "jmx_bench" );
+    host::define( "square", []( int, mxArray **lhs, int, mxArray **rhs ) {
+        const index_t m = mxGetNumberOfElements(rhs[0]);
+        const double *x = mxGetPr(rhs[0]);
+        lhs[0] = mxCreateDoubleMatrix( m, 1, mxREAL );
+        double *y = mxGetPr(lhs[0]);
+        for ( index_t i = 0; i < m; ++i ) y[i] = x[i]*x[i];
+    });
+
+    mxArray *x = make_vector( n, true );
+    {
+        auto v = get_vector_rw<double>(x);
+        for ( index_t i = 0; i < n; ++i ) v[i] = std::sin(static_cast<double>(i));
+    }
+
+    std::printf( "n = %zu, repeat = %zu, threads = %zu\n\n", n, repeat, runtime().nthreads() );
+
+    bench( "gateway (parallel_for)", repeat, [&]() {
+        auto y = host::call( mexFunction, 1, {x} );
+        mxDestroyArray( y[0] );
+    });
+
+    bench( "make_matrix", repeat, [&]() {
+        mxDestroyArray( make_matrix(n,1) );
+    });
+
+    bench( "get_vector (sum)", repeat, [&]() {
+        auto v = get_vector<double>(x);
+        double s = 0;
+        for ( index_t i = 0; i < n; ++i ) s += v[i];
+        volatile double r = s; (void) r;
+    });
+
+    bench( "make_struct", repeat, [&]() {
+        mxArray *s = make_struct( {"a","b","c"}, 1, std::min<index_t>(n,10000) );
+        mxDestroyArray(s);
+    });
+
+    mxArray *h = host::make_function_handle( "square" );
+    std::vector<double> y(n);
+    bench( "callback (batched)", repeat, [&]() {
+        Callback f(h);
+        f.map( mxGetPr(x), y.data(), n );
+    });
+    mxDestroyArray(h);
+
+#ifdef JMX_PROFILE
+    std::printf( "\n" );
+    for ( auto& e: profile_report() )
+        std::printf( "%-24s %10zu calls %10.3f ms\n", e.name.c_str(), e.count, 1e3*e.total );
+#endif
+
+    mxDestroyArray(x);
+    host::exit();
+    return 0;
+}
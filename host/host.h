@@ -0,0 +1,70 @@
+#ifndef JMX_HOST_HOST_H_INCLUDED
+#define JMX_HOST_HOST_H_INCLUDED
+
+//==================================================
+// @title        host.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "mex.h"
+
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Host runtime: the Matlab headers mex.h, matrix.h and mat.h are replaced by the files
+ * in this folder, and implemented in mx.cpp, so that jmx code builds as a normal
+ * executable (see CMakeLists.txt), and runs the same code paths as in Matlab:
+ *
+ *      #include "jmx.h"
+ *      #include "host.h"
+ *
+ *      int main() {
+ *          mxArray *x = mxCreateDoubleMatrix( 1000, 1, mxREAL );
+ *          auto out = host::call( mexFunction, 1, {x} );   // gateway of the Mex file
+ *          ...
+ *          host::exit();                                   // like "clear mex"
+ *      }
+ *
+ * Arrays behave like their Matlab counterparts (numeric, logical, char, cell, struct and
+ * sparse, with either complex API), except that memory is never freed automatically.
+ */
+namespace host {
+
+    // raised by mexErrMsgIdAndTxt
+    struct Error : public std::runtime_error
+    {
+        std::string id;
+        Error( const std::string& id, const std::string& msg )
+            : std::runtime_error(msg), id(id) {}
+    };
+
+    using gateway_t = void (*)( int, mxArray**, int, const mxArray** );
+    using function_t = std::function<void( int nlhs, mxArray **lhs, int nrhs, mxArray **rhs )>;
+
+    // call a gateway, and return its outputs
+    std::vector<mxArray*> call( gateway_t fn, int nargout, std::initializer_list<const mxArray*> in );
+
+    // functions called by mexCallMATLAB (or feval with a function handle)
+    void define( const std::string& name, function_t fn );
+    mxArray* make_function_handle( const std::string& name );
+
+    // state of utIsInterruptPending; catch_sigint sets it on Ctrl+C
+    void interrupt( bool pending=true );
+    void catch_sigint();
+
+    // name returned by mexFunctionName (default "host")
+    void set_name( const std::string& name );
+
+    // run the handlers registered with mexAtExit (also called when the process exits)
+    void exit();
+
+}
+
+#endif
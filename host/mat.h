@@ -0,0 +1,31 @@
+#ifndef JMX_HOST_MAT_H_INCLUDED
+#define JMX_HOST_MAT_H_INCLUDED
+
+//==================================================
+// @title        mat.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "matrix.h"
+
+// ------------------------------------------------------------------------
+
+/**
+ * Host stand-in for libmat. MAT-files cannot be read or written without Matlab:
+ * matOpen always fails, so MAT::open throws (use snapshots instead, see snapshot.h).
+ */
+
+typedef struct MATFile_tag MATFile;
+
+extern "C" {
+
+    MATFile* matOpen( const char *name, const char *mode );
+    int      matClose( MATFile *mf );
+    char**   matGetDir( MATFile *mf, int *num );
+    mxArray* matGetVariable( MATFile *mf, const char *name );
+    int      matPutVariable( MATFile *mf, const char *name, const mxArray *a );
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef JMX_HOST_MATRIX_H_INCLUDED
+#define JMX_HOST_MATRIX_H_INCLUDED
+
+//==================================================
+// @title        matrix.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <cstddef>
+#include <cstdint>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Host stand-in for the subset of libmx used by jmx, to build and benchmark jmx code
+ * without Matlab (see host.h). Types and signatures follow the Matlab headers.
+ *
+ * The complex API is selected with MX_HAS_INTERLEAVED_COMPLEX (defined to 1 by the CMake
+ * option JMX_INTERLEAVED, like -R2018a with mex), and must be the same for all files.
+ */
+
+#ifndef MX_HAS_INTERLEAVED_COMPLEX
+#define MX_HAS_INTERLEAVED_COMPLEX 0
+#endif
+
+typedef size_t      mwSize;
+typedef size_t      mwIndex;
+typedef ptrdiff_t   mwSignedIndex;
+typedef char16_t    mxChar;
+typedef bool        mxLogical;
+
+typedef struct mxArray_tag mxArray;
+
+typedef enum {
+    mxUNKNOWN_CLASS = 0,
+    mxCELL_CLASS,
+    mxSTRUCT_CLASS,
+    mxLOGICAL_CLASS,
+    mxCHAR_CLASS,
+    mxVOID_CLASS,
+    mxDOUBLE_CLASS,
+    mxSINGLE_CLASS,
+    mxINT8_CLASS,
+    mxUINT8_CLASS,
+    mxINT16_CLASS,
+    mxUINT16_CLASS,
+    mxINT32_CLASS,
+    mxUINT32_CLASS,
+    mxINT64_CLASS,
+    mxUINT64_CLASS,
+    mxFUNCTION_CLASS,
+    mxOPAQUE_CLASS,
+    mxOBJECT_CLASS,
+    mxINDEX_CLASS = mxUINT64_CLASS
+} mxClassID;
+
+typedef enum { mxREAL, mxCOMPLEX } mxComplexity;
+
+typedef struct { double real, imag; } mxComplexDouble;
+typedef struct { float real, imag; } mxComplexSingle;
+
+extern "C" {
+
+    // memory
+    void* mxCalloc( size_t n, size_t size );
+    void* mxMalloc( size_t n );
+    void* mxRealloc( void *ptr, size_t n );
+    void  mxFree( void *ptr );
+
+    // creation
+    void     mxDestroyArray( mxArray *a );
+    mxArray* mxDuplicateArray( const mxArray *a );
+
+    mxArray* mxCreateDoubleScalar( double val );
+    mxArray* mxCreateLogicalScalar( bool val );
+    mxArray* mxCreateString( const char *str );
+
+    mxArray* mxCreateDoubleMatrix( mwSize m, mwSize n, mxComplexity cplx );
+    mxArray* mxCreateNumericMatrix( mwSize m, mwSize n, mxClassID cls, mxComplexity cplx );
+    mxArray* mxCreateNumericArray( mwSize nd, const mwSize *dims, mxClassID cls, mxComplexity cplx );
+    mxArray* mxCreateUninitNumericMatrix( size_t m, size_t n, mxClassID cls, mxComplexity cplx );
+    mxArray* mxCreateUninitNumericArray( size_t nd, size_t *dims, mxClassID cls, mxComplexity cplx );
+    mxArray* mxCreateLogicalMatrix( mwSize m, mwSize n );
+    mxArray* mxCreateLogicalArray( mwSize nd, const mwSize *dims );
+    mxArray* mxCreateCharArray( mwSize nd, const mwSize *dims );
+
+    mxArray* mxCreateCellMatrix( mwSize m, mwSize n );
+    mxArray* mxCreateCellArray( mwSize nd, const mwSize *dims );
+    mxArray* mxCreateStructMatrix( mwSize m, mwSize n, int nfields, const char **fields );
+    mxArray* mxCreateStructArray( mwSize nd, const mwSize *dims, int nfields, const char **fields );
+
+    mxArray* mxCreateSparse( mwSize m, mwSize n, mwSize nzmax, mxComplexity cplx );
+    mxArray* mxCreateSparseLogicalMatrix( mwSize m, mwSize n, mwSize nzmax );
+
+    // data
+    void*    mxGetData( const mxArray *a );
+    void     mxSetData( mxArray *a, void *ptr );
+    double*  mxGetPr( const mxArray *a );
+    double*  mxGetPi( const mxArray *a );
+    void*    mxGetImagData( const mxArray *a );
+    mxComplexDouble* mxGetComplexDoubles( const mxArray *a );
+    mxComplexSingle* mxGetComplexSingles( const mxArray *a );
+    mxLogical* mxGetLogicals( const mxArray *a );
+    mxChar*  mxGetChars( const mxArray *a );
+
+    mwIndex* mxGetIr( const mxArray *a );
+    mwIndex* mxGetJc( const mxArray *a );
+    mwSize   mxGetNzmax( const mxArray *a );
+    void     mxSetIr( mxArray *a, mwIndex *ir );
+    void     mxSetJc( mxArray *a, mwIndex *jc );
+    void     mxSetNzmax( mxArray *a, mwSize n );
+
+    // dimensions
+    size_t   mxGetM( const mxArray *a );
+    size_t   mxGetN( const mxArray *a );
+    void     mxSetM( mxArray *a, mwSize m );
+    void     mxSetN( mxArray *a, mwSize n );
+    int      mxSetDimensions( mxArray *a, const mwSize *dims, mwSize nd );
+    mwSize   mxGetNumberOfDimensions( const mxArray *a );
+    const mwSize* mxGetDimensions( const mxArray *a );
+    size_t   mxGetNumberOfElements( const mxArray *a );
+    size_t   mxGetElementSize( const mxArray *a );
+
+    // class
+    mxClassID   mxGetClassID( const mxArray *a );
+    const char* mxGetClassName( const mxArray *a );
+    bool mxIsClass( const mxArray *a, const char *name );
+    bool mxIsNumeric( const mxArray *a );
+    bool mxIsLogical( const mxArray *a );
+    bool mxIsChar( const mxArray *a );
+    bool mxIsCell( const mxArray *a );
+    bool mxIsStruct( const mxArray *a );
+    bool mxIsDouble( const mxArray *a );
+    bool mxIsSingle( const mxArray *a );
+    bool mxIsComplex( const mxArray *a );
+    bool mxIsSparse( const mxArray *a );
+    bool mxIsEmpty( const mxArray *a );
+
+    // scalars and strings
+    double mxGetScalar( const mxArray *a );
+    int    mxGetString( const mxArray *a, char *buf, mwSize len );
+    char*  mxArrayToString( const mxArray *a );
+    char*  mxArrayToUTF8String( const mxArray *a );
+
+    // cells and structs
+    mxArray* mxGetCell( const mxArray *a, mwIndex i );
+    void     mxSetCell( mxArray *a, mwIndex i, mxArray *val );
+
+    int         mxGetNumberOfFields( const mxArray *a );
+    const char* mxGetFieldNameByNumber( const mxArray *a, int f );
+    int         mxGetFieldNumber( const mxArray *a, const char *name );
+    mxArray*    mxGetFieldByNumber( const mxArray *a, mwIndex i, int f );
+    void        mxSetFieldByNumber( mxArray *a, mwIndex i, int f, mxArray *val );
+    mxArray*    mxGetField( const mxArray *a, mwIndex i, const char *name );
+    void        mxSetField( mxArray *a, mwIndex i, const char *name, mxArray *val );
+    int         mxAddField( mxArray *a, const char *name );
+
+    // objects are structs on the host (e.g. MException, see mexCallMATLABWithTrap)
+    mxArray* mxGetProperty( const mxArray *a, mwIndex i, const char *name );
+
+}
+
+#endif
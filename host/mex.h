@@ -0,0 +1,46 @@
+#ifndef JMX_HOST_MEX_H_INCLUDED
+#define JMX_HOST_MEX_H_INCLUDED
+
+//==================================================
+// @title        mex.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "matrix.h"
+
+// ------------------------------------------------------------------------
+
+/**
+ * Host stand-in for the subset of libmex used by jmx (see host.h).
+ *
+ * Errors are raised as C++ exceptions (host::Error), calls to Matlab are dispatched to
+ * functions registered with host::define, and exit handlers run with host::exit (or when
+ * the process exits).
+ */
+
+extern "C" {
+
+    int  mexPrintf( const char *fmt, ... );
+    void mexErrMsgIdAndTxt( const char *id, const char *fmt, ... );
+    void mexErrMsgTxt( const char *msg );
+    void mexWarnMsgIdAndTxt( const char *id, const char *fmt, ... );
+
+    int  mexAtExit( void (*fn)(void) );
+    void mexLock( void );
+    void mexUnlock( void );
+    bool mexIsLocked( void );
+    void mexMakeArrayPersistent( mxArray *a );
+    void mexMakeMemoryPersistent( void *ptr );
+
+    int      mexCallMATLAB( int nlhs, mxArray **lhs, int nrhs, mxArray **rhs, const char *name );
+    mxArray* mexCallMATLABWithTrap( int nlhs, mxArray **lhs, int nrhs, mxArray **rhs, const char *name );
+
+    const char* mexFunctionName( void );
+
+    // gateway (defined by the Mex file, not by the host)
+    void mexFunction( int nargout, mxArray *out[], int nargin, const mxArray *in[] );
+
+}
+
+#endif
@@ -0,0 +1,843 @@
+
+//==================================================
+// @title        mx.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "host.h"
+#include "mat.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Arrays keep their dimensions, class and complexity, and point to buffers allocated with
+ * mxCalloc, such that mxSetData/mxSetIr/mxSetJc can take ownership of memory allocated by
+ * jmx, as in Matlab. Cells and structs store mxArray pointers (one per field and element
+ * for structs, field-major within each element), and function handles store a name.
+ */
+struct mxArray_tag
+{
+    mxClassID cls;
+    bool cplx, sparse;
+    std::vector<mwSize> dims;
+
+    void *data, *imag;      // imag is only used with the separate complex API
+    mwIndex *ir, *jc;
+    mwSize nzmax;
+
+    std::vector<std::string> fields;
+    std::string name;       // function handles
+
+    mxArray_tag()
+        : cls(mxUNKNOWN_CLASS), cplx(false), sparse(false), dims(2,0),
+          data(nullptr), imag(nullptr), ir(nullptr), jc(nullptr), nzmax(0) {}
+};
+
+// ----------  =====  ----------
+
+namespace {
+
+    size_t _elsize( mxClassID c )
+    {
+        switch (c)
+        {
+            case mxLOGICAL_CLASS:
+            case mxINT8_CLASS:
+            case mxUINT8_CLASS:
+                return 1;
+            case mxCHAR_CLASS:
+            case mxINT16_CLASS:
+            case mxUINT16_CLASS:
+                return 2;
+            case mxSINGLE_CLASS:
+            case mxINT32_CLASS:
+            case mxUINT32_CLASS:
+                return 4;
+            case mxCELL_CLASS:
+            case mxSTRUCT_CLASS:
+                return sizeof(mxArray*);
+            case mxDOUBLE_CLASS:
+            case mxINT64_CLASS:
+            case mxUINT64_CLASS:
+                return 8;
+            default:
+                return 0;
+        }
+    }
+
+    // bytes per value in the data buffer
+    size_t _valsize( const mxArray *a )
+    {
+        const size_t s = _elsize(a->cls);
+    #if MX_HAS_INTERLEAVED_COMPLEX
+        return a->cplx ? 2*s : s;
+    #else
+        return s;
+    #endif
+    }
+
+    size_t _numel( const mxArray *a )
+    {
+        size_t n = 1;
+        for ( auto d: a->dims ) n *= d;
+        return n;
+    }
+
+    // number of values in the data buffer
+    size_t _nvals( const mxArray *a )
+    {
+        if ( a->sparse ) return a->nzmax;
+        if ( a->cls == mxSTRUCT_CLASS ) return _numel(a) * a->fields.size();
+        return _numel(a);
+    }
+
+    bool _is_container( const mxArray *a )
+    {
+        return a->cls == mxCELL_CLASS || a->cls == mxSTRUCT_CLASS;
+    }
+
+    // trailing singleton dimensions are removed, and there are at least two
+    void _set_dims( mxArray *a, mwSize nd, const mwSize *dims )
+    {
+        a->dims.assign( dims, dims+nd );
+        while ( a->dims.size() > 2 && a->dims.back() == 1 ) a->dims.pop_back();
+        if ( a->dims.size() < 2 ) a->dims.resize(2,1);
+    }
+
+    mxArray* _create( mxClassID cls, mwSize nd, const mwSize *dims, mxComplexity cplx, bool init=true )
+    {
+        mxArray *a = new mxArray;
+        a->cls  = cls;
+        a->cplx = (cplx == mxCOMPLEX);
+        _set_dims( a, nd, dims );
+
+        const size_t n = _nvals(a);
+        a->data = init ? mxCalloc( n, _valsize(a) ) : mxMalloc( n*_valsize(a) );
+    #if !MX_HAS_INTERLEAVED_COMPLEX
+        if ( a->cplx ) a->imag = mxCalloc( n, _valsize(a) );
+    #endif
+        return a;
+    }
+
+    mxArray* _create_struct( mwSize nd, const mwSize *dims, int nfields, const char **fields )
+    {
+        mxArray *a = new mxArray;
+        a->cls = mxSTRUCT_CLASS;
+        _set_dims( a, nd, dims );
+        for ( int f = 0; f < nfields; ++f ) a->fields.push_back( fields[f] );
+        a->data = mxCalloc( _nvals(a), sizeof(mxArray*) );
+        return a;
+    }
+
+    mxArray* _create_sparse( mxClassID cls, mwSize m, mwSize n, mwSize nzmax, mxComplexity cplx )
+    {
+        mxArray *a = new mxArray;
+        a->cls    = cls;
+        a->cplx   = (cplx == mxCOMPLEX);
+        a->sparse = true;
+        a->dims   = { m, n };
+        a->nzmax  = nzmax ? nzmax : 1;
+
+        a->data = mxCalloc( a->nzmax, _valsize(a) );
+    #if !MX_HAS_INTERLEAVED_COMPLEX
+        if ( a->cplx ) a->imag = mxCalloc( a->nzmax, _valsize(a) );
+    #endif
+        a->ir = static_cast<mwIndex*>(mxCalloc( a->nzmax, sizeof(mwIndex) ));
+        a->jc = static_cast<mwIndex*>(mxCalloc( n+1, sizeof(mwIndex) ));
+        return a;
+    }
+
+    void* _copy( const void *src, size_t bytes )
+    {
+        if ( !src ) return nullptr;
+        void *dst = mxMalloc(bytes);
+        std::memcpy( dst, src, bytes );
+        return dst;
+    }
+
+    mxArray** _slots( const mxArray *a )
+    {
+        return static_cast<mxArray**>(a->data);
+    }
+
+    std::string _format( const char *fmt, va_list args )
+    {
+        va_list copy;
+        va_copy( copy, args );
+        const int n = std::vsnprintf( nullptr, 0, fmt, copy );
+        va_end(copy);
+
+        std::string out( n > 0 ? n : 0, '\0' );
+        if ( n > 0 ) std::vsnprintf( &out[0], n+1, fmt, args );
+        return out;
+    }
+
+    // ----------  =====  ----------
+
+    // process state
+    struct State
+    {
+        std::mutex mutex;
+        std::map<std::string, host::function_t> functions;
+        std::vector<void (*)(void)> exit_handlers;
+        std::string name;
+        int locks;
+
+        State() : name("host"), locks(0) {}
+    };
+
+    State& _state()
+    {
+        static State s;
+        return s;
+    }
+
+    std::atomic<bool>& _interrupt()
+    {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    void _on_sigint( int )
+    {
+        _interrupt() = true;
+    }
+
+    void _run_exit_handlers()
+    {
+        std::vector<void (*)(void)> handlers;
+        {
+            std::lock_guard<std::mutex> lock( _state().mutex );
+            handlers.swap( _state().exit_handlers );
+        }
+        for ( auto fn: handlers ) fn();
+    }
+
+    // feval with a function handle or a name, or a registered function
+    void _dispatch( int nlhs, mxArray **lhs, int nrhs, mxArray **rhs, const char *name )
+    {
+        std::string fname = name;
+        if ( fname == "feval" )
+        {
+            if ( nrhs < 1 )
+                throw host::Error( "MATLAB:minrhs", "Not enough input arguments." );
+            if ( mxIsChar(rhs[0]) ) {
+                char *str = mxArrayToString(rhs[0]);
+                fname = str;
+                mxFree(str);
+            }
+            else if ( mxIsClass(rhs[0],"function_handle") )
+                fname = rhs[0]->name;
+            else
+                throw host::Error( "MATLAB:feval:ArgType", "Argument must contain a string or function_handle." );
+            ++rhs; --nrhs;
+        }
+
+        host::function_t fn;
+        {
+            std::lock_guard<std::mutex> lock( _state().mutex );
+            auto it = _state().functions.find(fname);
+            if ( it == _state().functions.end() )
+                throw host::Error( "MATLAB:UndefinedFunction", "Undefined function '" + fname + "'." );
+            fn = it->second;
+        }
+        fn( nlhs, lhs, nrhs, rhs );
+    }
+
+    // MException stand-in
+    mxArray* _make_exception( const std::string& id, const std::string& msg )
+    {
+        const char *fields[] = { "identifier", "message" };
+        mxArray *err = mxCreateStructMatrix( 1, 1, 2, fields );
+        mxSetField( err, 0, "identifier", mxCreateString(id.c_str()) );
+        mxSetField( err, 0, "message", mxCreateString(msg.c_str()) );
+        return err;
+    }
+
+}
+
+// ------------------------------------------------------------------------
+
+namespace host {
+
+    std::vector<mxArray*> call( gateway_t fn, int nargout, std::initializer_list<const mxArray*> in )
+    {
+        std::vector<const mxArray*> rhs( in );
+        std::vector<mxArray*> lhs( nargout > 0 ? nargout : 1, nullptr );
+        fn( nargout, lhs.data(), static_cast<int>(rhs.size()), rhs.data() );
+        lhs.resize( nargout > 0 ? nargout : 0 );
+        return lhs;
+    }
+
+    void define( const std::string& name, function_t fn )
+    {
+        std::lock_guard<std::mutex> lock( _state().mutex );
+        _state().functions[name] = fn;
+    }
+
+    mxArray* make_function_handle( const std::string& name )
+    {
+        mxArray *a = new mxArray;
+        a->cls  = mxFUNCTION_CLASS;
+        a->dims = { 1, 1 };
+        a->name = name;
+        return a;
+    }
+
+    void interrupt( bool pending )
+    {
+        _interrupt() = pending;
+    }
+
+    void catch_sigint()
+    {
+        std::signal( SIGINT, _on_sigint );
+    }
+
+    void set_name( const std::string& name )
+    {
+        std::lock_guard<std::mutex> lock( _state().mutex );
+        _state().name = name;
+    }
+
+    void exit()
+    {
+        _run_exit_handlers();
+    }
+
+}
+
+// ------------------------------------------------------------------------
+
+extern "C" {
+
+    bool utIsInterruptPending()
+    {
+        return _interrupt();
+    }
+
+    // ----------  =====  ----------
+
+    void* mxCalloc( size_t n, size_t size )
+    {
+        return std::calloc( n ? n : 1, size ? size : 1 );
+    }
+
+    void* mxMalloc( size_t n )
+    {
+        return std::malloc( n ? n : 1 );
+    }
+
+    void* mxRealloc( void *ptr, size_t n )
+    {
+        return std::realloc( ptr, n ? n : 1 );
+    }
+
+    void mxFree( void *ptr )
+    {
+        std::free(ptr);
+    }
+
+    // ----------  =====  ----------
+
+    void mxDestroyArray( mxArray *a )
+    {
+        if ( !a ) return;
+        if ( _is_container(a) ) {
+            mxArray **p = _slots(a);
+            for ( size_t i = 0, n = _nvals(a); i < n; ++i ) mxDestroyArray( p[i] );
+        }
+        mxFree( a->data );
+        mxFree( a->imag );
+        mxFree( a->ir );
+        mxFree( a->jc );
+        delete a;
+    }
+
+    mxArray* mxDuplicateArray( const mxArray *a )
+    {
+        if ( !a ) return nullptr;
+
+        mxArray *b = new mxArray(*a);
+        const size_t n = _nvals(a);
+
+        if ( _is_container(a) ) {
+            b->data = mxCalloc( n, sizeof(mxArray*) );
+            for ( size_t i = 0; i < n; ++i ) _slots(b)[i] = mxDuplicateArray( _slots(a)[i] );
+        }
+        else {
+            b->data = _copy( a->data, n*_valsize(a) );
+            b->imag = _copy( a->imag, n*_valsize(a) );
+        }
+        if ( a->sparse ) {
+            b->ir = static_cast<mwIndex*>(_copy( a->ir, a->nzmax*sizeof(mwIndex) ));
+            b->jc = static_cast<mwIndex*>(_copy( a->jc, (a->dims[1]+1)*sizeof(mwIndex) ));
+        }
+        return b;
+    }
+
+    // ----------  =====  ----------
+
+    mxArray* mxCreateDoubleScalar( double val )
+    {
+        mxArray *a = mxCreateDoubleMatrix( 1, 1, mxREAL );
+        *static_cast<double*>(a->data) = val;
+        return a;
+    }
+
+    mxArray* mxCreateLogicalScalar( bool val )
+    {
+        mxArray *a = mxCreateLogicalMatrix( 1, 1 );
+        *static_cast<mxLogical*>(a->data) = val;
+        return a;
+    }
+
+    mxArray* mxCreateString( const char *str )
+    {
+        const size_t n = str ? std::strlen(str) : 0;
+        const mwSize dims[2] = { n ? 1u : 0u, n };
+        mxArray *a = mxCreateCharArray( 2, dims );
+        mxChar *p = mxGetChars(a);
+        for ( size_t i = 0; i < n; ++i ) p[i] = static_cast<unsigned char>(str[i]);
+        return a;
+    }
+
+    mxArray* mxCreateDoubleMatrix( mwSize m, mwSize n, mxComplexity cplx )
+    {
+        return mxCreateNumericMatrix( m, n, mxDOUBLE_CLASS, cplx );
+    }
+
+    mxArray* mxCreateNumericMatrix( mwSize m, mwSize n, mxClassID cls, mxComplexity cplx )
+    {
+        const mwSize dims[2] = { m, n };
+        return _create( cls, 2, dims, cplx );
+    }
+
+    mxArray* mxCreateNumericArray( mwSize nd, const mwSize *dims, mxClassID cls, mxComplexity cplx )
+    {
+        return _create( cls, nd, dims, cplx );
+    }
+
+    mxArray* mxCreateUninitNumericMatrix( size_t m, size_t n, mxClassID cls, mxComplexity cplx )
+    {
+        const mwSize dims[2] = { m, n };
+        return _create( cls, 2, dims, cplx, false );
+    }
+
+    mxArray* mxCreateUninitNumericArray( size_t nd, size_t *dims, mxClassID cls, mxComplexity cplx )
+    {
+        return _create( cls, nd, dims, cplx, false );
+    }
+
+    mxArray* mxCreateLogicalMatrix( mwSize m, mwSize n )
+    {
+        const mwSize dims[2] = { m, n };
+        return _create( mxLOGICAL_CLASS, 2, dims, mxREAL );
+    }
+
+    mxArray* mxCreateLogicalArray( mwSize nd, const mwSize *dims )
+    {
+        return _create( mxLOGICAL_CLASS, nd, dims, mxREAL );
+    }
+
+    mxArray* mxCreateCharArray( mwSize nd, const mwSize *dims )
+    {
+        return _create( mxCHAR_CLASS, nd, dims, mxREAL );
+    }
+
+    mxArray* mxCreateCellMatrix( mwSize m, mwSize n )
+    {
+        const mwSize dims[2] = { m, n };
+        return _create( mxCELL_CLASS, 2, dims, mxREAL );
+    }
+
+    mxArray* mxCreateCellArray( mwSize nd, const mwSize *dims )
+    {
+        return _create( mxCELL_CLASS, nd, dims, mxREAL );
+    }
+
+    mxArray* mxCreateStructMatrix( mwSize m, mwSize n, int nfields, const char **fields )
+    {
+        const mwSize dims[2] = { m, n };
+        return _create_struct( 2, dims, nfields, fields );
+    }
+
+    mxArray* mxCreateStructArray( mwSize nd, const mwSize *dims, int nfields, const char **fields )
+    {
+        return _create_struct( nd, dims, nfields, fields );
+    }
+
+    mxArray* mxCreateSparse( mwSize m, mwSize n, mwSize nzmax, mxComplexity cplx )
+    {
+        return _create_sparse( mxDOUBLE_CLASS, m, n, nzmax, cplx );
+    }
+
+    mxArray* mxCreateSparseLogicalMatrix( mwSize m, mwSize n, mwSize nzmax )
+    {
+        return _create_sparse( mxLOGICAL_CLASS, m, n, nzmax, mxREAL );
+    }
+
+    // ----------  =====  ----------
+
+    void* mxGetData( const mxArray *a )         { return a->data; }
+    void  mxSetData( mxArray *a, void *ptr )    { a->data = ptr; }
+    double* mxGetPr( const mxArray *a )         { return static_cast<double*>(a->data); }
+    double* mxGetPi( const mxArray *a )         { return static_cast<double*>(a->imag); }
+    void* mxGetImagData( const mxArray *a )     { return a->imag; }
+
+    mxComplexDouble* mxGetComplexDoubles( const mxArray *a )
+    {
+        return (a->cls == mxDOUBLE_CLASS && a->cplx) ? static_cast<mxComplexDouble*>(a->data) : nullptr;
+    }
+
+    mxComplexSingle* mxGetComplexSingles( const mxArray *a )
+    {
+        return (a->cls == mxSINGLE_CLASS && a->cplx) ? static_cast<mxComplexSingle*>(a->data) : nullptr;
+    }
+
+    mxLogical* mxGetLogicals( const mxArray *a )
+    {
+        return a->cls == mxLOGICAL_CLASS ? static_cast<mxLogical*>(a->data) : nullptr;
+    }
+
+    mxChar* mxGetChars( const mxArray *a )
+    {
+        return a->cls == mxCHAR_CLASS ? static_cast<mxChar*>(a->data) : nullptr;
+    }
+
+    mwIndex* mxGetIr( const mxArray *a )        { return a->ir; }
+    mwIndex* mxGetJc( const mxArray *a )        { return a->jc; }
+    mwSize mxGetNzmax( const mxArray *a )       { return a->nzmax; }
+    void mxSetIr( mxArray *a, mwIndex *ir )     { a->ir = ir; }
+    void mxSetJc( mxArray *a, mwIndex *jc )     { a->jc = jc; }
+    void mxSetNzmax( mxArray *a, mwSize n )     { a->nzmax = n; }
+
+    // ----------  =====  ----------
+
+    size_t mxGetM( const mxArray *a ) { return a->dims[0]; }
+    size_t mxGetN( const mxArray *a )
+    {
+        size_t n = 1;
+        for ( size_t d = 1; d < a->dims.size(); ++d ) n *= a->dims[d];
+        return n;
+    }
+
+    void mxSetM( mxArray *a, mwSize m ) { a->dims[0] = m; }
+    void mxSetN( mxArray *a, mwSize n ) { a->dims.resize(2); a->dims[1] = n; }
+
+    int mxSetDimensions( mxArray *a, const mwSize *dims, mwSize nd )
+    {
+        _set_dims( a, nd, dims );
+        return 0;
+    }
+
+    mwSize mxGetNumberOfDimensions( const mxArray *a )  { return a->dims.size(); }
+    const mwSize* mxGetDimensions( const mxArray *a )   { return a->dims.data(); }
+    size_t mxGetNumberOfElements( const mxArray *a )    { return _numel(a); }
+    size_t mxGetElementSize( const mxArray *a )         { return _valsize(a); }
+
+    // ----------  =====  ----------
+
+    mxClassID mxGetClassID( const mxArray *a ) { return a->cls; }
+
+    const char* mxGetClassName( const mxArray *a )
+    {
+        switch (a->cls)
+        {
+            case mxCELL_CLASS:      return "cell";
+            case mxSTRUCT_CLASS:    return "struct";
+            case mxLOGICAL_CLASS:   return "logical";
+            case mxCHAR_CLASS:      return "char";
+            case mxDOUBLE_CLASS:    return "double";
+            case mxSINGLE_CLASS:    return "single";
+            case mxINT8_CLASS:      return "int8";
+            case mxUINT8_CLASS:     return "uint8";
+            case mxINT16_CLASS:     return "int16";
+            case mxUINT16_CLASS:    return "uint16";
+            case mxINT32_CLASS:     return "int32";
+            case mxUINT32_CLASS:    return "uint32";
+            case mxINT64_CLASS:     return "int64";
+            case mxUINT64_CLASS:    return "uint64";
+            case mxFUNCTION_CLASS:  return "function_handle";
+            default:                return "unknown";
+        }
+    }
+
+    bool mxIsClass( const mxArray *a, const char *name )
+    {
+        return std::strcmp( mxGetClassName(a), name ) == 0;
+    }
+
+    bool mxIsNumeric( const mxArray *a )
+    {
+        return a->cls >= mxDOUBLE_CLASS && a->cls <= mxUINT64_CLASS;
+    }
+
+    bool mxIsLogical( const mxArray *a )    { return a->cls == mxLOGICAL_CLASS; }
+    bool mxIsChar( const mxArray *a )       { return a->cls == mxCHAR_CLASS; }
+    bool mxIsCell( const mxArray *a )       { return a->cls == mxCELL_CLASS; }
+    bool mxIsStruct( const mxArray *a )     { return a->cls == mxSTRUCT_CLASS; }
+    bool mxIsDouble( const mxArray *a )     { return a->cls == mxDOUBLE_CLASS; }
+    bool mxIsSingle( const mxArray *a )     { return a->cls == mxSINGLE_CLASS; }
+    bool mxIsComplex( const mxArray *a )    { return a->cplx; }
+    bool mxIsSparse( const mxArray *a )     { return a->sparse; }
+    bool mxIsEmpty( const mxArray *a )      { return _numel(a) == 0; }
+
+    // ----------  =====  ----------
+
+    double mxGetScalar( const mxArray *a )
+    {
+        if ( !a->data || _nvals(a) == 0 || _is_container(a) ) return 0;
+        switch (a->cls)
+        {
+            case mxLOGICAL_CLASS:   return *static_cast<const mxLogical*>(a->data);
+            case mxCHAR_CLASS:      return *static_cast<const mxChar*>(a->data);
+            case mxDOUBLE_CLASS:    return *static_cast<const double*>(a->data);
+            case mxSINGLE_CLASS:    return *static_cast<const float*>(a->data);
+            case mxINT8_CLASS:      return *static_cast<const int8_t*>(a->data);
+            case mxUINT8_CLASS:     return *static_cast<const uint8_t*>(a->data);
+            case mxINT16_CLASS:     return *static_cast<const int16_t*>(a->data);
+            case mxUINT16_CLASS:    return *static_cast<const uint16_t*>(a->data);
+            case mxINT32_CLASS:     return *static_cast<const int32_t*>(a->data);
+            case mxUINT32_CLASS:    return *static_cast<const uint32_t*>(a->data);
+            case mxINT64_CLASS:     return static_cast<double>(*static_cast<const int64_t*>(a->data));
+            case mxUINT64_CLASS:    return static_cast<double>(*static_cast<const uint64_t*>(a->data));
+            default:                return 0;
+        }
+    }
+
+    // characters are truncated to one byte, like with the default Matlab locale
+    int mxGetString( const mxArray *a, char *buf, mwSize len )
+    {
+        if ( !mxIsChar(a) || len == 0 ) return 1;
+
+        const size_t n = _numel(a);
+        const mxChar *p = mxGetChars(a);
+        const size_t m = n < len-1 ? n : len-1;
+        for ( size_t i = 0; i < m; ++i ) buf[i] = static_cast<char>(p[i]);
+        buf[m] = '\0';
+        return m < n ? 1 : 0;
+    }
+
+    char* mxArrayToString( const mxArray *a )
+    {
+        if ( !mxIsChar(a) ) return nullptr;
+        const size_t n = _numel(a);
+        char *buf = static_cast<char*>(mxCalloc( n+1, 1 ));
+        mxGetString( a, buf, n+1 );
+        return buf;
+    }
+
+    char* mxArrayToUTF8String( const mxArray *a )
+    {
+        if ( !mxIsChar(a) ) return nullptr;
+
+        const size_t n = _numel(a);
+        const mxChar *p = mxGetChars(a);
+        std::string out;
+        for ( size_t i = 0; i < n; ++i )
+        {
+            uint32_t c = p[i];
+            if ( c >= 0xD800 && c < 0xDC00 && i+1 < n && p[i+1] >= 0xDC00 && p[i+1] < 0xE000 )
+                c = 0x10000 + ((c - 0xD800) << 10) + (p[++i] - 0xDC00);
+
+            if ( c < 0x80 )
+                out += static_cast<char>(c);
+            else if ( c < 0x800 ) {
+                out += static_cast<char>( 0xC0 | (c >> 6) );
+                out += static_cast<char>( 0x80 | (c & 0x3F) );
+            }
+            else if ( c < 0x10000 ) {
+                out += static_cast<char>( 0xE0 | (c >> 12) );
+                out += static_cast<char>( 0x80 | ((c >> 6) & 0x3F) );
+                out += static_cast<char>( 0x80 | (c & 0x3F) );
+            }
+            else {
+                out += static_cast<char>( 0xF0 | (c >> 18) );
+                out += static_cast<char>( 0x80 | ((c >> 12) & 0x3F) );
+                out += static_cast<char>( 0x80 | ((c >> 6) & 0x3F) );
+                out += static_cast<char>( 0x80 | (c & 0x3F) );
+            }
+        }
+        return static_cast<char*>(_copy( out.c_str(), out.size()+1 ));
+    }
+
+    // ----------  =====  ----------
+
+    mxArray* mxGetCell( const mxArray *a, mwIndex i )
+    {
+        return _slots(a)[i];
+    }
+
+    void mxSetCell( mxArray *a, mwIndex i, mxArray *val )
+    {
+        _slots(a)[i] = val;
+    }
+
+    int mxGetNumberOfFields( const mxArray *a )
+    {
+        return static_cast<int>(a->fields.size());
+    }
+
+    const char* mxGetFieldNameByNumber( const mxArray *a, int f )
+    {
+        return (f >= 0 && f < mxGetNumberOfFields(a)) ? a->fields[f].c_str() : nullptr;
+    }
+
+    int mxGetFieldNumber( const mxArray *a, const char *name )
+    {
+        for ( size_t f = 0; f < a->fields.size(); ++f )
+            if ( a->fields[f] == name ) return static_cast<int>(f);
+        return -1;
+    }
+
+    mxArray* mxGetFieldByNumber( const mxArray *a, mwIndex i, int f )
+    {
+        return _slots(a)[ i*a->fields.size() + f ];
+    }
+
+    void mxSetFieldByNumber( mxArray *a, mwIndex i, int f, mxArray *val )
+    {
+        _slots(a)[ i*a->fields.size() + f ] = val;
+    }
+
+    mxArray* mxGetField( const mxArray *a, mwIndex i, const char *name )
+    {
+        const int f = mxGetFieldNumber( a, name );
+        return f < 0 ? nullptr : mxGetFieldByNumber( a, i, f );
+    }
+
+    void mxSetField( mxArray *a, mwIndex i, const char *name, mxArray *val )
+    {
+        const int f = mxGetFieldNumber( a, name );
+        if ( f >= 0 ) mxSetFieldByNumber( a, i, f, val );
+    }
+
+    int mxAddField( mxArray *a, const char *name )
+    {
+        const int f = mxGetFieldNumber( a, name );
+        if ( f >= 0 ) return f;
+
+        // re-layout the slots with one more field per element
+        const size_t n = _numel(a), nf = a->fields.size();
+        mxArray **old = _slots(a);
+        mxArray **p = static_cast<mxArray**>(mxCalloc( n*(nf+1), sizeof(mxArray*) ));
+        for ( size_t i = 0; i < n; ++i )
+            for ( size_t k = 0; k < nf; ++k )
+                p[ i*(nf+1) + k ] = old[ i*nf + k ];
+
+        mxFree(old);
+        a->data = p;
+        a->fields.push_back(name);
+        return static_cast<int>(nf);
+    }
+
+    // copy, as in Matlab
+    mxArray* mxGetProperty( const mxArray *a, mwIndex i, const char *name )
+    {
+        const mxArray *p = mxIsStruct(a) ? mxGetField( a, i, name ) : nullptr;
+        return p ? mxDuplicateArray(p) : nullptr;
+    }
+
+    // ----------  =====  ----------
+
+    int mexPrintf( const char *fmt, ... )
+    {
+        va_list args;
+        va_start( args, fmt );
+        const int n = std::vprintf( fmt, args );
+        va_end(args);
+        return n;
+    }
+
+    void mexErrMsgIdAndTxt( const char *id, const char *fmt, ... )
+    {
+        va_list args;
+        va_start( args, fmt );
+        const std::string msg = _format( fmt, args );
+        va_end(args);
+        throw host::Error( id ? id : "", msg );
+    }
+
+    void mexErrMsgTxt( const char *msg )
+    {
+        throw host::Error( "", msg ? msg : "" );
+    }
+
+    void mexWarnMsgIdAndTxt( const char *id, const char *fmt, ... )
+    {
+        va_list args;
+        va_start( args, fmt );
+        const std::string msg = _format( fmt, args );
+        va_end(args);
+        std::fprintf( stderr, "Warning: %s [%s]\n", msg.c_str(), id ? id : "" );
+    }
+
+    // ----------  =====  ----------
+
+    int mexAtExit( void (*fn)(void) )
+    {
+        // the state is constructed first, so that it is destroyed after the handlers run
+        static std::once_flag once;
+        std::call_once( once, [](){ _state(); std::atexit( _run_exit_handlers ); } );
+
+        std::lock_guard<std::mutex> lock( _state().mutex );
+        _state().exit_handlers.push_back(fn);
+        return 0;
+    }
+
+    void mexLock( void )    { ++_state().locks; }
+    void mexUnlock( void )  { if ( _state().locks > 0 ) --_state().locks; }
+    bool mexIsLocked( void ) { return _state().locks > 0; }
+
+    // memory is never freed automatically on the host
+    void mexMakeArrayPersistent( mxArray* ) {}
+    void mexMakeMemoryPersistent( void* ) {}
+
+    const char* mexFunctionName( void )
+    {
+        return _state().name.c_str();
+    }
+
+    // ----------  =====  ----------
+
+    int mexCallMATLAB( int nlhs, mxArray **lhs, int nrhs, mxArray **rhs, const char *name )
+    {
+        _dispatch( nlhs, lhs, nrhs, rhs, name );
+        return 0;
+    }
+
+    mxArray* mexCallMATLABWithTrap( int nlhs, mxArray **lhs, int nrhs, mxArray **rhs, const char *name )
+    {
+        try {
+            _dispatch( nlhs, lhs, nrhs, rhs, name );
+            return nullptr;
+        }
+        catch ( const host::Error& e ) {
+            return _make_exception( e.id, e.what() );
+        }
+        catch ( const std::exception& e ) {
+            return _make_exception( "", e.what() );
+        }
+    }
+
+    // ----------  =====  ----------
+
+    MATFile* matOpen( const char*, const char* )                    { return nullptr; }
+    int      matClose( MATFile* )                                   { return 0; }
+    char**   matGetDir( MATFile*, int *num )                        { if (num) *num = -1; return nullptr; }
+    mxArray* matGetVariable( MATFile*, const char* )                { return nullptr; }
+    int      matPutVariable( MATFile*, const char*, const mxArray* ) { return 1; }
+
+}
@@ -0,0 +1,67 @@
+
+//==================================================
+// @title        bits.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <algorithm>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+// several chunks of JMX_BITS_GRAIN words
+static const index_t N = 1 << 20;
+
+template <class T>
+static mxArray* filled( T val )
+{
+    mxArray *ms = make_vector( N, true, cpp2mex<T>::classid );
+    auto v = get_vector_rw<T>(ms);
+    for ( index_t i = 0; i < N; ++i ) v[i] = val;
+    return ms;
+}
+
+int main()
+{
+    // every third element, and the last one
+    mxArray *ml = make_vector( N, true, mxLOGICAL_CLASS );
+    auto l = get_vector_rw<bool>(ml);
+    index_t n = 0;
+    for ( index_t i = 0; i < N; ++i ) n += (l[i] = i % 3 == 0 || i == N-1);
+
+    BitVector mask = get_bits(ml);
+    HOST_CHECK( mask.size() == N && mask.count() == n );
+    HOST_CHECK( mask.find_first() == 0 && mask.get(N-1) && !mask.get(1) );
+
+    // sums accumulate in a wider type than the elements
+    mxArray *mu = filled<uint8_t>(200);
+    HOST_CHECK( masked_sum( get_vector<uint8_t>(mu), mask ) == 200*n );
+    HOST_CHECK( masked_mean( get_vector<uint8_t>(mu), mask ) == 200.0 );
+
+    mxArray *ms = filled<int8_t>(-100);
+    HOST_CHECK( masked_sum( get_vector<int8_t>(ms), mask ) == -100*int64_t(n) );
+    HOST_CHECK( masked_mean( get_vector<int8_t>(ms), mask ) == -100.0 );
+
+    // reductions with an explicit operator
+    mxArray *md = filled<double>(0.5);
+    auto d = get_vector_rw<double>(md);
+    d[N-1] = 3; d[1] = 9; // 1 is not in the mask
+    HOST_CHECK( masked_sum( get_vector<double>(md), mask ) == 0.5*(n-1) + 3 );
+    HOST_CHECK( masked_reduce( get_vector<double>(md), mask, 0.0,
+        []( double a, double b ) { return std::max(a,b); } ) == 3 );
+
+    // counting with a different accumulator type
+    HOST_CHECK( masked_reduce( get_vector<double>(md), mask, index_t(0),
+        []( index_t a, double x ) { return a + (x > 1); },
+        []( index_t a, index_t b ) { return a + b; } ) == 1 );
+
+    // empty mask
+    HOST_CHECK( masked_sum( get_vector<uint8_t>(mu), BitVector(N) ) == 0 );
+
+    for ( mxArray *x: { ml, mu, ms, md } ) mxDestroyArray(x);
+    return host::report();
+}
@@ -0,0 +1,70 @@
+#ifndef JMX_HOST_CHECK_H_INCLUDED
+#define JMX_HOST_CHECK_H_INCLUDED
+
+//==================================================
+// @title        check.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "jmx.h"
+#include "host.h"
+
+#include <cstdio>
+#include <string>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Minimal checks for the tests of the host runtime (run with ctest, see CMakeLists.txt):
+ *
+ *      int main() {
+ *          HOST_CHECK( x == 1 );
+ *          HOST_CHECK_THROWS( make_sparse(3,3,2,mxSINGLE_CLASS), "" );
+ *          return host::report();
+ *      }
+ *
+ * Failed checks are printed, and the test continues; report returns the exit code.
+ */
+
+#define HOST_CHECK( cond ) \
+    host::check( (cond), #cond, __FILE__, __LINE__ )
+
+// check that an expression throws, with the given id (if any)
+#define HOST_CHECK_THROWS( expr, errid ) \
+    do { \
+        std::string _host_id = "(none)"; \
+        try { expr; } \
+        catch ( const host::Error& e ) { _host_id = e.id; } \
+        catch ( const jmx::Exception& e ) { _host_id = e.id(); } \
+        catch ( const std::exception& ) { _host_id = ""; } \
+        host::check( _host_id != "(none)" && (!*(errid) || _host_id == (errid)), \
+            #expr " throws " #errid, __FILE__, __LINE__ ); \
+    } while (0)
+
+namespace host {
+
+    inline int& failures()
+    {
+        static int n = 0;
+        return n;
+    }
+
+    inline void check( bool ok, const char *expr, const char *file, int line )
+    {
+        if ( ok ) return;
+        std::fprintf( stderr, "%s:%d: check failed: %s\n", file, line, expr );
+        ++failures();
+    }
+
+    // run the exit handlers, and return the exit code of the test
+    inline int report()
+    {
+        host::exit();
+        if ( failures() ) std::fprintf( stderr, "%d check(s) failed\n", failures() );
+        return failures() ? 1 : 0;
+    }
+
+}
+
+#endif
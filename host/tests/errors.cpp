@@ -0,0 +1,95 @@
+
+//==================================================
+// @title        errors.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+static int g_mode = 0;
+
+// gateway raising the errors of the calling thread, or of the workers
+void mexFunction( int nargout, mxArray *out[], int nargin, const mxArray *in[] )
+{
+    jmx::ErrorRecord err = {};
+    try {
+        Arguments args( nargout, out, nargin, in );
+        switch ( g_mode )
+        {
+        case 0:
+            args.out.assign( 0, make_scalar(1.0) );
+            break;
+        case 1:
+            JMX_THROW_ID( "test:main", "failed with %d", 42 );
+        case 2:
+            parallel_for( 0, 1000, []( index_t i ) {
+                if ( i == 777 ) JMX_THROW_ID( "test:worker", "failed at %zu", i );
+            });
+            break;
+        case 3:
+            parallel_chunks( 0, 1000, []( index_t b, index_t e, index_t ) {
+                if ( b <= 500 && 500 < e ) throw std::runtime_error("standard");
+            });
+            break;
+        case 4:
+            JMX_ASSERT( nargin > 5, "Not enough inputs." );
+        }
+    }
+    catch (...) {
+        err.capture();
+    }
+    if ( !err.empty() ) jmx::raise(err);
+}
+
+// identifier and message of the error raised by the gateway
+static host::Error call( int mode )
+{
+    g_mode = mode;
+    try { host::call( mexFunction, 1, {} ); }
+    catch ( const host::Error& e ) { return e; }
+    return host::Error( "", "" );
+}
+
+int main()
+{
+    HOST_CHECK( call(0).id.empty() );
+
+    host::Error e = call(1);
+    HOST_CHECK( e.id == "test:main" && std::strstr( e.what(), "failed with 42" ) );
+
+    e = call(2);
+    HOST_CHECK( e.id == "test:worker" && std::strstr( e.what(), "failed at 777" ) );
+
+    e = call(3);
+    HOST_CHECK( e.id == "JMX:exception" && std::strstr( e.what(), "standard" ) );
+
+    e = call(4);
+    HOST_CHECK( e.id == "JMX:error" && std::strstr( e.what(), "Not enough inputs." ) );
+
+    // the pool recovers after a failed loop
+    HOST_CHECK( call(0).id.empty() );
+
+    // records truncate long messages
+    ErrorRecord r = {};
+    HOST_CHECK( r.empty() );
+    const std::string msg( 2*JMX_MSGBUF_SIZE, 'x' );
+    r.set( "test:long", msg.c_str() );
+    HOST_CHECK( !r.empty() && std::strlen(r.msg) == JMX_MSGBUF_SIZE );
+
+    // only the first error of a channel is kept
+    ErrorChannel ch;
+    try { throw Exception( "test:first", "first" ); } catch (...) { ch.capture(); }
+    try { throw Exception( "test:second", "second" ); } catch (...) { ch.capture(); }
+    HOST_CHECK( ch.cancelled() && std::strcmp( ch.error()->id, "test:first" ) == 0 );
+    HOST_CHECK_THROWS( ch.rethrow(), "" );
+
+    return host::report();
+}
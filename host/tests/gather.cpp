@@ -0,0 +1,117 @@
+
+//==================================================
+// @title        gather.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+// gather and scatter with masks and index lists, against vol(mask)
+static void test_gather()
+{
+    const index_t nr = 64, nc = 50, ns = 40, N = nr*nc*ns;
+
+    mxArray *mv = make_volume( nr, nc, ns );
+    auto vol = get_volume_rw<double>(mv);
+    for ( index_t i = 0; i < N; ++i ) vol[i] = double(i);
+
+    // dense and sparse words
+    mxArray *ml = make_vector( N, true, mxLOGICAL_CLASS );
+    auto l = get_vector_rw<bool>(ml);
+    std::vector<index_t> ref;
+    for ( index_t i = 0; i < N; ++i )
+        if ( (l[i] = (i/64) % 3 == 0 || i % 7 == 0) ) ref.push_back(i);
+
+    BitVector mask = get_bits(ml);
+    IndexList idx(mask);
+    HOST_CHECK( idx.size() == ref.size() && idx.extent() == N && idx.indices() == ref );
+
+    mxArray *mo = make_vector( ref.size(), true );
+    auto out = get_vector_rw<double>(mo);
+
+    index_t bad = 0;
+    gather( vol, mask, out );
+    for ( index_t k = 0; k < ref.size(); ++k ) bad += out[k] != double(ref[k]);
+    gather( vol, idx, out );
+    for ( index_t k = 0; k < ref.size(); ++k ) bad += out[k] != double(ref[k]);
+    HOST_CHECK( bad == 0 );
+
+    // scatter back, negated
+    for ( index_t k = 0; k < ref.size(); ++k ) out[k] = -out[k];
+    scatter( out, idx, vol );
+    for ( index_t i = 0; i < N; ++i ) bad += vol[i] != (l[i] ? -double(i) : double(i));
+    scatter( out, mask, vol );
+    HOST_CHECK( bad == 0 );
+
+    // 1-based indices, checked against numel
+    mxArray *mi = make_vector( 3, true );
+    auto ind = get_vector_rw<double>(mi);
+    ind[0] = 1; ind[1] = N; ind[2] = 5;
+    IndexList li;
+    li.assign( mi, N );
+    HOST_CHECK( li.size() == 3 && li[1] == N-1 && li.extent() == N );
+    ind[2] = N+1;
+    HOST_CHECK_THROWS( li.assign( mi, N ), "" );
+    HOST_CHECK( li.empty() && li.extent() == 0 );
+    ind[2] = 2.5;
+    HOST_CHECK_THROWS( li.assign( mi, N ), "" );
+
+    // lists are only valid for arrays of the size they were built for
+    mxArray *ms = make_volume( nr, nc, ns/2 );
+    auto small = get_volume_rw<double>(ms);
+    HOST_CHECK_THROWS( gather( small, idx, out ), "" );
+    HOST_CHECK_THROWS( scatter( out, idx, small ), "" );
+
+    for ( mxArray *x: { mv, ml, mo, mi, ms } ) mxDestroyArray(x);
+}
+
+// conversions are 1-based, and inverse of each other
+static void test_sub2ind()
+{
+    const index_t nr = 7, nc = 5, ns = 3, N = nr*nc*ns;
+
+    mxArray *m[5];
+    for ( auto& x: m ) x = make_vector( N, true );
+    auto ind = get_vector_rw<double>(m[0]);
+    auto r = get_vector_rw<double>(m[1]);
+    auto c = get_vector_rw<double>(m[2]);
+    auto s = get_vector_rw<double>(m[3]);
+    auto back = get_vector_rw<double>(m[4]);
+
+    for ( index_t i = 0; i < N; ++i ) ind[i] = double(i+1);
+    ind2sub( nr, nc, ns, ind, r, c, s );
+    HOST_CHECK( r[0] == 1 && c[0] == 1 && s[0] == 1 );
+    HOST_CHECK( r[N-1] == nr && c[N-1] == nc && s[N-1] == ns );
+    HOST_CHECK( r[nr] == 1 && c[nr] == 2 && s[nr*nc] == 2 );
+
+    sub2ind( nr, nc, ns, r, c, s, back );
+    index_t bad = 0;
+    for ( index_t i = 0; i < N; ++i ) bad += back[i] != ind[i];
+    HOST_CHECK( bad == 0 );
+
+    // 2D on the first nr*nc indices
+    auto r2 = get_vector_rw<double>(m[1]);
+    ind2sub( nr, nc*ns, ind, r2, c );
+    sub2ind( nr, nc*ns, r2, c, back );
+    for ( index_t i = 0; i < N; ++i ) bad += back[i] != ind[i];
+    HOST_CHECK( bad == 0 );
+
+    ind[3] = N+1;
+    HOST_CHECK_THROWS( ind2sub( nr, nc, ns, ind, r, c, s ), "" );
+    r[0] = 0;
+    HOST_CHECK_THROWS( sub2ind( nr, nc, ns, r, c, s, back ), "" );
+
+    for ( auto x: m ) mxDestroyArray(x);
+}
+
+int main()
+{
+    test_gather();
+    test_sub2ind();
+    return host::report();
+}
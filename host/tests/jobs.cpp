@@ -0,0 +1,129 @@
+
+//==================================================
+// @title        jobs.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <atomic>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+static mxArray* to_scalar( const double& x ) { return make_scalar(x); }
+
+// job counting to n, until released (or cancelled)
+static std::atomic<bool> g_release(false), g_exited(false);
+
+static double count_to( Job& job, index_t n )
+{
+    job.set_total(n);
+    for ( index_t k = 0; k < n && !job.cancelled(); ++k ) job.advance();
+    while ( !g_release && !job.cancelled() ) std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+    g_exited = true;
+    return double(n);
+}
+
+static void test_done()
+{
+    g_release = false;
+    const handle_t h = launch_job<double>( []( Job& job ) { return count_to( job, 1000 ); }, to_scalar );
+    auto job = get_job(h);
+
+    // blocked: wait times out
+    HOST_CHECK( !job->wait(0.05) && job->state() == Job::Running && !job->finished() );
+    HOST_CHECK( job->total() == 1000 && job->progress() <= 1 );
+    HOST_CHECK( get_string(mxGetField( make_job_info(*job), 0, "state" )) == "running" );
+
+    g_release = true;
+    mxArray *r = job->fetch();
+    HOST_CHECK( r && mxGetScalar(r) == 1000 );
+    HOST_CHECK( job->state() == Job::Done && job->count() == 1000 && job->progress() == 1 );
+
+    // elapsed time is frozen once finished
+    const double t = job->elapsed();
+    HOST_CHECK( t >= 0.05 && job->elapsed() == t );
+
+    mxArray *info = make_job_info(*job);
+    HOST_CHECK( get_string(mxGetField( info, 0, "state" )) == "done" );
+    HOST_CHECK( mxGetScalar(mxGetField( info, 0, "count" )) == 1000 );
+    HOST_CHECK( get_string(mxGetField( info, 0, "error" )).empty() );
+
+    // fetch can be called again
+    HOST_CHECK( mxGetScalar(job->fetch()) == 1000 );
+    job.reset();
+    HOST_CHECK( destroy_handle(h) );
+}
+
+// errors are rethrown by fetch, with their identifier
+static void test_failed()
+{
+    const handle_t h = launch_job<double>( []( Job& ) -> double {
+        JMX_THROW_ID( "test:job", "job failed" );
+    }, to_scalar );
+    auto job = get_job(h);
+
+    HOST_CHECK( job->wait() && job->state() == Job::Failed );
+    HOST_CHECK( std::string(job->error()).find("job failed") != std::string::npos );
+    HOST_CHECK_THROWS( job->fetch(), "test:job" );
+    HOST_CHECK( get_string(mxGetField( make_job_info(*job), 0, "state" )) == "failed" );
+
+    job.reset();
+    destroy_handle(h);
+}
+
+static void test_cancel()
+{
+    // cancelled by the caller
+    g_release = false; g_exited = false;
+    handle_t h = launch_job<double>( []( Job& job ) { return count_to( job, 10 ); }, to_scalar );
+    auto job = get_job(h);
+    job->cancel();
+    HOST_CHECK_THROWS( job->fetch(), "JMX:cancelled" );
+    HOST_CHECK( job->state() == Job::Cancelled && g_exited );
+    job.reset();
+
+    // destroying the handle cancels, and waits for the thread
+    g_exited = false;
+    HOST_CHECK( destroy_handle(h) && !destroy_handle(h) );
+    h = launch_job<double>( []( Job& job ) { return count_to( job, 10 ); }, to_scalar );
+    HOST_CHECK( !get_job(h)->wait(0.01) );
+    HOST_CHECK( destroy_handle(h) && g_exited );
+    HOST_CHECK_THROWS( get_job(h), "JMX:staleHandle" );
+
+    // as does clearing the Mex file
+    g_exited = false;
+    h = launch_job<double>( []( Job& job ) { return count_to( job, 10 ); }, to_scalar );
+    host::exit();
+    HOST_CHECK( g_exited && !runtime().registry().valid(h) );
+}
+
+// waiting stops on Ctrl+C
+static void test_interrupt()
+{
+    g_release = false;
+    const handle_t h = launch_job<double>( []( Job& job ) { return count_to( job, 10 ); }, to_scalar );
+    auto job = get_job(h);
+
+    host::interrupt();
+    HOST_CHECK( !job->wait() );
+    HOST_CHECK_THROWS( job->fetch(), "" );
+    host::interrupt(false);
+
+    g_release = true;
+    HOST_CHECK( job->wait() && job->state() == Job::Done );
+    job.reset();
+    destroy_handle(h);
+}
+
+int main()
+{
+    test_done();
+    test_failed();
+    test_interrupt();
+    test_cancel();
+    return host::report();
+}
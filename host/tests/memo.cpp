@@ -0,0 +1,139 @@
+
+//==================================================
+// @title        memo.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+// equal contents hash the same, and any difference in class, size or values is detected
+static void test_hash()
+{
+    mxArray *a = make_matrix( 3, 4 ), *b = make_matrix( 3, 4 ), *c = make_matrix( 4, 3 );
+    for ( auto x: { a, b, c } )
+        for ( index_t i = 0; i < 12; ++i ) mxGetPr(x)[i] = 0.5*i;
+
+    HOST_CHECK( hash_array(a) == hash_array(b) );
+    HOST_CHECK( hash_array(a) != hash_array(c) );
+    HOST_CHECK( hash_array(a) != hash_array(a,1) );
+    mxGetPr(b)[11] = -1;
+    HOST_CHECK( hash_array(a) != hash_array(b) );
+
+    // class, and nested arrays
+    mxArray *s = make_matrix( 3, 4, mxSINGLE_CLASS );
+    HOST_CHECK( hash_array(s) != hash_array(make_matrix( 3, 4 )) );
+    mxArray *c1 = make_cell(2), *c2 = make_cell(2);
+    mxSetCell( c1, 0, mxDuplicateArray(a) );
+    mxSetCell( c2, 0, mxDuplicateArray(a) );
+    HOST_CHECK( hash_array(c1) == hash_array(c2) );
+    mxSetCell( c2, 1, mxCreateString("") );
+    HOST_CHECK( hash_array(c1) != hash_array(c2) );
+
+    HOST_CHECK_THROWS( hash_array(nullptr), "" );
+
+    // large buffers are hashed in parallel blocks, with all bytes (including the tail) significant
+    const index_t n = 3*JMX_HASH_BLOCK + 7;
+    std::vector<uint8_t> buf(n);
+    for ( index_t i = 0; i < n; ++i ) buf[i] = uint8_t(i*31 + (i >> 11));
+    const uint64_t h = hash_bytes( buf.data(), n );
+    HOST_CHECK( h == hash_bytes( buf.data(), n ) && h != hash_bytes( buf.data(), n-1 ) );
+    buf[n-1] ^= 1;
+    HOST_CHECK( h != hash_bytes( buf.data(), n ) );
+    buf[n-1] ^= 1; buf[JMX_HASH_BLOCK+5] ^= 0x80;
+    HOST_CHECK( h != hash_bytes( buf.data(), n ) );
+
+    for ( auto x: { a, b, c, s, c1, c2 } ) mxDestroyArray(x);
+}
+
+// ----------  =====  ----------
+
+// y = x + 1, memoized; throws for negative inputs
+static int g_calls = 0;
+static void plus_one( int nargout, mxArray *out[], int nargin, const mxArray *in[] )
+{
+    Arguments args( nargout, out, nargin, in );
+    if ( args.memoize() ) return;
+
+    ++g_calls;
+    const index_t n = mxGetNumberOfElements(in[0]);
+    mxArray *y = args.out.assign( 0, make_vector( n, true ) );
+    for ( index_t i = 0; i < n; ++i ) {
+        JMX_ASSERT( mxGetPr(in[0])[i] >= 0, "Negative input." );
+        mxGetPr(y)[i] = mxGetPr(in[0])[i] + 1;
+    }
+}
+
+static mxArray* vec( index_t n, double v )
+{
+    mxArray *x = make_vector( n, true );
+    for ( index_t i = 0; i < n; ++i ) mxGetPr(x)[i] = v;
+    return x;
+}
+
+static void test_memo()
+{
+    Memo& m = memo();
+    m.clear();
+    const Memo::Stats s0 = m.stats();
+
+    // miss, then hit with a copy of the cached output
+    mxArray *x = vec( 100, 1 );
+    mxArray *y1 = host::call( plus_one, 1, {x} )[0];
+    mxArray *y2 = host::call( plus_one, 1, {vec( 100, 1 )} )[0];
+    HOST_CHECK( g_calls == 1 && y1 != y2 && mxGetPr(y2)[99] == 2 );
+    HOST_CHECK( m.size() == 1 && m.stats().misses == s0.misses+1 && m.stats().hits == s0.hits+1 );
+
+    // the number of outputs is part of the key
+    host::call( plus_one, 2, {x} );
+    HOST_CHECK( g_calls == 2 && m.size() == 2 );
+
+    // failed calls are not cached
+    mxArray *neg = vec( 100, -1 );
+    HOST_CHECK_THROWS( host::call( plus_one, 1, {neg} ), "" );
+    HOST_CHECK_THROWS( host::call( plus_one, 1, {neg} ), "" );
+    HOST_CHECK( g_calls == 4 && m.size() == 2 );
+
+    // least recently used entries are evicted beyond the budget
+    m.clear();
+    const index_t entry = array_bytes(y1);
+    m.set_budget( 3*entry );
+    mxArray *v[4];
+    for ( int k = 0; k < 4; ++k ) {
+        v[k] = vec( 100, k );
+        host::call( plus_one, 1, {v[k]} );
+    }
+    HOST_CHECK( m.size() == 3 && m.bytes() == 3*entry && m.stats().evictions == s0.evictions+1 );
+
+    const int calls = g_calls;
+    host::call( plus_one, 1, {v[1]} ); // hit, now most recent
+    host::call( plus_one, 1, {v[0]} ); // miss, evicts v[2]
+    host::call( plus_one, 1, {v[1]} );
+    HOST_CHECK( g_calls == calls+1 );
+    host::call( plus_one, 1, {v[2]} );
+    HOST_CHECK( g_calls == calls+2 );
+
+    // outputs larger than the budget are not stored
+    m.set_budget( entry-1 );
+    HOST_CHECK( m.size() == 0 && m.bytes() == 0 );
+    host::call( plus_one, 1, {x} );
+    HOST_CHECK( m.size() == 0 );
+
+    // entries are released with the Mex file
+    m.set_budget( JMX_MEMO_BUDGET );
+    host::call( plus_one, 1, {x} );
+    HOST_CHECK( m.size() == 1 && m.release(nullptr) == 0 );
+    host::exit();
+    HOST_CHECK( memo().size() == 0 );
+}
+
+int main()
+{
+    test_hash();
+    test_memo();
+    return host::report();
+}
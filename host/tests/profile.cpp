@@ -0,0 +1,101 @@
+
+//==================================================
+// @title        profile.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <cstring>
+#include <thread>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+static const ProfileEntry* find( const std::vector<ProfileEntry>& r, const std::string& name )
+{
+    for ( auto& e: r ) if ( e.name == name ) return &e;
+    return nullptr;
+}
+
+// scopes are aggregated by name across threads, and sorted by decreasing total time
+static void test_report()
+{
+    profile_reset();
+    parallel_for( 0, 64, [&]( index_t ) {
+        JMX_PROFILE_SCOPE( "test_work", 10 );
+        JMX_PROFILE_BYTES(5);
+        {
+            JMX_PROFILE_SCOPE( "test_inner" );
+            JMX_PROFILE_BYTES(1);
+        }
+    }, 1 );
+    {
+        JMX_PROFILE_SCOPE( "test_slow" );
+        std::this_thread::sleep_for( std::chrono::milliseconds(20) );
+    }
+
+    const auto r = profile_report();
+    const ProfileEntry *w = find( r, "test_work" ), *i = find( r, "test_inner" ), *s = find( r, "test_slow" );
+    HOST_CHECK( w && w->count == 64 && w->bytes == 64*15 );
+    HOST_CHECK( i && i->count == 64 && i->bytes == 64 && i->total <= w->total );
+    HOST_CHECK( s && s->count == 1 && s->max >= 0.02 && s->max == s->total );
+    HOST_CHECK( w && w->max <= w->total );
+
+    index_t bad = 0;
+    for ( index_t k = 1; k < r.size(); ++k ) bad += r[k-1].total < r[k].total;
+    HOST_CHECK( bad == 0 && r[0].name == "test_slow" );
+
+    // bytes outside of any scope are ignored
+    JMX_PROFILE_BYTES(7);
+    HOST_CHECK( find( profile_report(), "test_work" )->bytes == 64*15 );
+
+    // counters are reset in all threads
+    profile_reset();
+    HOST_CHECK( profile_report().empty() );
+}
+
+// names are copied (truncated), and compared when an address is reused
+static void test_names()
+{
+    profile_reset();
+    char name[] = "test_alpha";
+    { JMX_PROFILE_SCOPE( name ); }
+    std::strcpy( name, "test_beta" );
+    { JMX_PROFILE_SCOPE( name ); }
+    { JMX_PROFILE_SCOPE( name ); }
+    std::memset( name, 0, sizeof(name) );
+
+    auto r = profile_report();
+    HOST_CHECK( find( r, "test_alpha" ) && find( r, "test_alpha" )->count == 1 );
+    HOST_CHECK( find( r, "test_beta" ) && find( r, "test_beta" )->count == 2 );
+
+    const std::string big( 2*JMX_PROFILE_NAME, 'z' );
+    { JMX_PROFILE_SCOPE( big.c_str() ); }
+    HOST_CHECK( find( profile_report(), big.substr( 0, JMX_PROFILE_NAME-1 ) ) );
+
+    // beyond the slots of a thread, names are counted as (other)
+    const index_t n = JMX_PROFILE_SLOTS + 44;
+    std::vector<std::string> names(n);
+    for ( index_t k = 0; k < n; ++k ) names[k] = "test_" + std::to_string(k);
+    std::thread t([&]() {
+        for ( auto& x: names ) { JMX_PROFILE_SCOPE( x.c_str() ); }
+    });
+    t.join();
+
+    r = profile_report();
+    HOST_CHECK( find( r, "(other)" ) && find( r, "(other)" )->count == 44 );
+    index_t named = 0;
+    for ( auto& x: names ) named += find( r, x ) != nullptr;
+    HOST_CHECK( named == JMX_PROFILE_SLOTS );
+    profile_reset();
+}
+
+int main()
+{
+    test_report();
+    test_names();
+    return host::report();
+}
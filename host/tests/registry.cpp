@@ -0,0 +1,39 @@
+
+//==================================================
+// @title        registry.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+int main()
+{
+    static const int owner = 0;
+
+    handle_t a = runtime().registry().create( std::make_shared<int>(1), &owner );
+    handle_t b = runtime().registry().create( std::make_shared<double>(2), nullptr );
+    HOST_CHECK( a != 0 && a != b );
+    HOST_CHECK( *runtime().registry().get<int>(a) == 1 );
+    HOST_CHECK_THROWS( runtime().registry().get<double>(a), "JMX:handleType" );
+
+    // slots are reused with a new generation
+    HOST_CHECK( runtime().registry().destroy(a) && !runtime().registry().destroy(a) );
+    handle_t c = runtime().registry().create( std::make_shared<int>(3), &owner );
+    HOST_CHECK( (c & 0xFFFFFFFFu) == (a & 0xFFFFFFFFu) && c != a );
+    HOST_CHECK_THROWS( runtime().registry().get<int>(a), "JMX:staleHandle" );
+
+    HOST_CHECK( runtime().registry().release(&owner) == 1 && runtime().registry().size() == 1 );
+
+    // handles from before a teardown do not alias new objects
+    runtime().teardown();
+    handle_t d = runtime().registry().create( std::make_shared<int>(4), nullptr );
+    HOST_CHECK( !runtime().registry().valid(b) && !runtime().registry().valid(c) );
+    HOST_CHECK( d != b && d != c && runtime().registry().valid(d) );
+
+    return host::report();
+}
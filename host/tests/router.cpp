@@ -0,0 +1,97 @@
+
+//==================================================
+// @title        router.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <cstring>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+// bundle of commands, dispatched by the gateway in src/router.cpp
+JMX_COMMAND( twice ) {
+    args.verify( 1, 1, [](){ println("Usage: y = bundle( 'twice', x )"); } );
+    args.out.assign( 0, make_scalar( 2*args.getnum<double>(0) ) );
+}
+
+JMX_COMMAND( fail ) {
+    JMX_THROW_ID( "test:fail", "command %s failed", args.command );
+}
+
+JMX_COMMAND( alloc ) {
+    CppMemory<double> m;
+    m.alloc(1000);
+    m.free();
+}
+
+static mxArray* call( const char *cmd, std::initializer_list<const mxArray*> in={} )
+{
+    std::vector<const mxArray*> args;
+    args.push_back( mxCreateString(cmd) );
+    args.insert( args.end(), in.begin(), in.end() );
+
+    mxArray *out[1] = { nullptr };
+    mexFunction( 1, out, static_cast<int>(args.size()), args.data() );
+    return out[0];
+}
+
+// all hashes collide: dispatch falls back to linear search
+static int g_called = 0;
+static void cmd_a( Arguments& ) { g_called = 1; }
+static void cmd_b( Arguments& ) { g_called = 2; }
+
+static void test_collisions()
+{
+    Router r;
+    r.add( "a", 42, &cmd_a );
+    r.add( "b", 42, &cmd_b );
+
+    mxArray *name = mxCreateString("b");
+    const mxArray *in[1] = { name };
+    mxArray *out[1] = { nullptr };
+    r.dispatch( 0, out, 1, in );
+    HOST_CHECK( g_called == 2 );
+    HOST_CHECK( r.find("a") && r.find("a")->fn == &cmd_a && !r.find("c") );
+    mxDestroyArray(name);
+}
+
+int main()
+{
+    HOST_CHECK( router().size() == 3 );
+    HOST_CHECK( router().find("twice") == nullptr ); // table built on first dispatch
+
+    mxArray *x = mxCreateDoubleScalar(21);
+    mxArray *y = call( "twice", {x} );
+    HOST_CHECK( y && mxGetScalar(y) == 42 );
+    HOST_CHECK( router().find("twice") && router().find("fail") && !router().find("other") );
+
+    HOST_CHECK_THROWS( call( "other" ), "JMX:error" );
+    HOST_CHECK_THROWS( call( "fail" ), "test:fail" );
+    HOST_CHECK_THROWS( call( "twice" ), "" );
+
+    // allocations are tagged with the command
+    alloc_reset();
+    call( "alloc" );
+    mxArray *info = make_alloc_info();
+    const mxArray *tags = mxGetField( info, 0, "tags" );
+    bool found = false;
+    for ( index_t k = 0; k < mxGetNumberOfElements(tags); ++k )
+        if ( get_string(mxGetField( tags, k, "name" )) == "alloc" )
+            found = mxGetScalar(mxGetField( tags, k, "count" )) == 1
+                && mxGetScalar(mxGetField( tags, k, "current" )) == 0;
+    HOST_CHECK( found );
+
+    test_collisions();
+
+    // duplicates are reported by dispatch, not when registered (at load-time)
+    router().add( "twice", hash_name("twice"), router().find("fail")->fn );
+    HOST_CHECK( router().size() == 3 );
+    HOST_CHECK_THROWS( call( "twice", {x} ), "JMX:error" );
+
+    return host::report();
+}
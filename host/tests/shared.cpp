@@ -0,0 +1,96 @@
+
+//==================================================
+// @title        shared.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+static void test_shared()
+{
+    const std::string name = "jmx_test." + std::to_string(getpid());
+    SharedSegment::remove(name);
+
+    mxArray *a = make_matrix( 10, 20 );
+    auto A = get_matrix_rw<double>(a);
+    for ( index_t i = 0; i < A.numel(); ++i ) A[i] = double(i);
+
+    handle_t h = publish_shared( name, a );
+    {
+        auto X = attach_matrix<double>( name );
+        HOST_CHECK( X.nrows() == 10 && X.ncols() == 20 && X(3,4) == 43 );
+        HOST_CHECK( X.mem.segment->refs() == 2 );
+
+        // data is page-aligned, and protected in read-only attachments
+        HOST_CHECK( reinterpret_cast<uintptr_t>(X.mem.segment->data()) % sysconf(_SC_PAGESIZE) == 0 );
+        std::fflush(nullptr);
+        const pid_t pid = fork();
+        if ( pid == 0 ) { const_cast<double&>(X[0]) = -1; _exit(0); }
+        int st = 0;
+        waitpid( pid, &st, 0 );
+        HOST_CHECK( WIFSIGNALED(st) );
+        HOST_CHECK( X[0] == 0 );
+
+        HOST_CHECK_THROWS( attach_matrix<float>( name ), "" );
+        HOST_CHECK_THROWS( attach_volume<double>( name + ".missing" ), "" );
+    }
+
+    // the name is unlinked with the last reference
+    HOST_CHECK( runtime().registry().destroy(h) );
+    HOST_CHECK_THROWS( attach_matrix<double>( name ), "" );
+    mxDestroyArray(a);
+
+    // anonymous segments have unique names, and can be attached (as columns)
+    Matrix_sh<double> S1(3,3), S2(3,3);
+    HOST_CHECK( std::string(S1.mem.name()) != S2.mem.name() );
+    S1(2,2) = 5;
+    HOST_CHECK( attach_vector<double>( S1.mem.name() )[8] == 5 );
+}
+
+static void test_mmap()
+{
+    char path[] = "/tmp/jmx_mmap_XXXXXX";
+    const int fd = mkstemp(path);
+    HOST_CHECK( fd >= 0 );
+    close(fd);
+
+    {
+        auto Y = map_matrix<double>( path, 100, 30 );
+        for ( index_t i = 0; i < Y.numel(); ++i ) Y[i] = 0.5*i;
+        Y.mem.sync();
+    }
+
+    auto X = map_matrix_ro<double>( path, 100, 30 );
+    HOST_CHECK( X(99,29) == 0.5*2999 );
+
+    // offsets need not be page-aligned
+    auto v = map_vector_ro<double>( path, 10, 7*sizeof(double) );
+    HOST_CHECK( v.numel() == 10 && v[0] == 3.5 && v[9] == 8 );
+
+    // private modifications
+    {
+        auto Z = map_matrix<double>( path, 100, 30, MappedFile::CopyOnWrite );
+        Z[0] = -1;
+        HOST_CHECK( Z[0] == -1 );
+    }
+    HOST_CHECK( map_vector_ro<double>( path )[0] == 0 );
+
+    HOST_CHECK_THROWS( map_matrix_ro<double>( path, 100, 31 ), "" );
+    std::remove(path);
+}
+
+int main()
+{
+    test_shared();
+    test_mmap();
+    return host::report();
+}
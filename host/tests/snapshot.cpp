@@ -0,0 +1,182 @@
+
+//==================================================
+// @title        snapshot.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+// struct with sparse, dense (real, complex, large), logical, char and cell fields
+static mxArray* make_tree()
+{
+    SparseBuilder<double> sb( 5, 4 );
+    sb.add( 0, 0, 1.0 );
+    sb.add( 4, 3, 2.5 );
+    sb.add( 2, 1, -1.0 );
+
+    mxArray *big = make_matrix( 1000, 600 );
+    auto b = get_matrix_rw<double>(big);
+    for ( index_t i = 0; i < b.numel(); ++i ) b[i] = double(i % 7);
+
+    mxArray *z = mxCreateDoubleMatrix( 2, 1, mxCOMPLEX );
+    mxArray *cell = mxCreateCellMatrix( 1, 2 );
+    mxSetCell( cell, 0, mxCreateString("abc") );
+    mxSetCell( cell, 1, mxCreateLogicalScalar(true) );
+
+    const char *f[] = { "s", "x", "big", "z", "c" };
+    mxArray *st = mxCreateStructMatrix( 1, 1, 5, f );
+    mxSetField( st, 0, "s", sb.build() );
+    mxSetField( st, 0, "x", mxCreateDoubleScalar(7) );
+    mxSetField( st, 0, "big", big );
+    mxSetField( st, 0, "z", z );
+    mxSetField( st, 0, "c", cell );
+
+#if MX_HAS_INTERLEAVED_COMPLEX
+    mxComplexDouble *pz = mxGetComplexDoubles(z);
+    pz[0].real = 1; pz[0].imag = -2; pz[1].real = 3; pz[1].imag = 4;
+#else
+    double *re = mxGetPr(z), *im = mxGetPi(z);
+    re[0] = 1; im[0] = -2; re[1] = 3; im[1] = 4;
+#endif
+    return st;
+}
+
+static void check_tree( const mxArray *st )
+{
+    HOST_CHECK( mxIsStruct(st) && mxGetNumberOfFields(st) == 5 );
+
+    const mxArray *sp = mxGetField( st, 0, "s" );
+    HOST_CHECK( mxIsSparse(sp) && mxGetM(sp) == 5 && mxGetN(sp) == 4 );
+    const mwIndex *jc = mxGetJc(sp), *ir = mxGetIr(sp);
+    const double *v = mxGetPr(sp);
+    HOST_CHECK( jc[4] == 3 );
+    HOST_CHECK( ir[0] == 0 && v[0] == 1 && ir[1] == 2 && v[1] == -1 && ir[2] == 4 && v[2] == 2.5 );
+    HOST_CHECK( jc[0] == 0 && jc[1] == 1 && jc[2] == 2 && jc[3] == 2 );
+
+    HOST_CHECK( mxGetScalar(mxGetField( st, 0, "x" )) == 7 );
+
+    const mxArray *big = mxGetField( st, 0, "big" );
+    auto b = get_matrix<double>(big);
+    index_t bad = 0;
+    for ( index_t i = 0; i < b.numel(); ++i ) bad += b[i] != double(i % 7);
+    HOST_CHECK( b.nrows() == 1000 && b.ncols() == 600 && bad == 0 );
+
+    const mxArray *z = mxGetField( st, 0, "z" );
+    HOST_CHECK( mxIsComplex(z) );
+#if MX_HAS_INTERLEAVED_COMPLEX
+    const mxComplexDouble *pz = mxGetComplexDoubles(z);
+    HOST_CHECK( pz[0].real == 1 && pz[0].imag == -2 && pz[1].real == 3 && pz[1].imag == 4 );
+#else
+    const double *re = mxGetPr(z), *im = mxGetPi(z);
+    HOST_CHECK( re[0] == 1 && im[0] == -2 && re[1] == 3 && im[1] == 4 );
+#endif
+
+    const mxArray *c = mxGetField( st, 0, "c" );
+    HOST_CHECK( mxIsCell(c) && mxGetNumberOfElements(c) == 2 );
+    HOST_CHECK( get_string(mxGetCell( c, 0 )) == "abc" );
+    HOST_CHECK( mxIsLogical(mxGetCell( c, 1 )) && *mxGetLogicals(mxGetCell( c, 1 )) );
+}
+
+static void test_roundtrip( bool compress )
+{
+    char path[] = "/tmp/jmx_snapshot_XXXXXX";
+    const int fd = mkstemp(path);
+    HOST_CHECK( fd >= 0 );
+    close(fd);
+
+    mxArray *st = make_tree();
+    save_snapshot( path, st, compress );
+    mxDestroyArray(st);
+
+    Snapshot s(path);
+    HOST_CHECK( s.valid() && s.is_struct(s.root()) );
+
+    mxArray *out = s.materialize();
+    check_tree(out);
+    mxDestroyArray(out);
+
+    // zero-copy access
+    auto x = s.mat<double>( s.field( s.root(), "big" ) );
+    HOST_CHECK( x.nrows() == 1000 && x(6,0) == 6 && x(999,599) == double((999 + 599*1000) % 7) );
+    HOST_CHECK( s.is_sparse( s.field( s.root(), "s" ) ) );
+
+    s.close();
+    std::remove(path);
+}
+
+// patch a table entry of a valid snapshot, which should then fail to open
+template <class T>
+static void test_corrupt( const mxArray *ms, index_t table, index_t entry, index_t offset, T value )
+{
+    char path[] = "/tmp/jmx_snapshot_XXXXXX";
+    const int fd = mkstemp(path);
+    HOST_CHECK( fd >= 0 );
+    close(fd);
+    save_snapshot( path, ms );
+
+    Snapshot::Header h;
+    FILE *f = std::fopen( path, "r+b" );
+    HOST_CHECK( f && std::fread( &h, sizeof(h), 1, f ) == 1 );
+
+    const index_t size[] = { sizeof(Snapshot::Node), sizeof(Snapshot::Segment), sizeof(uint64_t) };
+    const index_t count[] = { h.nnodes, h.nsegs, h.ndims };
+    index_t pos = h.tables;
+    for ( index_t t = 0; t < table; ++t ) pos += size[t]*count[t];
+
+    std::fseek( f, pos + entry*size[table] + offset, SEEK_SET );
+    std::fwrite( &value, sizeof(T), 1, f );
+    std::fclose(f);
+
+    HOST_CHECK_THROWS( Snapshot s(path), "" );
+    std::remove(path);
+}
+
+// sizes of segments, segment counts and children are checked against the nodes
+static void test_validation()
+{
+    using Node = Snapshot::Node;
+    using Segment = Snapshot::Segment;
+
+    mxArray *m = make_matrix( 10, 10 );
+    test_corrupt<uint64_t>( m, 2, 0, 0, 1000 );                         // larger dimensions
+    test_corrupt<uint64_t>( m, 1, 0, offsetof(Segment,bytes), 8 );      // shorter segment
+    test_corrupt<uint64_t>( m, 1, 0, offsetof(Segment,stored), 8 );     // truncated data
+    test_corrupt<uint32_t>( m, 0, 0, offsetof(Node,flags), Snapshot::Sparse );
+    test_corrupt<uint32_t>( m, 0, 0, offsetof(Node,flags), Snapshot::Complex );
+    mxDestroyArray(m);
+
+    // struct with children but no fields
+    const char *f[] = { "a" };
+    mxArray *st = mxCreateStructMatrix( 1, 1, 1, f );
+    mxSetField( st, 0, "a", mxCreateDoubleScalar(1) );
+    test_corrupt<uint32_t>( st, 0, 0, offsetof(Node,nfields), 0 );
+    mxDestroyArray(st);
+
+    // sparse matrix with fewer columns in Jc
+    SparseBuilder<double> sb( 5, 4 );
+    sb.add( 0, 0, 1.0 );
+    mxArray *sp = sb.build();
+    test_corrupt<uint64_t>( sp, 1, 0, offsetof(Segment,bytes), 16 );
+    test_corrupt<uint64_t>( sp, 2, 1, 0, 40 );
+    mxDestroyArray(sp);
+}
+
+int main()
+{
+    test_roundtrip( false );
+    test_roundtrip( true );
+    HOST_CHECK_THROWS( Snapshot( "/nonexistent/jmx.snapshot" ), "" );
+    test_validation();
+    return host::report();
+}
@@ -0,0 +1,122 @@
+
+//==================================================
+// @title        sparse.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <cmath>
+#include <map>
+#include <random>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+// triplets added in parallel, duplicates summed, and cancelled entries dropped
+static void test_builder( index_t nr, index_t nc, index_t n )
+{
+    using key_t = std::pair<index_t,index_t>; // column, row
+    std::map<key_t,double> ref;
+
+    std::mt19937 g(nc);
+    std::vector<index_t> R(n), C(n);
+    std::vector<double> V(n);
+    for ( index_t k = 0; k < n && nc > 0; ++k ) {
+        R[k] = g() % nr; C[k] = g() % nc; V[k] = double(g() % 5) - 2;
+        ref[key_t(C[k],R[k])] += V[k];
+    }
+
+    SparseBuilder<double> sb( nr, nc );
+    if ( nc > 0 )
+        parallel_chunks( 0, n, [&]( index_t b, index_t e, index_t tid ) {
+            for ( index_t k = b; k < e; ++k ) sb.add( tid, R[k], C[k], V[k] );
+        });
+
+    mxArray *ms = sb.build();
+    HOST_CHECK( mxIsSparse(ms) && mxGetM(ms) == nr && mxGetN(ms) == nc );
+    HOST_CHECK( sb.size() == 0 );
+
+    const mwIndex *ir = mxGetIr(ms), *jc = mxGetJc(ms);
+    const double *pr = mxGetPr(ms);
+
+    index_t nnz = 0, bad = 0;
+    for ( auto& kv: ref ) nnz += kv.second != 0;
+    for ( index_t c = 0; c < nc; ++c )
+    for ( mwIndex k = jc[c]; k < jc[c+1]; ++k ) {
+        bad += k > jc[c] && ir[k] <= ir[k-1];
+        bad += pr[k] == 0 || ref[key_t(c,ir[k])] != pr[k];
+    }
+    HOST_CHECK( jc[nc] == nnz );
+    HOST_CHECK( bad == 0 );
+    mxDestroyArray(ms);
+}
+
+static void test_logical()
+{
+    SparseBuilder<bool> sb( 3, 3 );
+    sb.add( 0, 1, true );
+    sb.add( 0, 1, true );
+    sb.add( 2, 2, false );
+
+    mxArray *ms = sb.build();
+    HOST_CHECK( mxIsLogical(ms) && mxIsSparse(ms) );
+    HOST_CHECK( mxGetJc(ms)[3] == 1 );
+    mxDestroyArray(ms);
+
+    HOST_CHECK_THROWS( make_sparse( 3, 3, 2, mxSINGLE_CLASS ), "" );
+    HOST_CHECK_THROWS( make_sparse( 3, 3, 2, mxLOGICAL_CLASS, mxCOMPLEX ), "" );
+}
+
+// kernels against a serial reference
+static void test_kernels()
+{
+    const index_t nr = 2000, nc = 3000;
+    std::mt19937 g(1);
+
+    SparseBuilder<double> sb( nr, nc );
+    for ( index_t k = 0; k < 50000; ++k )
+        sb.add( g() % nr, g() % nc, 1.0 + g() % 3 );
+
+    mxArray *ms = sb.build();
+    auto A = get_sparse<double>(ms);
+
+    mxArray *mx = make_vector( nc, true ), *my = make_vector( nr, true );
+    auto x = get_vector_rw<double>(mx);
+    auto y = get_vector_rw<double>(my);
+    for ( index_t c = 0; c < nc; ++c ) x[c] = std::sin(double(c));
+
+    std::vector<double> r( nr, 0 ), rmax( nr, 0 );
+    for ( index_t c = 0; c < nc; ++c )
+    for ( index_t k = A.jc[c]; k < A.jc[c+1]; ++k ) {
+        r[A.ir[k]] += A.val[k] * x[c];
+        rmax[A.ir[k]] = std::max( rmax[A.ir[k]], A.val[k] );
+    }
+
+    spmv( A, x, y );
+    double err = 0;
+    for ( index_t i = 0; i < nr; ++i ) err = std::max( err, std::abs(y[i] - r[i]) );
+    HOST_CHECK( err < 1e-10 );
+
+    row_reduce( A, y, 0.0, []( double a, double b ) { return std::max(a,b); } );
+    index_t bad = 0;
+    for ( index_t i = 0; i < nr; ++i ) bad += y[i] != rmax[i];
+    HOST_CHECK( bad == 0 );
+
+    mxDestroyArray(mx);
+    mxDestroyArray(my);
+    mxDestroyArray(ms);
+}
+
+int main()
+{
+    test_builder( 50, 0, 0 );
+    test_builder( 50, 1, 20000 );
+    test_builder( 50, 7, 20000 );
+    test_builder( 50, 1000, 20000 );
+    test_logical();
+    test_kernels();
+    return host::report();
+}
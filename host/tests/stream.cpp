@@ -0,0 +1,161 @@
+
+//==================================================
+// @title        stream.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+static const index_t nr = 30, nc = 20, ns = 23, nslices = 3;
+
+// slab contents match the slices of the volume, where vol[i] = i
+static bool slab_valid( const Slab<double>& s )
+{
+    const index_t first = nr*nc*s.first;
+    if ( s.count != std::min( nslices, ns - s.first ) || s.data.ns != s.count ) return false;
+    for ( index_t i = 0; i < s.data.numel(); ++i )
+        if ( s.data[i] != double(first + i) ) return false;
+    return true;
+}
+
+// ordered completion, and slots unique among slabs in flight
+static void test_ordered( SlabStream<double>& stream )
+{
+    std::vector<index_t> order;
+    std::vector< std::atomic<int> > busy( stream.depth() );
+    std::atomic<int> bad(0);
+    for ( auto& b: busy ) b = 0;
+
+    stream.run(
+        [&]( const Slab<double>& s, index_t tid ) {
+            bad += tid >= stream.depth() || busy[tid]++ != 0 || !slab_valid(s);
+            std::this_thread::sleep_for( std::chrono::milliseconds( (s.index * 7) % 5 ) );
+            --busy[tid];
+        },
+        [&]( const Slab<double>& s ) { order.push_back(s.index); },
+        true
+    );
+
+    HOST_CHECK( bad == 0 && order.size() == stream.nslabs() );
+    for ( index_t k = 0; k < order.size(); ++k ) bad += order[k] != k;
+    HOST_CHECK( bad == 0 );
+}
+
+static void test_stream()
+{
+    mxArray *mv = make_volume( nr, nc, ns );
+    auto vol = get_volume_rw<double>(mv);
+    for ( index_t i = 0; i < vol.numel(); ++i ) vol[i] = double(i);
+
+    // views, and staged copies
+    SlabStream<double> s1( vol, nslices ), s2( vol, nslices, true );
+    HOST_CHECK( s1.nslabs() == 8 && s1.depth() == runtime().pool().size() + 2 );
+    test_ordered(s1);
+    test_ordered(s2);
+
+    // raw file, with an offset
+    char path[] = "/tmp/jmx_stream_XXXXXX";
+    const int fd = mkstemp(path);
+    const double header[2] = { -1, -1 };
+    HOST_CHECK( fd >= 0 && write( fd, header, sizeof(header) ) == sizeof(header) );
+    HOST_CHECK( write( fd, vol.memptr(), vol.numel()*sizeof(double) ) == ssize_t(vol.numel()*sizeof(double)) );
+    close(fd);
+
+    SlabStream<double> s3( path, nr, nc, ns, nslices, sizeof(header) );
+    s3.set_depth(2);
+    test_ordered(s3);
+
+    // slabs past the end of the file
+    SlabStream<double> s4( path, nr, nc, ns+1, nslices, sizeof(header) );
+    HOST_CHECK_THROWS( s4.run( []( const Slab<double>&, index_t ) {} ), "" );
+    std::remove(path);
+
+    // unordered: each slab completed once, as soon as it is done (the first slab is slow)
+    std::vector<index_t> order;
+    std::atomic<int> bad(0);
+    s1.run(
+        [&]( const Slab<double>& s, index_t ) {
+            bad += !slab_valid(s);
+            if ( s.index == 0 ) std::this_thread::sleep_for( std::chrono::milliseconds(100) );
+        },
+        [&]( const Slab<double>& s ) { order.push_back(s.index); },
+        false
+    );
+    std::vector<index_t> sorted(order);
+    std::sort( sorted.begin(), sorted.end() );
+    HOST_CHECK( bad == 0 && sorted.size() == s1.nslabs() );
+    HOST_CHECK( order[0] != 0 || runtime().pool().size() < 2 );
+    for ( index_t k = 0; k < sorted.size(); ++k ) bad += sorted[k] != k;
+    HOST_CHECK( bad == 0 );
+
+    // nested in a worker: serial (the calling thread may take an iteration)
+    std::vector<index_t> nested(2,0);
+    parallel_for( 0, 2, [&]( index_t j ) {
+        const bool worker = is_worker_thread();
+        s2.run( [&]( const Slab<double>& s, index_t tid ) { nested[j] += slab_valid(s) && (tid == 0 || !worker); } );
+    }, 1 );
+    HOST_CHECK( nested[0] == s2.nslabs() && nested[1] == s2.nslabs() );
+
+    mxDestroyArray(mv);
+}
+
+// errors cancel the slabs not yet started, and are rethrown by run
+static void test_errors()
+{
+    mxArray *mv = make_volume( nr, nc, ns );
+    auto vol = get_volume_rw<double>(mv);
+    SlabStream<double> s( vol, 1 );
+    s.set_depth(2);
+
+    std::atomic<int> processed(0);
+    std::vector<index_t> completed;
+    auto fail_at = [&]( index_t k ) {
+        return [&,k]( const Slab<double>& b, index_t ) {
+            ++processed;
+            if ( b.index == k ) JMX_THROW_ID( "test:slab", "slab %zu failed", size_t(k) );
+            std::this_thread::sleep_for( std::chrono::milliseconds(5) );
+        };
+    };
+    auto complete = [&]( const Slab<double>& b ) { completed.push_back(b.index); };
+
+    // in a worker
+    HOST_CHECK_THROWS( s.run( fail_at(3), complete, true ), "test:slab" );
+    HOST_CHECK( processed <= 3+2 && completed.size() <= 3 );
+    for ( index_t k = 0; k < completed.size(); ++k ) HOST_CHECK( completed[k] == k );
+
+    processed = 0; completed.clear();
+    HOST_CHECK_THROWS( s.run( fail_at(0), complete, false ), "test:slab" );
+    HOST_CHECK( processed <= 2 && completed.size() <= 1 );
+
+    // in the completion, on the calling thread: slabs in flight are waited for
+    processed = 0;
+    index_t ncomplete = 0;
+    HOST_CHECK_THROWS( s.run( fail_at(ns), [&]( const Slab<double>& b ) {
+        ++ncomplete;
+        if ( b.index == 1 ) JMX_THROW_ID( "test:complete", "completion failed" );
+    }, true ), "test:complete" );
+    HOST_CHECK( ncomplete == 2 && processed <= 2+2 );
+
+    // the stream can be run again
+    processed = 0;
+    s.run( fail_at(ns) );
+    HOST_CHECK( processed == int(ns) );
+
+    mxDestroyArray(mv);
+}
+
+int main()
+{
+    test_stream();
+    test_errors();
+    return host::report();
+}
@@ -0,0 +1,108 @@
+
+//==================================================
+// @title        strings.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+// char row-vector with the given UTF-16 code units
+static mxArray* make_chars( const std::vector<mxChar>& u )
+{
+    const mwSize size[2] = { 1, u.size() };
+    mxArray *ms = mxCreateCharArray( 2, size );
+    std::copy( u.begin(), u.end(), mxGetChars(ms) );
+    return ms;
+}
+
+// cellstr round-trip, with ASCII runs longer than a vector register, and multi-byte sequences
+static void test_roundtrip()
+{
+    const std::vector<std::string> strs = {
+        "",
+        "plain ascii, long enough for the vectorised conversion",
+        "caf\xC3\xA9 cr\xC3\xA8me",                     // 2 bytes
+        "\xE2\x82\xAC 100 and \xE6\x97\xA5\xE6\x9C\xAC", // 3 bytes
+        "\xF0\x9F\x98\x80 smile \xF0\x9D\x84\x9E",       // 4 bytes (surrogate pairs)
+        "a"
+    };
+
+    mxArray *cs = make_cellstr( strs );
+    HOST_CHECK( mxIsCell(cs) && mxGetNumberOfElements(cs) == strs.size() );
+
+    // UTF-16 code units
+    const mxArray *e = mxGetCell( cs, 4 );
+    const mxChar *u = mxGetChars(e);
+    HOST_CHECK( mxGetNumberOfElements(e) == 11 );
+    HOST_CHECK( u[0] == 0xD83D && u[1] == 0xDE00 && u[2] == ' ' );
+    HOST_CHECK( mxGetNumberOfElements(mxGetCell( cs, 0 )) == 0 );
+    HOST_CHECK( mxGetChars(mxGetCell( cs, 2 ))[3] == 0xE9 );
+
+    CellStr c(cs);
+    HOST_CHECK( c.size() == strs.size() );
+    index_t bad = 0, bytes = 0;
+    for ( index_t k = 0; k < strs.size(); ++k ) {
+        bad += c[k] != string_view(strs[k]) || c.c_str(k)[c.length(k)] != 0;
+        bytes += strs[k].size() + 1;
+    }
+    HOST_CHECK( bad == 0 && c.nbytes() == bytes );
+    mxDestroyArray(cs);
+}
+
+// invalid sequences are replaced with U+FFFD
+static void test_invalid()
+{
+    mxArray *cs = make_cell(3);
+    mxSetCell( cs, 0, make_chars({ 'a', 0xD800, 'b' }) );   // unpaired high surrogate
+    mxSetCell( cs, 1, make_chars({ 0xDC00 }) );             // unpaired low surrogate
+    mxSetCell( cs, 2, make_chars({ 'x', 0xD83D }) );        // truncated pair
+
+    CellStr c(cs);
+    HOST_CHECK( c[0] == string_view("a\xEF\xBF\xBD" "b") );
+    HOST_CHECK( c[1] == string_view("\xEF\xBF\xBD") );
+    HOST_CHECK( c[2] == string_view("x\xEF\xBF\xBD") );
+    mxDestroyArray(cs);
+
+    // overlong encoding, encoded surrogate, and stray continuation byte
+    const std::string in[] = { "\xC0\xAF", "\xED\xA0\x80", "a\x80" };
+    for ( auto& s: in ) {
+        std::vector<mxChar> out( utf16_length( s.data(), s.size() ) );
+        const mxChar *end = utf8_to_utf16( s.data(), s.size(), out.data() );
+        HOST_CHECK( end == out.data() + out.size() );
+        HOST_CHECK( !out.empty() && out.back() == 0xFFFD );
+    }
+
+    // elements should be strings
+    mxArray *bad = make_cell(2);
+    mxSetCell( bad, 0, make_chars({ 'a' }) );
+    mxSetCell( bad, 1, mxCreateDoubleScalar(1) );
+    HOST_CHECK_THROWS( CellStr c2(bad), "" );
+    mxDestroyArray(bad);
+}
+
+static void test_intern()
+{
+    mxArray *cs = make_cellstr( std::vector<std::string>{ "b", "a", "b", "\xC3\xA9", "a", "" } );
+    std::vector<index_t> codes;
+    std::vector<string_view> labels;
+
+    // labels are views into the CellStr
+    CellStr c(cs);
+    HOST_CHECK( c.intern( codes, labels ) == 4 );
+    HOST_CHECK( (codes == std::vector<index_t>{ 0, 1, 0, 2, 1, 3 }) );
+    HOST_CHECK( labels.size() == 4 && labels[0] == string_view("b") && labels[3] == string_view("") );
+    mxDestroyArray(cs);
+}
+
+int main()
+{
+    test_roundtrip();
+    test_invalid();
+    test_intern();
+    return host::report();
+}
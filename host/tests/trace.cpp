@@ -0,0 +1,145 @@
+
+//==================================================
+// @title        trace.cpp
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "check.h"
+
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace jmx;
+
+// ------------------------------------------------------------------------
+
+static std::string read_file( const std::string& path )
+{
+    std::ifstream f(path);
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+static index_t count( const std::string& s, const std::string& x )
+{
+    index_t n = 0;
+    for ( auto p = s.find(x); p != std::string::npos; p = s.find( x, p+1 ) ) ++n;
+    return n;
+}
+
+// strings are terminated and free of control characters, and brackets are balanced
+static bool json_valid( const std::string& s )
+{
+    std::string stack;
+    for ( index_t k = 0; k < s.size(); ++k ) {
+        const char c = s[k];
+        if ( c == '"' ) {
+            for ( ++k; k < s.size() && s[k] != '"'; ++k ) {
+                if ( static_cast<unsigned char>(s[k]) < 0x20 ) return false;
+                if ( s[k] == '\\' ) ++k;
+            }
+            if ( k >= s.size() ) return false;
+        }
+        else if ( c == '[' || c == '{' ) stack.push_back( c == '[' ? ']' : '}' );
+        else if ( c == ']' || c == '}' ) {
+            if ( stack.empty() || stack.back() != c ) return false;
+            stack.pop_back();
+        }
+    }
+    return stack.empty();
+}
+
+static void record( const char *name, const char *cat="test" )
+{
+    const auto t = trace_clock::now();
+    trace_event( name, cat, t, t + std::chrono::microseconds(1) );
+}
+
+// ----------  =====  ----------
+
+static void test_ring( const std::string& path )
+{
+    // nothing recorded while off
+    { JMX_TRACE_SCOPE( "off", "test" ); }
+    trace_start(16);
+    HOST_CHECK( trace_count() == 0 && trace_dropped() == 0 );
+
+    // the oldest events are overwritten, and names are copied
+    {
+        std::vector<std::string> names;
+        for ( int k = 0; k < 40; ++k ) names.push_back( "event_" + std::to_string(k) );
+        for ( auto& n: names ) record( n.c_str() );
+        for ( auto& n: names ) n.assign( n.size(), 'x' );
+    }
+    HOST_CHECK( trace_count() == 40 && trace_dropped() == 24 );
+
+    trace_write(path);
+    const std::string s = read_file(path);
+    HOST_CHECK( json_valid(s) && count( s, "\"ph\":\"X\"" ) == 16 );
+    HOST_CHECK( s.find("\"dropped\":24") != std::string::npos );
+    HOST_CHECK( s.find("event_23\"") == std::string::npos && s.find("xxx") == std::string::npos );
+    HOST_CHECK( s.find("event_24\"") < s.find("event_39\"") && s.find("event_39\"") != std::string::npos );
+
+    // recording resumes after writing, and stops with trace_stop
+    record( "after" );
+    HOST_CHECK( trace_count() == 41 );
+    trace_stop();
+    record( "stopped" );
+    { JMX_TRACE_SCOPE( "stopped", "test" ); }
+    HOST_CHECK( trace_count() == 41 && !trace_enabled() );
+
+    // restarting clears the buffers
+    trace_start(16);
+    HOST_CHECK( trace_count() == 0 && trace_dropped() == 0 );
+    trace_stop();
+}
+
+// each thread has its own ring
+static void test_threads( const std::string& path )
+{
+    const index_t nthreads = runtime().pool().size();
+    trace_start(8);
+    parallel_for( 0, 64, [&]( index_t ) {
+        for ( int k = 0; k < 20; ++k ) { JMX_TRACE_SCOPE( "inner", "test" ); }
+    }, 1 );
+
+    // the loop records its own events (chunks and tasks); stop, so that counts are final
+    trace_stop();
+    const index_t n = trace_count(), d = trace_dropped();
+    HOST_CHECK( n >= 64*20 && d >= n - 8*(nthreads+1) && d < n );
+
+    trace_write(path);
+    const std::string s = read_file(path);
+    HOST_CHECK( json_valid(s) && index_t(count( s, "\"ph\":\"X\"" )) == n - d );
+    HOST_CHECK( s.find("\"dropped\":" + std::to_string(d) + "}") != std::string::npos );
+}
+
+// names and categories are escaped
+static void test_escape( const std::string& path )
+{
+    trace_start();
+    record( "quote\" back\\slash", "new\nline\ttab" );
+    trace_write(path);
+    trace_stop();
+
+    const std::string s = read_file(path);
+    HOST_CHECK( json_valid(s) );
+    HOST_CHECK( s.find("\"quote\\\" back\\\\slash\"") != std::string::npos );
+    HOST_CHECK( s.find("\"new\\u000aline\\u0009tab\"") != std::string::npos );
+
+    HOST_CHECK_THROWS( trace_write( "/nonexistent/trace.json" ), "" );
+    HOST_CHECK_THROWS( trace_start(0), "" );
+}
+
+int main()
+{
+    const std::string path = "/tmp/jmx_trace." + std::to_string(getpid()) + ".json";
+    test_ring(path);
+    test_threads(path);
+    test_escape(path);
+    std::remove( path.c_str() );
+    return host::report();
+}
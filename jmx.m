@@ -9,22 +9,69 @@ function cmd = jmx( files, options, varargin )
 %
 % options + additional inputs: see jmx_compile for help
 %
+% In addition, the following options are accepted:
+%
+%   shared      false   Link against the shared runtime inc/libjmx.so (see jmx_build),
+%                       instead of the object file inc/jmx.o.
+%
+%   bundle      ''      Name of the Mex file to create from several source files.
+%                       Each source file implements one or more commands with JMX_COMMAND,
+%                       and the gateway (src/router.cpp) dispatches on the first input.
+%                       See src/router.h for details.
+%
+% Example:
+%   jmx( {'foo.cpp','bar.cpp'}, struct('bundle','mylib') );
+%   mylib( 'foo', ... );
+%
 % See also: jmx_compile
 %
 % JH
 
     if nargin < 2, options=struct(); end
 
-    objfile = jmx_path('inc/jmx.o');
-    if exist(objfile,'file') ~= 2
-        jmx_build();
+    shared = isfield(options,'shared') && options.shared;
+    if isfield(options,'shared')
+        options = rmfield(options,'shared');
+    end
+
+    % the runtime must be compiled with the same complex API
+    interleaved = isfield(options,'interleaved') && options.interleaved;
+    if interleaved
+        name = 'jmx_ic';
+        flags = {'interleaved'};
+    else
+        name = 'jmx';
+        flags = {};
+    end
+
+    objfile = jmx_path('inc',[name '.o']);
+    libfile = jmx_path('inc',['lib' name '.so']);
+    if shared
+        if exist(libfile,'file') ~= 2, jmx_build('shared',flags{:}); end
+    else
+        if exist(objfile,'file') ~= 2, jmx_build(flags{:}); end
     end
     
     if ~iscell(files)
         files = {files};
     end
     assert( iscellstr(files), 'Bad files list.' );
-    files{end+1} = objfile;
+
+    if isfield(options,'bundle')
+        bundle = options.bundle;
+        options = rmfield(options,'bundle');
+        assert( ischar(bundle) && ~isempty(bundle), 'Bundle name should be a string.' );
+
+        options.outfile = bundle;
+        files{end+1} = jmx_path('src/router.cpp');
+    end
+    
+    if shared
+        libdir = jmx_path('inc');
+        varargin = [ varargin, {'lpath',libdir,'lib',name,'link',['-Wl,-rpath,' libdir]} ];
+    else
+        files{end+1} = objfile;
+    end
     
     cmd = jmx_compile( files, options, varargin{:} );
 
@@ -1,19 +1,73 @@
 function jmx_build(varargin)
 %
 % jmx_build(varargin)
+% jmx_build(flags...,varargin)
 % 
 % Build the JMX binaries.
 % Settings can be supplied (see jmx_compile for help).
 %
+% By default, the runtime is compiled as an object file (inc/jmx.o), which is linked
+% statically into each Mex file. With the 'shared' flag, it is also linked as a shared
+% library inc/libjmx.so.<abi> (Linux only), such that all Mex files compiled with the
+% option shared=true (see jmx) use a single runtime per Matlab session.
+%
+% With the 'interleaved' flag, the runtime is compiled with the interleaved complex API,
+% and the binaries are named jmx_ic instead of jmx (e.g. inc/jmx_ic.o).
+%
 % See also: jmx_compile, jmx
 %
 % JH
 
+    shared = false;
+    interleaved = false;
+    while ~isempty(varargin) && ischar(varargin{1})
+        switch lower(varargin{1})
+            case 'shared'
+                shared = true;
+            case 'interleaved'
+                interleaved = true;
+            otherwise
+                break;
+        end
+        varargin = varargin(2:end);
+    end
+    
+    if interleaved
+        name = 'jmx_ic';
+    else
+        name = 'jmx';
+    end
+
     opt.mex = false;
     opt.cpp11 = true;
     opt.optimise = true;
+    opt.interleaved = interleaved;
     
+    objfile = jmx_path('inc',[name '.o']);
     jmx_compile( jmx_path('src/main.cpp'), opt, 'lib', 'ut', varargin{:} );
-    movefile( jmx_path('src/main.o'), jmx_path('inc/jmx.o') );
+    movefile( jmx_path('src/main.o'), objfile );
+
+    if shared
+        assert( isunix && ~ismac, 'The shared runtime is only supported on Linux.' );
+
+        libname = sprintf( 'lib%s.so.%d', name, abi_version() );
+        libdir = fullfile( matlabroot, 'bin', computer('arch') );
+        cmd = sprintf( 'g++ -shared -pthread -Wl,-soname,%s -o "%s" "%s" -L"%s" -lmx -lmex -lmat -lut -lrt', ...
+            libname, jmx_path('inc',libname), objfile, libdir );
+
+        disp(cmd);
+        assert( system(cmd) == 0, 'Failed to link the shared runtime.' );
+        
+        % unversioned name used by the linker
+        cmd = sprintf( 'ln -sf %s "%s"', libname, jmx_path('inc',['lib' name '.so']) );
+        assert( system(cmd) == 0, 'Failed to create symbolic link.' );
+    end
     
-end
\ No newline at end of file
+end
+
+function v = abi_version()
+    txt = fileread(jmx_path('src/runtime.h'));
+    tok = regexp( txt, '#define JMX_ABI_VERSION (\d+)', 'tokens', 'once' );
+    assert( ~isempty(tok), 'Could not find ABI version in runtime.h' );
+    v = str2double(tok{1});
+end
@@ -23,6 +23,10 @@ function cmd = jmx_compile( files, options, varargin )
 %   index32     false             Newer versions of Matlab use 64-bits indices (-largeArrayDims).
 %                                 Set to true to use 32-bits legacy indexing (-compatibleArrayDims).
 %
+%   interleaved false             Use the interleaved complex API (-R2018a, Matlab 2018a or later).
+%                                 Complex data can then be accessed as std::complex<T> without copy.
+%                                 All files linked together must use the same API (see jmx_build).
+%
 %   outdir      pwd    -outdir    The folder in which to put the compiled object.
 %   outfile     ''     -ouput     The name of the compiled file.
 %   mexopts     ''     -f         Path to an .xml file with custom Mex options.
@@ -37,7 +41,10 @@ function cmd = jmx_compile( files, options, varargin )
 %
 % ** settings
 % 
+%   Settings with the same name are concatenated.
+%
 %   flag                CXXFLAGS
+%   link                LDFLAGS
 %   def                 -D
 %   undef               -U
 %   lib                 -l
@@ -72,6 +79,9 @@ function cmd = jmx_compile( files, options, varargin )
         S = append(S,'ipath',jmx_path('inc'));
         S = append(S,'lib','ut');
     end
+    if T.jmx && isunix && ~ismac
+        S = append(S,'lib','rt'); % shm_open with older glibc
+    end
     if T.arma 
         S = append(S,'lib','lapack'); % provided by Matlab
         S = append(S,'lib','blas');
@@ -81,7 +91,10 @@ function cmd = jmx_compile( files, options, varargin )
     % build command
     cmd = {};
     
-    if T.index32
+    if T.interleaved
+        assert( ~T.index32, 'The interleaved complex API requires 64-bits indices.' );
+        cmd{end+1} = '-R2018a';
+    elseif T.index32
         cmd{end+1} = '-compatibleArrayDims';
     else
         cmd{end+1} = '-largeArrayDims';
@@ -135,6 +148,7 @@ function out = parse_options(in,filedir)
     % detect integer width
     [~,maxArraySize] = computer();
     out.index32 = maxArraySize <= pow2(31);
+    out.interleaved = false;
 
     out.optimise = false;
     out.verbose = false;
@@ -194,22 +208,26 @@ function s = parse_settings(varargin)
         
         switch lower(name)
             case {'flag'}
-                s.flag = value;
+                field = 'flag';
             case {'lnk','link'}
-                s.link = value;
+                field = 'link';
             case {'def','define'}
-                s.def = value;
+                field = 'def';
             case {'undef','undefine'}
-                s.undef = value;
+                field = 'undef';
             case {'lib','library'}
-                s.lib = value;
+                field = 'lib';
             case {'lpath','ldpath'}
-                s.lpath = value;
+                field = 'lpath';
             case {'ipath','inc','incpath'}
-                s.ipath = value;
+                field = 'ipath';
             otherwise
                 error('Unknown setting: %s', name);
         end
+        
+        for j = 1:numel(value)
+            s = append(s,field,value{j});
+        end
     end
     
 end
@@ -224,6 +242,10 @@ function [flag, def, undef, lpath, lib, ipath] = process_settings(s)
         flag = {};
     end
     
+    if isfield(s,'link')
+        flag{end+1} = ['LDFLAGS="$LDFLAGS ' strjoin(s.link) '"'];
+    end
+    
     if isfield(s,'def')
         def = prefix( s.def, '-D' );
     else
@@ -0,0 +1,106 @@
+#ifndef JMX_ACCOUNTING_H_INCLUDED
+#define JMX_ACCOUNTING_H_INCLUDED
+
+//==================================================
+// @title        accounting.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "common.h"
+
+// ------------------------------------------------------------------------
+
+/**
+ * Accounting of the memory allocated by jmx, to find which gateway allocates what:
+ *
+ *      JMX_ALLOC_TAG("assembly");              // tag allocations until the end of the scope
+ *      set_alloc_budget( 4ULL << 30 );         // fail fast above 4GB per call (0 to disable)
+ *      args.out.assign( 0, make_alloc_info() );
+ *
+ * Containers with MatlabMemory or CppMemory are tracked from alloc to free. Arrays created
+ * by make_* are counted as live until the end of the call (Matlab owns them afterwards),
+ * and conversion buffers of getters (strings, bit masks, cellstr) are counted and checked
+ * against the budget, but not held. Allocations are tagged with the innermost tag of the
+ * calling thread (the command in bundles, or the name of the Mex file by default); parallel
+ * loops pass the tag to their workers. Frees are charged to the tag of the allocation.
+ *
+ * The budget applies to the bytes live in the current call: allocations which would exceed
+ * it throw JMX:budget before allocating. In debug builds (without NDEBUG), the call stacks
+ * of allocations larger than JMX_ALLOC_LARGE bytes are recorded.
+ */
+
+#ifndef JMX_ALLOC_LARGE
+#define JMX_ALLOC_LARGE (64 << 20) // bytes
+#endif
+
+#ifndef JMX_ALLOC_SITES
+#define JMX_ALLOC_SITES 16  // most recent large allocations kept
+#endif
+
+#define JMX_ALLOC_TAG( name ) \
+    jmx::AllocTag JMX_CONCAT(_jmx_alloc_tag_,__LINE__)( name )
+
+namespace jmx {
+
+    struct AllocStats
+    {
+        index_t count, bytes;   // allocations, and bytes allocated
+        index_t current, peak;  // bytes live
+    };
+
+    // interned tag, kept by the memory policies with their allocation
+    struct _AllocTagStats;
+
+    // hooks (in bytes); acquire returns the tag to charge the release to
+    _AllocTagStats* alloc_acquire( index_t bytes );                             // tracked until release
+    void alloc_release( _AllocTagStats *tag, index_t bytes, bool output=false ); // output: given to Matlab
+    void alloc_output( index_t bytes );                     // created for Matlab (make_*)
+    void alloc_transient( index_t bytes );                  // conversion buffers
+
+    // tag of the calling thread
+    const char*& _alloc_tag();
+
+    class AllocTag
+    {
+    public:
+
+        AllocTag( const char *name )
+            : m_outer(_alloc_tag()) { _alloc_tag() = name; }
+        ~AllocTag()
+            { _alloc_tag() = m_outer; }
+
+        AllocTag( const AllocTag& ) = delete;
+        AllocTag& operator= ( const AllocTag& ) = delete;
+
+    private:
+        const char *m_outer;
+    };
+
+    // ----------  =====  ----------
+
+    // maximum number of bytes live in one call (0: unlimited)
+    void set_alloc_budget( index_t bytes );
+    index_t alloc_budget();
+
+    // called by Arguments
+    void alloc_begin_call();
+    void alloc_end_call();
+
+    // totals since loading, current call, and last complete call
+    AllocStats alloc_total();
+    AllocStats alloc_call();
+    AllocStats alloc_last_call();
+
+    void alloc_reset();
+
+    /**
+     * Struct with fields total, call and last (count, bytes, current and peak), budget,
+     * tags (struct array with the name of each tag), and sites (struct array with the
+     * bytes, tag and stack of large allocations, in debug builds).
+     */
+    mxArray* make_alloc_info();
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef JMX_ARENA_H_INCLUDED
+#define JMX_ARENA_H_INCLUDED
+
+//==================================================
+// @title        arena.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <mutex>
+#include <vector>
+
+// ------------------------------------------------------------------------
+
+namespace jmx {
+
+    /**
+     * Thread-safe pool of aligned memory blocks, reused across Mex calls.
+     *
+     * Blocks are sorted into power-of-two size classes; released blocks are kept for
+     * later requests of the same class, instead of being returned to the system.
+     * This avoids paying for large scratch allocations (and page faults) on every call.
+     */
+    class Arena
+    {
+    public:
+
+        static const index_t alignment = 64;
+        static const index_t nclasses = 48;
+
+        Arena()
+            : m_reserved(0) {}
+        ~Arena()
+            { clear(); }
+
+        // the size of the block returned is capacity(bytes)
+        void* acquire( index_t bytes );
+        void release( void *ptr, index_t bytes );
+
+        // free all blocks currently held by the arena
+        void clear();
+
+        // number of bytes currently held (not in use)
+        index_t reserved() const;
+
+        static index_t size_class( index_t bytes );
+        static inline index_t capacity( index_t bytes )
+            { return index_t(alignment) << size_class(bytes); }
+
+    private:
+
+        mutable std::mutex m_mutex;
+        std::vector<void*> m_free[nclasses];
+        index_t m_reserved;
+    };
+
+    // ----------  =====  ----------
+
+    /**
+     * Scratch buffer acquired from the runtime arena, and released on destruction.
+     * The memory is NOT initialised.
+     */
+    template <class T>
+    class Scratch
+    {
+    public:
+
+        Scratch( Arena& arena, index_t n )
+            : m_arena(arena), m_size(n)
+            { m_data = static_cast<T*>( arena.acquire(n*sizeof(T)) ); }
+
+        ~Scratch()
+            { m_arena.release( m_data, m_size*sizeof(T) ); }
+
+        Scratch( const Scratch& ) = delete;
+        Scratch& operator= ( const Scratch& ) = delete;
+
+        inline T* data() const { return m_data; }
+        inline index_t size() const { return m_size; }
+        inline T& operator[] ( index_t k ) const { return m_data[k]; }
+
+    private:
+
+        Arena& m_arena;
+        T *m_data;
+        index_t m_size;
+    };
+
+}
+
+#endif
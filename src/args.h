@@ -7,6 +7,8 @@
 // @contact      Jhadida87 [at] gmail
 //==================================================
 
+#include <cstring>
+#include <exception>
 #include <functional>
 
 // ------------------------------------------------------------------------
@@ -74,10 +76,45 @@ namespace jmx {
         
         // ----------  =====  ----------
         
+        // name of the command in a bundle (see router.h)
+        const char *command;
+
         Arguments( 
             int nargout, mxArray *out[],
             int nargin, const mxArray *in[]
-        ) : in(in,nargin), out(out,nargout) {}
+        ) : in(in,nargin), out(out,nargout), command(""), m_memo(0), m_tag(mexFunctionName())
+        { 
+            session(); 
+            console().claim();
+            alloc_begin_call();
+            ++runtime().counters().calls; 
+        }
+
+        // print pending output before returning control to Matlab
+        ~Arguments()
+        { 
+            if ( m_memo && !_unwinding() ) memo().store( m_memo, _session_id(), out.len, out.ptr );
+            alloc_end_call();
+            console_flush(); 
+        }
+
+        /**
+         * Opt-in memoization (see memo.h): returns true if the outputs for the same inputs
+         * were found in the cache (and copied to the outputs); otherwise the outputs will be
+         * cached when the call returns.
+         */
+        bool memoize( const char *name="" )
+        {
+            uint64_t key = hash_bytes( command, std::strlen(command), reinterpret_cast<uintptr_t>(_session_id()) );
+            key = hash_bytes( name, std::strlen(name), key );
+            key = hash_combine( key, out.len );
+            for ( index_t k = 0; k < in.len; ++k )
+                key = hash_combine( key, hash_array(in[k]) );
+
+            if ( session_memo().lookup( key, out.len, out.ptr ) ) return true;
+            m_memo = key;
+            return false;
+        }
 
         inline void verify( index_t inmin, index_t outmin, std::function<void()> usage ) {
             if ( in.len < inmin || out.len < outmin ) {
@@ -85,6 +122,19 @@ namespace jmx {
                 JMX_THROW( "Bad input; please refer to usage help above." );
             }
         }
+
+    private:
+
+        uint64_t m_memo;
+        AllocTag m_tag;
+
+        static inline bool _unwinding() {
+        #if __cplusplus >= 201703L
+            return std::uncaught_exceptions() > 0;
+        #else
+            return std::uncaught_exception();
+        #endif
+        }
     };
 
 }
@@ -0,0 +1,383 @@
+#ifndef JMX_BITS_H_INCLUDED
+#define JMX_BITS_H_INCLUDED
+
+//==================================================
+// @title        bits.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ------------------------------------------------------------------------
+
+/**
+ * Logical arrays are stored by Matlab with one byte per element. BitVector and BitVolume
+ * pack them into 64-bit words (bit k of the array is bit k%64 of word k/64), which divides
+ * the memory traffic of masking operations by 8.
+ *
+ * Packing and unpacking are vectorised (SSE2 or AVX2), and the bulk operations (logical
+ * operators, counts, masked reductions) run in parallel over chunks of words.
+ * Bits beyond size() in the last word are always zero.
+ */
+namespace jmx {
+
+    using bitword_t = uint64_t;
+
+    // number of words per chunk in parallel operations
+    #ifndef JMX_BITS_GRAIN
+    #define JMX_BITS_GRAIN 4096
+    #endif
+
+    inline index_t bits_nwords( index_t n ) { return (n + 63) / 64; }
+
+    // pack 64 bytes (non-zero = set) into one word
+    inline bitword_t _pack_word( const bool *in )
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t*>(in);
+    #if defined(__AVX2__)
+        const __m256i z = _mm256_setzero_si256();
+        const uint32_t lo = ~static_cast<uint32_t>(_mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_loadu_si256((const __m256i*) p), z ) ));
+        const uint32_t hi = ~static_cast<uint32_t>(_mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_loadu_si256((const __m256i*) (p+32)), z ) ));
+        return static_cast<bitword_t>(lo) | (static_cast<bitword_t>(hi) << 32);
+    #elif defined(__SSE2__)
+        const __m128i z = _mm_setzero_si128();
+        bitword_t w = 0;
+        for ( int k = 0; k < 4; ++k ) {
+            const unsigned m = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_loadu_si128((const __m128i*) (p+16*k)), z ) );
+            w |= static_cast<bitword_t>( ~m & 0xFFFF ) << (16*k);
+        }
+        return w;
+    #else
+        bitword_t w = 0;
+        for ( int k = 0; k < 64; ++k )
+            w |= static_cast<bitword_t>( p[k] != 0 ) << k;
+        return w;
+    #endif
+    }
+
+    // unpack one word into 64 bytes (0 or 1)
+    inline void _unpack_word( bitword_t w, bool *out )
+    {
+    #if defined(__SSE2__)
+        const __m128i sel = _mm_set1_epi64x( 0x8040201008040201LL );
+        const __m128i one = _mm_set1_epi8(1);
+        for ( int k = 0; k < 4; ++k, w >>= 16 ) {
+            const __m128i v = _mm_set_epi64x(
+                static_cast<long long>( ((w >> 8) & 0xFF) * 0x0101010101010101ULL ),
+                static_cast<long long>( (w & 0xFF) * 0x0101010101010101ULL ) );
+            const __m128i b = _mm_and_si128( _mm_cmpeq_epi8( _mm_and_si128(v,sel), sel ), one );
+            _mm_storeu_si128( (__m128i*) (out+16*k), b );
+        }
+    #else
+        for ( int k = 0; k < 64; ++k )
+            out[k] = (w >> k) & 1;
+    #endif
+    }
+
+    // ------------------------------------------------------------------------
+
+    class BitVector
+    {
+    public:
+
+        BitVector()
+            : m_n(0) {}
+        explicit BitVector( index_t n, bool val=false )
+            { assign(n,val); }
+        BitVector( const bool *in, index_t n )
+            { pack(in,n); }
+
+        void assign( index_t n, bool val=false );
+
+        // conversion from/to one byte per element
+        void pack( const bool *in, index_t n );
+        void unpack( bool *out ) const;
+
+        inline index_t size() const { return m_n; }
+        inline index_t nwords() const { return m_word.size(); }
+        inline bool empty() const { return m_n == 0; }
+
+        inline bitword_t* words() { return m_word.data(); }
+        inline const bitword_t* words() const { return m_word.data(); }
+
+        // single bits
+        inline bool get( index_t k ) const { return (m_word[k/64] >> (k%64)) & 1; }
+        inline bool operator[] ( index_t k ) const { return get(k); }
+        inline void set( index_t k ) { m_word[k/64] |= bitword_t(1) << (k%64); }
+        inline void reset( index_t k ) { m_word[k/64] &= ~(bitword_t(1) << (k%64)); }
+
+        // logical operations, in place
+        BitVector& operator&= ( const BitVector& that );
+        BitVector& operator|= ( const BitVector& that );
+        BitVector& operator^= ( const BitVector& that );
+        BitVector& flip();
+
+        // number of set bits
+        index_t count() const;
+
+        // first set bit at or after k, or size() if there is none
+        index_t find_next( index_t k ) const;
+        inline index_t find_first() const { return find_next(0); }
+
+        // call fn(k) for each set bit, in increasing order
+        template <class F>
+        void for_each( F&& fn ) const
+        {
+            const index_t nw = m_word.size();
+            for ( index_t w = 0; w < nw; ++w )
+                for ( bitword_t m = m_word[w]; m; m &= m-1 )
+                    fn( 64*w + __builtin_ctzll(m) );
+        }
+
+    protected:
+
+        template <class F>
+        void _combine( const BitVector& that, F&& op );
+        void _trim();
+
+        index_t m_n;
+        std::vector<bitword_t> m_word;
+    };
+
+    inline BitVector operator& ( BitVector a, const BitVector& b ) { return a &= b; }
+    inline BitVector operator| ( BitVector a, const BitVector& b ) { return a |= b; }
+    inline BitVector operator^ ( BitVector a, const BitVector& b ) { return a ^= b; }
+    inline BitVector operator~ ( BitVector a ) { return a.flip(); }
+
+    // ----------  =====  ----------
+
+    class BitVolume : public BitVector
+    {
+    public:
+
+        index_t nr, nc, ns;
+
+        BitVolume()
+            : nr(0), nc(0), ns(0) {}
+        BitVolume( index_t nrows, index_t ncols, index_t nslices, bool val=false )
+            : BitVector(nrows*ncols*nslices,val), nr(nrows), nc(ncols), ns(nslices) {}
+        BitVolume( const bool *in, index_t nrows, index_t ncols, index_t nslices )
+            : BitVector(in,nrows*ncols*nslices), nr(nrows), nc(ncols), ns(nslices) {}
+
+        inline index_t ndims() const { return 3; }
+        inline index_t nrows() const { return nr; }
+        inline index_t ncols() const { return nc; }
+        inline index_t nslices() const { return ns; }
+
+        inline bool operator() ( index_t r, index_t c, index_t s ) const
+            { return get( r + nr*c + nr*nc*s ); }
+    };
+
+    // ------------------------------------------------------------------------
+
+    template <class F>
+    void BitVector::_combine( const BitVector& that, F&& op )
+    {
+        JMX_ASSERT( m_n == that.m_n, "Size mismatch." );
+        bitword_t *a = m_word.data();
+        const bitword_t *b = that.m_word.data();
+        parallel_chunks( 0, m_word.size(), [&]( index_t wb, index_t we, index_t ) {
+            for ( index_t w = wb; w < we; ++w ) a[w] = op( a[w], b[w] );
+        }, JMX_BITS_GRAIN );
+    }
+
+    inline BitVector& BitVector::operator&= ( const BitVector& that )
+        { _combine( that, []( bitword_t a, bitword_t b ) { return a & b; } ); return *this; }
+    inline BitVector& BitVector::operator|= ( const BitVector& that )
+        { _combine( that, []( bitword_t a, bitword_t b ) { return a | b; } ); return *this; }
+    inline BitVector& BitVector::operator^= ( const BitVector& that )
+        { _combine( that, []( bitword_t a, bitword_t b ) { return a ^ b; } ); return *this; }
+
+    inline BitVector& BitVector::flip()
+    {
+        _combine( *this, []( bitword_t a, bitword_t ) { return ~a; } );
+        _trim();
+        return *this;
+    }
+
+    inline void BitVector::_trim()
+    {
+        if ( m_n % 64 ) m_word.back() &= (bitword_t(1) << (m_n % 64)) - 1;
+    }
+
+    inline void BitVector::assign( index_t n, bool val )
+    {
+        m_n = n;
+        m_word.assign( bits_nwords(n), val ? ~bitword_t(0) : 0 );
+        _trim();
+    }
+
+    inline void BitVector::pack( const bool *in, index_t n )
+    {
+        alloc_transient( bits_nwords(n)*sizeof(bitword_t) );
+        m_n = n;
+        m_word.resize( bits_nwords(n) );
+
+        const index_t nfull = n / 64;
+        bitword_t *w = m_word.data();
+        parallel_chunks( 0, nfull, [&]( index_t wb, index_t we, index_t ) {
+            for ( index_t k = wb; k < we; ++k ) w[k] = _pack_word( in + 64*k );
+        }, JMX_BITS_GRAIN );
+
+        if ( nfull < m_word.size() ) {
+            bitword_t last = 0;
+            for ( index_t k = 64*nfull; k < n; ++k )
+                last |= static_cast<bitword_t>( in[k] ) << (k%64);
+            w[nfull] = last;
+        }
+    }
+
+    inline void BitVector::unpack( bool *out ) const
+    {
+        const index_t nfull = m_n / 64;
+        const bitword_t *w = m_word.data();
+        parallel_chunks( 0, nfull, [&]( index_t wb, index_t we, index_t ) {
+            for ( index_t k = wb; k < we; ++k ) _unpack_word( w[k], out + 64*k );
+        }, JMX_BITS_GRAIN );
+
+        for ( index_t k = 64*nfull; k < m_n; ++k )
+            out[k] = get(k);
+    }
+
+    inline index_t BitVector::count() const
+    {
+        const index_t nw = m_word.size();
+        const index_t grain = JMX_BITS_GRAIN;
+        std::vector<index_t> part( (nw + grain-1) / grain, 0 );
+
+        parallel_chunks( 0, nw, [&]( index_t wb, index_t we, index_t ) {
+            index_t c = 0;
+            for ( index_t w = wb; w < we; ++w ) c += __builtin_popcountll( m_word[w] );
+            part[ wb/grain ] = c;
+        }, grain );
+
+        index_t c = 0;
+        for ( auto p: part ) c += p;
+        return c;
+    }
+
+    inline index_t BitVector::find_next( index_t k ) const
+    {
+        if ( k >= m_n ) return m_n;
+
+        index_t w = k / 64;
+        bitword_t m = m_word[w] & (~bitword_t(0) << (k%64));
+        while ( !m ) {
+            if ( ++w == m_word.size() ) return m_n;
+            m = m_word[w];
+        }
+        return 64*w + __builtin_ctzll(m);
+    }
+
+    // ----------  =====  ----------
+
+    /**
+     * Reduction of the elements of a container (e.g. Vector or Volume) under a mask:
+     *      op( ... op( op(init, x[k1]), x[k2] ) ..., x[kn] )
+     * for the set bits k1 < k2 < ... < kn. The operator should be associative, and init
+     * should be its neutral element; partial results are combined in a fixed order, with
+     * combine(U,U) (or op if the types of U and T are the same).
+     */
+    template <class T, class M, class U, class F, class G>
+    U masked_reduce( const Container<T,M>& x, const BitVector& mask, U init, F&& op, G&& combine )
+    {
+        JMX_ASSERT( x.numel() == mask.size(), "Size mismatch." );
+
+        const index_t nw = mask.nwords();
+        const index_t grain = JMX_BITS_GRAIN;
+        const bitword_t *words = mask.words();
+        std::vector<U> part( (nw + grain-1) / grain, init );
+
+        parallel_chunks( 0, nw, [&]( index_t wb, index_t we, index_t ) {
+            U acc = init;
+            for ( index_t w = wb; w < we; ++w ) {
+                const bitword_t m = words[w];
+                const index_t base = 64*w;
+
+                if ( m == ~bitword_t(0) ) // dense word
+                    for ( index_t k = 0; k < 64; ++k ) acc = op( acc, x[base+k] );
+                else
+                    for ( bitword_t r = m; r; r &= r-1 ) acc = op( acc, x[ base + __builtin_ctzll(r) ] );
+            }
+            part[ wb/grain ] = acc;
+        }, grain );
+
+        U out = init;
+        for ( auto& p: part ) out = combine( out, p );
+        return out;
+    }
+
+    template <class T, class M, class U, class F>
+    U masked_reduce( const Container<T,M>& x, const BitVector& mask, U init, F&& op )
+    {
+        return masked_reduce( x, mask, init, op, op );
+    }
+
+    // sums in 64-bit integers or double precision (see accum_type)
+    template <class T, class M, class U = typename accum_type<T>::type>
+    U masked_sum( const Container<T,M>& x, const BitVector& mask )
+    {
+        return masked_reduce( x, mask, U(0), 
+            []( const U& a, const T& b ) -> U { return a + static_cast<U>(b); },
+            []( const U& a, const U& b ) -> U { return a+b; } );
+    }
+
+    template <class T, class M>
+    double masked_mean( const Container<T,M>& x, const BitVector& mask )
+    {
+        return static_cast<double>(masked_sum( x, mask )) / mask.count();
+    }
+
+    // ------------------------------------------------------------------------
+
+    // pack logical inputs
+    inline BitVector get_bits( const mxArray *ms )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( mxIsLogical(ms) && !mxIsSparse(ms), "Input should be a full logical array." );
+        return BitVector( data_ptr<bool>(ms), mxGetNumberOfElements(ms) );
+    }
+
+    inline BitVolume get_bitvol( const mxArray *ms )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( mxIsLogical(ms) && !mxIsSparse(ms), "Input should be a full logical array." );
+        JMX_ASSERT( mxGetNumberOfDimensions(ms) <= 3, "Not a volume." );
+
+        const index_t *size = mxGetDimensions(ms);
+        const index_t ns = mxGetNumberOfDimensions(ms) == 3 ? size[2] : 1;
+        return BitVolume( data_ptr<bool>(ms), size[0], size[1], ns );
+    }
+
+    // forwarded from extractor.h and creator.h
+    template <class K>
+    inline BitVector Extractor<K>::getbits( key_t k ) { return get_bits(_extractor_get(k)); }
+
+    template <class K>
+    inline BitVolume Extractor<K>::getbitvol( key_t k ) { return get_bitvol(_extractor_get(k)); }
+
+    template <class K>
+    inline mxArray* Creator<K>::mkbits( key_t k, const BitVector& b, bool col ) {
+        ptr_t pk = _creator_assign(k, make_vector( b.size(), col, mxLOGICAL_CLASS ));
+        b.unpack( data_ptr<bool>(pk) );
+        return pk;
+    }
+
+    template <class K>
+    inline mxArray* Creator<K>::mkbits( key_t k, const BitVolume& b ) {
+        ptr_t pk = _creator_assign(k, make_volume( b.nr, b.nc, b.ns, mxLOGICAL_CLASS ));
+        b.unpack( data_ptr<bool>(pk) );
+        return pk;
+    }
+
+}
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef JMX_BUILDER_H_INCLUDED
+#define JMX_BUILDER_H_INCLUDED
+
+//==================================================
+// @title        builder.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "memory.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Outputs whose size is not known in advance.
+ *
+ * VectorBuilder and MatrixBuilder (growing number of columns) grow geometrically. With
+ * MatlabMemory (default), the buffer is allocated with mxRealloc, and handed over to the
+ * output without copy when the builder is released (e.g. args.mkvec(k,builder)).
+ *
+ * Workers cannot allocate Matlab memory; parallel producers should use one builder with
+ * CppMemory per thread, and merge them into the output builder on the Matlab thread:
+ *
+ *      std::vector< VectorBuilder<double,CppMemory<double>> > part( runtime().nthreads() );
+ *      parallel_chunks( 0, n, [&]( index_t b, index_t e, index_t tid ) { ... part[tid].push_back(x); } );
+ *      VectorBuilder<double> out;
+ *      out.merge(part);
+ *      args.mkvec( 0, out );
+ *
+ * Note that parts are concatenated in order of thread, not in the order of the loop.
+ *
+ * CellBuilder and StructBuilder collect mxArray pointers (created on the Matlab thread),
+ * and own them until they are released.
+ */
+namespace jmx {
+
+    template <class T, class M = MatlabMemory<T> >
+    class VectorBuilder
+    {
+    public:
+
+        using value_type = T;
+
+        VectorBuilder()
+            : m_size(0) { m_mem.clear(); }
+        explicit VectorBuilder( index_t capacity )
+            : m_size(0) { m_mem.clear(); reserve(capacity); }
+
+        VectorBuilder( VectorBuilder&& that )
+            : m_mem(that.m_mem), m_size(that.m_size) { that.m_mem.clear(); that.m_size = 0; }
+
+        VectorBuilder( const VectorBuilder& ) = delete;
+        VectorBuilder& operator= ( const VectorBuilder& ) = delete;
+
+        ~VectorBuilder()
+            { if ( m_mem.data ) m_mem.free(); }
+
+        inline index_t size() const { return m_size; }
+        inline index_t capacity() const { return m_mem.size; }
+        inline bool empty() const { return m_size == 0; }
+        inline void clear() { m_size = 0; }
+
+        inline T* data() const { return m_mem.data; }
+        inline T& operator[] ( index_t k ) const { return m_mem.data[k]; }
+
+        inline void reserve( index_t n )
+            { if ( n > capacity() ) m_mem.realloc(n); }
+
+        inline void push_back( const T& val ) {
+            if ( m_size == capacity() ) _grow(m_size+1);
+            m_mem.data[m_size++] = val;
+        }
+
+        // add n elements at the end, and return a pointer to the first one
+        inline T* extend( index_t n ) {
+            if ( m_size+n > capacity() ) _grow(m_size+n);
+            T *p = m_mem.data + m_size;
+            m_size += n;
+            return p;
+        }
+
+        inline void append( const T *ptr, index_t n )
+            { std::copy( ptr, ptr+n, extend(n) ); }
+
+        template <class M2>
+        inline void merge( const VectorBuilder<T,M2>& that )
+            { append( that.data(), that.size() ); }
+
+        template <class M2>
+        void merge( const std::vector< VectorBuilder<T,M2> >& parts )
+        {
+            index_t n = m_size;
+            for ( auto& p: parts ) n += p.size();
+            reserve(n);
+            for ( auto& p: parts ) merge(p);
+        }
+
+        // create an output vector with the contents, and reset the builder (MatlabMemory only)
+        mxArray* release( bool col=false )
+        {
+            static_assert( std::is_same< M, MatlabMemory<T> >::value, "Only Matlab memory can be released to an output." );
+            mxArray *out = make_vector( 0, col, cpp2mex<T>::classid, complexity<T>() );
+            if ( m_size > 0 ) _handover( out, col ? m_size : 1, col ? 1 : m_size );
+            else if ( m_mem.data ) m_mem.free();
+            return out;
+        }
+
+    protected:
+
+        template <class U, class N> friend class MatrixBuilder;
+
+        inline void _grow( index_t n )
+            { reserve( std::max<index_t>( std::max<index_t>(n,16), 2*capacity() ) ); }
+
+        // give the buffer to an empty output (shrinking in place)
+        void _handover( mxArray *out, index_t nr, index_t nc )
+        {
+        #if !MX_HAS_INTERLEAVED_COMPLEX
+            static_assert( !is_complex<T>::value, "Complex builders require the interleaved API." );
+        #endif
+            m_mem.realloc(m_size);
+            mxSetData( out, m_mem.data );
+            mxSetM( out, nr );
+            mxSetN( out, nc );
+            m_mem.handover();
+            m_size = 0;
+        }
+
+        M m_mem;
+        index_t m_size;
+    };
+
+    // ----------  =====  ----------
+
+    template <class T, class M = MatlabMemory<T> >
+    class MatrixBuilder
+    {
+    public:
+
+        using value_type = T;
+
+        MatrixBuilder( index_t nrows )
+            : m_nr(nrows) {}
+
+        MatrixBuilder( MatrixBuilder&& ) = default;
+
+        inline index_t nrows() const { return m_nr; }
+        inline index_t ncols() const { return m_nr ? m_buf.size() / m_nr : 0; }
+        inline void reserve( index_t ncols ) { m_buf.reserve( m_nr*ncols ); }
+        inline void clear() { m_buf.clear(); }
+
+        inline T* data() const { return m_buf.data(); }
+        inline T& operator() ( index_t r, index_t c ) const { return m_buf[ r + m_nr*c ]; }
+
+        // add a column, and return a pointer to it
+        inline T* add_col() { return m_buf.extend(m_nr); }
+        inline void push_col( const T *col ) { m_buf.append(col,m_nr); }
+
+        template <class M2>
+        inline void merge( const MatrixBuilder<T,M2>& that ) {
+            JMX_ASSERT( that.nrows() == m_nr, "Number of rows mismatch." );
+            m_buf.append( that.data(), m_nr*that.ncols() );
+        }
+
+        template <class M2>
+        void merge( const std::vector< MatrixBuilder<T,M2> >& parts )
+        {
+            index_t n = ncols();
+            for ( auto& p: parts ) n += p.ncols();
+            reserve(n);
+            for ( auto& p: parts ) merge(p);
+        }
+
+        mxArray* release()
+        {
+            static_assert( std::is_same< M, MatlabMemory<T> >::value, "Only Matlab memory can be released to an output." );
+            mxArray *out = make_matrix( 0, 0, cpp2mex<T>::classid, complexity<T>() );
+            const index_t nc = ncols();
+            if ( m_buf.size() > 0 ) m_buf._handover( out, m_nr, nc );
+            else mxSetM( out, m_nr );
+            return out;
+        }
+
+    private:
+
+        index_t m_nr;
+        VectorBuilder<T,M> m_buf;
+    };
+
+    // ------------------------------------------------------------------------
+
+    class CellBuilder
+    {
+    public:
+
+        CellBuilder() {}
+        CellBuilder( const CellBuilder& ) = delete;
+        CellBuilder( CellBuilder&& ) = default;
+
+        ~CellBuilder()
+            { for ( auto v: m_val ) if ( v ) mxDestroyArray(v); }
+
+        inline index_t size() const { return m_val.size(); }
+        inline bool empty() const { return m_val.empty(); }
+        inline void reserve( index_t n ) { m_val.reserve(n); }
+
+        // the builder takes ownership of the value
+        inline void push_back( mxArray *val ) { m_val.push_back(val); }
+        inline mxArray* operator[] ( index_t k ) const { return m_val[k]; }
+
+        inline void merge( CellBuilder& that ) {
+            m_val.insert( m_val.end(), that.m_val.begin(), that.m_val.end() );
+            that.m_val.clear();
+        }
+
+        mxArray* release()
+        {
+            mxArray *out = make_cell( m_val.size() );
+            for ( index_t k = 0; k < m_val.size(); ++k )
+                mxSetCell( out, k, m_val[k] );
+            m_val.clear();
+            return out;
+        }
+
+    private:
+        std::vector<mxArray*> m_val;
+    };
+
+    // ----------  =====  ----------
+
+    class StructBuilder
+    {
+    public:
+
+        StructBuilder( inilst<const char*> fields )
+            : m_fields( fields.begin(), fields.end() ) {}
+
+        StructBuilder( const StructBuilder& ) = delete;
+        StructBuilder( StructBuilder&& ) = default;
+
+        ~StructBuilder()
+            { for ( auto v: m_val ) if ( v ) mxDestroyArray(v); }
+
+        inline index_t size() const { return m_fields.empty() ? 0 : m_val.size() / m_fields.size(); }
+        inline index_t nfields() const { return m_fields.size(); }
+        inline void reserve( index_t n ) { m_val.reserve( n*nfields() ); }
+
+        // add an element with empty fields, and return its index
+        inline index_t push() {
+            m_val.resize( m_val.size() + nfields(), nullptr );
+            return size()-1;
+        }
+
+        // set a field of element k (the last one by default); the builder takes ownership of the value
+        void set( index_t k, const char *field, mxArray *val )
+        {
+            mxArray*& v = m_val[ k*nfields() + field_number(field) ];
+            if ( v ) mxDestroyArray(v);
+            v = val;
+        }
+        inline void set( const char *field, mxArray *val )
+            { set( size()-1, field, val ); }
+
+        index_t field_number( const char *field ) const
+        {
+            for ( index_t f = 0; f < m_fields.size(); ++f )
+                if ( m_fields[f] == field ) return f;
+            JMX_THROW( "Unknown field '%s'.", field );
+        }
+
+        inline void merge( StructBuilder& that ) {
+            JMX_ASSERT( that.m_fields == m_fields, "Fields mismatch." );
+            m_val.insert( m_val.end(), that.m_val.begin(), that.m_val.end() );
+            that.m_val.clear();
+        }
+
+        mxArray* release()
+        {
+            const index_t nf = nfields();
+            std::vector<const char*> names(nf);
+            for ( index_t f = 0; f < nf; ++f ) names[f] = m_fields[f].c_str();
+
+            mxArray *out = make_struct( names.data(), nf, 1, size() );
+            for ( index_t k = 0; k < m_val.size(); ++k )
+                if ( m_val[k] ) mxSetFieldByNumber( out, k/nf, k%nf, m_val[k] );
+
+            m_val.clear();
+            return out;
+        }
+
+    private:
+        std::vector<std::string> m_fields;
+        std::vector<mxArray*> m_val;
+    };
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef JMX_CALLBACK_H_INCLUDED
+#define JMX_CALLBACK_H_INCLUDED
+
+//==================================================
+// @title        callback.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------
+
+#ifndef JMX_CALLBACK_BATCH
+#define JMX_CALLBACK_BATCH 1024 // evaluations per call to Matlab
+#endif
+
+/**
+ * Evaluate a Matlab function (function handle or name) from a kernel, in batches.
+ * Each call to mexCallMATLAB costs about 10us, so evaluations are buffered, and the
+ * function is called once per batch with column vectors (one per input):
+ *
+ *      auto f = args.getcallback(1);           // e.g. @(x) exp(-x.^2)
+ *      for ( index_t i = 0; i < n; ++i )
+ *          f.push( x[i], &y[i] );              // y[i] is written at the next flush
+ *      f.flush();
+ *
+ *      double v = f(0.5);                      // immediate (flushes pending evaluations)
+ *      f.map( x, y, n );                       // n evaluations, in batches
+ *
+ * Functions which are not vectorised are called once per evaluation with set_vectorised(false).
+ * The outputs must be double, single or logical, with one value per evaluation. Errors in
+ * Matlab are rethrown as JMX:callback.
+ *
+ * Callbacks use the Mex API, so they must be used from the Matlab thread.
+ */
+namespace jmx {
+
+    class Callback
+    {
+    public:
+
+        Callback( const mxArray *fn, index_t nin=1, index_t batch=JMX_CALLBACK_BATCH );
+
+        inline index_t nin() const { return m_nin; }
+        inline index_t batch() const { return m_batch; }
+        inline index_t pending() const { return m_out.size(); }
+        inline bool vectorised() const { return m_vec; }
+
+        inline void set_batch( index_t n ) { m_batch = std::max<index_t>(n,1); }
+        inline void set_vectorised( bool v ) { m_vec = v; }
+
+        // ----------  =====  ----------
+
+        // queue an evaluation with nin inputs; *out is written at the next flush
+        void push( const double *x, double *out );
+        inline void push( double x, double *out ) { _check_nin(1); push( &x, out ); }
+
+        // evaluate pending requests
+        void flush();
+
+        // immediate evaluation
+        double call( const double *x );
+        inline double operator() ( double x ) { _check_nin(1); return call(&x); }
+
+        // y[k] = f(x[k]) for k < n (nin=1), or y[k] = f(x[k*nin], ..., x[k*nin+nin-1])
+        void map( const double *x, double *y, index_t n );
+
+        // ----------  =====  ----------
+
+        // round trips to Matlab, evaluations, and seconds spent in Matlab
+        inline index_t roundtrips() const { return m_trips; }
+        inline index_t evaluations() const { return m_evals; }
+        inline double seconds() const { return m_time; }
+
+    private:
+
+        using clock_t = std::chrono::steady_clock;
+
+        inline void _check_nin( index_t n ) const
+            { JMX_ASSERT( m_nin == n, "Callback expects %zu inputs.", m_nin ); }
+
+        // call Matlab with inputs of n rows; returns the output
+        mxArray* _call( index_t n, const double *x );
+
+        const mxArray *m_fn;
+        std::string m_name;
+        index_t m_nin, m_batch;
+        bool m_vec;
+
+        std::vector<double> m_in;
+        std::vector<double*> m_out;
+
+        index_t m_trips, m_evals;
+        double m_time;
+    };
+
+    template <class K>
+    inline Callback Extractor<K>::getcallback( key_t k, index_t nin ) { return Callback( _extractor_get(k), nin ); }
+
+    // struct with fields roundtrips, evaluations, seconds, batch and vectorised
+    mxArray* make_callback_info( const Callback& cb );
+
+}
+
+#endif
@@ -13,8 +13,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstdarg>
 
 #include <string>
+#include <complex>
 #include <utility>
 #include <stdexcept>
 #include <type_traits>
@@ -23,12 +25,12 @@
 // ------------------------------------------------------------------------
 
 // Assertions
-static char jhm_msgbuf[JMX_MSGBUF_SIZE];
-
-#define JMX_THROW( msg, args... ) \
-	{ sprintf( jhm_msgbuf, "::JH-MEX-Exception:: " msg "\n", ##args ); throw std::runtime_error(jhm_msgbuf); }
+// The message is formatted into the exception itself, so this is safe to use from any thread.
+#define JMX_THROW_ID( id, msg, args... ) \
+	{ throw jmx::Exception( id, "::JH-MEX-Exception:: " msg "\n", ##args ); }
+#define JMX_THROW( msg, args... ) JMX_THROW_ID( "JMX:error", msg, ##args )
 #define JMX_WARN( msg, args... ) \
-    { mexPrintf( "::JH-MEX-Warning:: " msg "\n", ##args ); }
+    { jmx::console_printf( true, "::JH-MEX-Warning:: " msg, ##args ); }
 
 // exception by default
 #define JMX_REJECT( cdt, msg, args... ) { if (cdt) JMX_THROW(msg,##args) }
@@ -46,6 +48,17 @@ static char jhm_msgbuf[JMX_MSGBUF_SIZE];
 #define JMX_WREJECT_RF( cdt, msg, args... ) JMX_WREJECT_R((cdt),false,msg,##args)
 #define JMX_WASSERT_RF( cdt, msg, args... ) JMX_WASSERT_R((cdt),false,msg,##args)
 
+// compile-time checks of printf-like formats (indices count the implicit this of members)
+#if defined(__GNUC__) || defined(__clang__)
+    #define JMX_PRINTF_FORMAT( fmt, first ) __attribute__(( format( printf, fmt, first ) ))
+#else
+    #define JMX_PRINTF_FORMAT( fmt, first )
+#endif
+
+// unique names for scoped variables
+#define JMX_CONCAT_(a,b) a ## b
+#define JMX_CONCAT(a,b) JMX_CONCAT_(a,b)
+
 // ------------------------------------------------------------------------
 
 // Detect keyboard interruptions with utIsInterruptPending()
@@ -56,6 +69,41 @@ static char jhm_msgbuf[JMX_MSGBUF_SIZE];
     extern bool utIsInterruptPending();
 #endif
 
+#ifndef JMX_ERRID_SIZE
+#define JMX_ERRID_SIZE 63
+#endif
+
+namespace jmx {
+
+    /**
+     * Exception with a Matlab error identifier (e.g. "JMX:error", or "mylib:badInput").
+     * Identifier and message are stored in fixed-size buffers, without dynamic allocation.
+     */
+    class Exception : public std::exception
+    {
+    public:
+
+        Exception( const char *id, const char *fmt, ... ) JMX_PRINTF_FORMAT(3,4)
+        {
+            snprintf( m_id, sizeof(m_id), "%s", id );
+
+            va_list args;
+            va_start( args, fmt );
+            vsnprintf( m_msg, sizeof(m_msg), fmt, args );
+            va_end( args );
+        }
+
+        inline const char* id() const { return m_id; }
+        inline const char* what() const noexcept { return m_msg; }
+
+    private:
+
+        char m_id[JMX_ERRID_SIZE+1];
+        char m_msg[JMX_MSGBUF_SIZE+1];
+    };
+
+}
+
 namespace jmx_types {
 
     // short alias for initializer lists
@@ -67,7 +115,7 @@ namespace jmx_types {
     using integ_t = mwSignedIndex;
     using real_t  = double;
 
-    template <int C>
+    template <int C, bool Complex = false>
     struct mex2cpp
     {
         typedef void type;
@@ -85,11 +133,35 @@ namespace jmx_types {
     template <> struct mex2cpp< mxSINGLE_CLASS> { typedef float type; };
     template <> struct mex2cpp< mxDOUBLE_CLASS> { typedef double type; };
 
+    template <> struct mex2cpp< mxSINGLE_CLASS, true > { typedef std::complex<float> type; };
+    template <> struct mex2cpp< mxDOUBLE_CLASS, true > { typedef std::complex<double> type; };
+
     template <class T>
     struct cpp2mex
     {
         static const mxClassID classid;
     };
+
+    // complex types
+    template <class T> struct is_complex : std::false_type {};
+    template <class T> struct is_complex< std::complex<T> > : std::true_type {};
+
+    template <class T> struct real_type { typedef T type; };
+    template <class T> struct real_type< std::complex<T> > { typedef T type; };
+
+    // type of sums: 64-bit integers, and double precision for reals
+    template <class T> struct accum_type {
+        typedef typename std::conditional< std::is_floating_point<T>::value, double,
+            typename std::conditional< std::is_signed<T>::value, int64_t, uint64_t >::type >::type type;
+    };
+    template <class T> struct accum_type< std::complex<T> > { typedef std::complex<double> type; };
+
+    // element types of sparse matrices supported by Matlab
+    template <class T> struct is_sparse_type : std::integral_constant< bool,
+        std::is_same<T,double>::value || std::is_same<T,std::complex<double>>::value || std::is_same<T,bool>::value > {};
+
+    template <class T>
+    inline mxComplexity complexity() { return is_complex<T>::value ? mxCOMPLEX : mxREAL; }
 }
 
 namespace jmx {
@@ -98,17 +170,42 @@ namespace jmx {
     
     // ----------  =====  ----------
     
-    // Convenient printing functions
-    template <typename ...Args>
-    inline void print( const std::string& fmt, Args&&... args ) {
-        mexPrintf( fmt.c_str(), std::forward<Args>(args)... );
+    // Thread-safe formatted output to the Matlab console (see redirect.h)
+    void console_printf( bool newline, const char *fmt, ... ) JMX_PRINTF_FORMAT(2,3);
+    void console_vprintf( bool newline, const char *fmt, va_list args ) JMX_PRINTF_FORMAT(2,0);
+
+    // Convenient printing functions (formats are checked at compile-time)
+    inline void print( const char *fmt, ... ) JMX_PRINTF_FORMAT(1,2);
+    inline void println( const char *fmt, ... ) JMX_PRINTF_FORMAT(1,2);
+
+    inline void print( const char *fmt, ... ) {
+        va_list args;
+        va_start( args, fmt );
+        console_vprintf( false, fmt, args );
+        va_end( args );
     }
 
-    template <typename ...Args>
-    void println( std::string fmt, Args&&... args )
-    {
-        fmt += "\n"; 
-        mexPrintf( fmt.c_str(), std::forward<Args>(args)... );
+    inline void println( const char *fmt, ... ) {
+        va_list args;
+        va_start( args, fmt );
+        console_vprintf( true, fmt, args );
+        va_end( args );
+    }
+
+    // strings and formats built at runtime (not checked); strings alone are printed as is
+    inline void print( const std::string& msg ) { console_printf( false, "%s", msg.c_str() ); }
+    inline void println( const std::string& msg ) { console_printf( true, "%s", msg.c_str() ); }
+
+    template <class S, typename ...Args>
+    inline typename std::enable_if< std::is_same<S,std::string>::value >::type
+    print( const S& fmt, Args&&... args ) {
+        console_printf( false, fmt.c_str(), std::forward<Args>(args)... );
+    }
+
+    template <class S, typename ...Args>
+    inline typename std::enable_if< std::is_same<S,std::string>::value >::type
+    println( const S& fmt, Args&&... args ) {
+        console_printf( true, fmt.c_str(), std::forward<Args>(args)... );
     }
 
     // more intuitive alias
@@ -128,9 +225,13 @@ namespace jmx {
     struct is_compatible<M, T, decltype(static_cast<T>( std::declval< mex2cpp<M>::type >() ))> 
         : std::true_type {};
 
-    template <class T>
+    template <class U>
     inline bool isCompatible( const mxArray *ms ) {
         
+        // complex types are compatible with complex arrays of the underlying class
+        if ( is_complex<U>::value != mxIsComplex(ms) ) return false;
+        using T = typename real_type<U>::type;
+
         switch (mxGetClassID(ms))
         {
             case mxLOGICAL_CLASS:
@@ -171,6 +272,35 @@ namespace jmx {
         return (mxIsNumeric(ms) || mxIsLogical(ms)) && !mxIsComplex(ms);
     }
 
+    // complex arrays are number-like if T is complex
+    template <class T>
+    inline bool isNumberLike( const mxArray *ms ) {
+        return is_complex<T>::value ? (mxIsNumeric(ms) && mxIsComplex(ms)) : isNumberLike(ms);
+    }
+
+    // size in bytes of one (real) element of a numeric, logical or char class
+    index_t class_size( mxClassID c );
+
+    // ----------  =====  ----------
+
+    /**
+     * Pointer to the data of a numeric array.
+     *
+     * With the interleaved complex API (compiled with -R2018a, see jmx_compile), complex
+     * arrays are wrapped without copy as std::complex<T>. With separate storage, the real
+     * and imaginary parts are not contiguous, and should be copied (see complex.h).
+     */
+    template <class T>
+    inline T* data_ptr( const mxArray *ms ) {
+    #if MX_HAS_INTERLEAVED_COMPLEX
+        return static_cast<T*>(mxGetData(ms));
+    #else
+        JMX_REJECT( is_complex<T>::value, 
+            "Complex data is stored separately; compile with option interleaved, or use copy_complex." );
+        return static_cast<T*>(mxGetData(ms));
+    #endif
+    }
+
 }
 
 #endif
@@ -0,0 +1,151 @@
+#ifndef JMX_COMPLEX_H_INCLUDED
+#define JMX_COMPLEX_H_INCLUDED
+
+//==================================================
+// @title        complex.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <cstring>
+#include <complex>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// ------------------------------------------------------------------------
+
+/**
+ * Complex arrays are stored either:
+ *  - interleaved (re,im,re,im,...), with the R2018a API (option interleaved in jmx_compile);
+ *    getters and creators then wrap std::complex<T> data without copy;
+ *  - separately (re,re,...,im,im,...), with the default API; the data must then be copied
+ *    to/from std::complex<T> buffers with copy_complex.
+ *
+ * The conversions below are vectorised with SSE2 for float and double.
+ */
+namespace jmx {
+
+    template <class T>
+    void interleave( const T *re, const T *im, std::complex<T> *out, index_t n )
+    {
+        for ( index_t k = 0; k < n; ++k )
+            out[k] = std::complex<T>( re[k], im[k] );
+    }
+
+    template <class T>
+    void split( const std::complex<T> *in, T *re, T *im, index_t n )
+    {
+        for ( index_t k = 0; k < n; ++k ) {
+            re[k] = in[k].real();
+            im[k] = in[k].imag();
+        }
+    }
+
+#ifdef __SSE2__
+
+    inline void interleave( const double *re, const double *im, std::complex<double> *out, index_t n )
+    {
+        double *o = reinterpret_cast<double*>(out);
+        index_t k = 0;
+        for ( ; k+2 <= n; k += 2 ) {
+            const __m128d r = _mm_loadu_pd(re+k);
+            const __m128d i = _mm_loadu_pd(im+k);
+            _mm_storeu_pd( o + 2*k,   _mm_unpacklo_pd(r,i) );
+            _mm_storeu_pd( o + 2*k+2, _mm_unpackhi_pd(r,i) );
+        }
+        for ( ; k < n; ++k ) out[k] = std::complex<double>( re[k], im[k] );
+    }
+
+    inline void split( const std::complex<double> *in, double *re, double *im, index_t n )
+    {
+        const double *p = reinterpret_cast<const double*>(in);
+        index_t k = 0;
+        for ( ; k+2 <= n; k += 2 ) {
+            const __m128d a = _mm_loadu_pd( p + 2*k );
+            const __m128d b = _mm_loadu_pd( p + 2*k+2 );
+            _mm_storeu_pd( re+k, _mm_unpacklo_pd(a,b) );
+            _mm_storeu_pd( im+k, _mm_unpackhi_pd(a,b) );
+        }
+        for ( ; k < n; ++k ) { re[k] = in[k].real(); im[k] = in[k].imag(); }
+    }
+
+    inline void interleave( const float *re, const float *im, std::complex<float> *out, index_t n )
+    {
+        float *o = reinterpret_cast<float*>(out);
+        index_t k = 0;
+        for ( ; k+4 <= n; k += 4 ) {
+            const __m128 r = _mm_loadu_ps(re+k);
+            const __m128 i = _mm_loadu_ps(im+k);
+            _mm_storeu_ps( o + 2*k,   _mm_unpacklo_ps(r,i) );
+            _mm_storeu_ps( o + 2*k+4, _mm_unpackhi_ps(r,i) );
+        }
+        for ( ; k < n; ++k ) out[k] = std::complex<float>( re[k], im[k] );
+    }
+
+    inline void split( const std::complex<float> *in, float *re, float *im, index_t n )
+    {
+        const float *p = reinterpret_cast<const float*>(in);
+        index_t k = 0;
+        for ( ; k+4 <= n; k += 4 ) {
+            const __m128 a = _mm_loadu_ps( p + 2*k );
+            const __m128 b = _mm_loadu_ps( p + 2*k+4 );
+            _mm_storeu_ps( re+k, _mm_shuffle_ps( a, b, _MM_SHUFFLE(2,0,2,0) ) );
+            _mm_storeu_ps( im+k, _mm_shuffle_ps( a, b, _MM_SHUFFLE(3,1,3,1) ) );
+        }
+        for ( ; k < n; ++k ) { re[k] = in[k].real(); im[k] = in[k].imag(); }
+    }
+
+#endif
+
+    // ----------  =====  ----------
+
+    // chunk size for parallel conversions
+    #ifndef JMX_COMPLEX_GRAIN
+    #define JMX_COMPLEX_GRAIN 65536
+    #endif
+
+    /**
+     * Copy the data of a complex array into a contiguous std::complex<T> buffer,
+     * and conversely. This works with either API.
+     */
+    template <class T>
+    void copy_complex( const mxArray *ms, std::complex<T> *out )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( isCompatible< std::complex<T> >(ms), "Incompatible types." );
+        const index_t n = mxGetNumberOfElements(ms);
+
+    #if MX_HAS_INTERLEAVED_COMPLEX
+        std::memcpy( out, mxGetData(ms), n*sizeof(std::complex<T>) );
+    #else
+        const T *re = static_cast<const T*>(mxGetData(ms));
+        const T *im = static_cast<const T*>(mxGetImagData(ms));
+        parallel_chunks( 0, n, [&]( index_t b, index_t e, index_t ) {
+            interleave( re+b, im+b, out+b, e-b );
+        }, JMX_COMPLEX_GRAIN );
+    #endif
+    }
+
+    template <class T>
+    void copy_complex( const std::complex<T> *in, mxArray *ms )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( isCompatible< std::complex<T> >(ms), "Incompatible types." );
+        const index_t n = mxGetNumberOfElements(ms);
+
+    #if MX_HAS_INTERLEAVED_COMPLEX
+        std::memcpy( mxGetData(ms), in, n*sizeof(std::complex<T>) );
+    #else
+        T *re = static_cast<T*>(mxGetData(ms));
+        T *im = static_cast<T*>(mxGetImagData(ms));
+        parallel_chunks( 0, n, [&]( index_t b, index_t e, index_t ) {
+            split( in+b, re+b, im+b, e-b );
+        }, JMX_COMPLEX_GRAIN );
+    #endif
+    }
+
+}
+
+#endif
@@ -8,6 +8,7 @@
 //==================================================
 
 #include <string>
+#include <vector>
 
 // ------------------------------------------------------------------------
 
@@ -27,6 +28,9 @@ namespace jmx {
         Struct mkstruct( key_t k, inilst<const char*> fields ); 
         Cell mkcell( key_t k, index_t len );
 
+        // aggregated timings, with fields name, count, total, max and bytes (see profile.h)
+        Struct mkprofile( key_t k );
+
         // ----------  =====  ----------
 
         // void setters
@@ -44,25 +48,67 @@ namespace jmx {
         // setters with access
         template <class T = real_t>
         inline Vector_mx<T> mkvec( key_t k, index_t len, bool col=false ) { 
-            ptr_t pk = _creator_assign(k, make_vector( len, col, cpp2mex<T>::classid )); 
-            return Vector_mx<T>( static_cast<T*>(mxGetData(pk)), len );
+            ptr_t pk = _creator_assign(k, make_vector( len, col, cpp2mex<T>::classid, complexity<T>() )); 
+            return Vector_mx<T>( data_ptr<T>(pk), len );
         }
 
         template <class T = real_t>
         inline Matrix_mx<T> mkmat( key_t k, index_t nr, index_t nc ) {
-            ptr_t pk = _creator_assign(k, make_matrix( nr, nc, cpp2mex<T>::classid )); 
-            return Matrix_mx<T>( static_cast<T*>(mxGetData(pk)), nr, nc );
+            ptr_t pk = _creator_assign(k, make_matrix( nr, nc, cpp2mex<T>::classid, complexity<T>() )); 
+            return Matrix_mx<T>( data_ptr<T>(pk), nr, nc );
         }
 
         template <class T = real_t>
         inline Volume_mx<T> mkvol( key_t k, index_t nr, index_t nc, index_t ns ) {
-            ptr_t pk = _creator_assign(k, make_volume( nr, nc, cpp2mex<T>::classid )); 
-            return Volume_mx<T>( static_cast<T*>(mxGetData(pk)), nr, nc, ns );
+            ptr_t pk = _creator_assign(k, make_volume( nr, nc, ns, cpp2mex<T>::classid, complexity<T>() )); 
+            return Volume_mx<T>( data_ptr<T>(pk), nr, nc, ns );
+        }
+
+        template <class T = real_t>
+        inline SparseMatrix_mx<T> mksparse( key_t k, index_t nr, index_t nc, index_t nzmax ) {
+            static_assert( is_sparse_type<T>::value, "Sparse matrices should be double, complex double or bool." );
+            ptr_t pk = _creator_assign(k, make_sparse( nr, nc, nzmax, cpp2mex<T>::classid, complexity<T>() ));
+            return SparseMatrix_mx<T>( data_ptr<T>(pk), mxGetIr(pk), mxGetJc(pk), nr, nc, mxGetNzmax(pk) );
         }
 
+        // assemble triplets (see triplets.h)
+        template <class T>
+        mxArray* mksparse( key_t k, SparseBuilder<T>& b );
+
+        // unpack bit masks into logical arrays (see bits.h)
+        mxArray* mkbits( key_t k, const BitVector& b, bool col=false );
+        mxArray* mkbits( key_t k, const BitVolume& b );
+
+        // cell of vectors from packed data, element i is in [offsets[i], offsets[i+1]) (see ragged.h)
+        template <class T>
+        mxArray* mkragged( key_t k, const T *data, const std::vector<index_t>& offsets, bool col=false );
+
+        // cellstr from a vector of std::string or string_view (see strings.h)
+        template <class S>
+        mxArray* mkcellstr( key_t k, const std::vector<S>& strs );
+
+        // handle to a persistent object, as a uint64 scalar (see handles.h)
+        mxArray* mkhandle( key_t k, uint64_t h );
+
         inline ptr_t mkstructarr( key_t k, inilst<const char*> fields, index_t nr, index_t nc ) {
             return _creator_assign(k, make_struct( fields, nr, nc ));
         }
+
+
+        // release growable builders, without copy for numeric data (see builder.h)
+        template <class T>
+        inline ptr_t mkvec( key_t k, VectorBuilder<T>& b, bool col=false )
+            { return _creator_assign(k, b.release(col)); }
+
+        template <class T>
+        inline ptr_t mkmat( key_t k, MatrixBuilder<T>& b )
+            { return _creator_assign(k, b.release()); }
+
+        inline ptr_t mkcell( key_t k, CellBuilder& b )
+            { return _creator_assign(k, b.release()); }
+
+        inline ptr_t mkstructarr( key_t k, StructBuilder& b )
+            { return _creator_assign(k, b.release()); }
     };
 
 }
@@ -0,0 +1,107 @@
+#ifndef JMX_ERROR_H_INCLUDED
+#define JMX_ERROR_H_INCLUDED
+
+//==================================================
+// @title        error.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <atomic>
+#include <exception>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Matlab errors can only be raised from the Matlab thread, and exceptions thrown from
+ * other threads terminate the process if they are not caught.
+ *
+ * An ErrorChannel collects the first error raised by a group of threads (e.g. the workers
+ * of a parallel loop). The identifier and message are copied into storage owned by the
+ * failing thread, so nothing is allocated unless an error occurs. Other threads should
+ * poll cancelled() and stop early. The error is then rethrown on the Matlab thread.
+ *
+ * Gateways should catch exceptions, copy them into an ErrorRecord, and call raise() after
+ * the try/catch to convert them into Matlab errors.
+ */
+namespace jmx {
+
+    struct ErrorRecord
+    {
+        char id[JMX_ERRID_SIZE+1];
+        char msg[JMX_MSGBUF_SIZE+1];
+
+        void set( const char *id, const char *msg );
+
+        // copy the exception currently handled
+        void capture();
+
+        // nothing captured (zero-initialised)
+        inline bool empty() const { return id[0] == '\0'; }
+    };
+
+    // storage of the calling thread
+    ErrorRecord& thread_error();
+
+    // ----------  =====  ----------
+
+    class ErrorChannel
+    {
+    public:
+
+        ErrorChannel()
+            : m_failed(false), m_error(nullptr) {}
+
+        // to be called from a catch block; only the first error is kept
+        void capture();
+
+        inline bool cancelled() const
+            { return m_failed.load( std::memory_order_relaxed ); }
+
+        // the first error captured, or null
+        inline const ErrorRecord* error() const
+            { return m_error.load( std::memory_order_acquire ); }
+
+        // throw the first error captured as an Exception, if any
+        void rethrow() const;
+
+    private:
+
+        std::atomic<bool> m_failed;
+        std::atomic<const ErrorRecord*> m_error;
+    };
+
+    // ----------  =====  ----------
+
+    /**
+     * Raise a Matlab error (mexErrMsgIdAndTxt) from a record, on the Matlab thread.
+     * mexErrMsgIdAndTxt does not return, so it must not be called inside a catch block
+     * (the exception would never be destroyed); copy the message first:
+     *
+     *      jmx::ErrorRecord err = {};
+     *      try { ... }
+     *      catch (...) { err.capture(); }
+     *      if ( !err.empty() ) jmx::raise(err);
+     */
+    void raise( const ErrorRecord& r );
+
+    // channel of the parallel loop running on the calling thread (see parallel.h)
+    const ErrorChannel*& _thread_channel();
+
+    // cancellation flag of the progress token of the calling thread (see progress.h)
+    const std::atomic<bool>*& _thread_cancel();
+
+    /**
+     * Cancellation of the parallel loop running on the calling thread.
+     * Long tasks can poll this to stop early when a sibling failed, or when the user
+     * interrupted the loop (with a Progress token).
+     */
+    inline bool cancellation_requested() {
+        const ErrorChannel *c = _thread_channel();
+        const std::atomic<bool> *f = _thread_cancel();
+        return (c && c->cancelled()) || (f && f->load( std::memory_order_relaxed ));
+    }
+
+}
+
+#endif
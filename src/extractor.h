@@ -8,6 +8,7 @@
 //==================================================
 
 #include <string>
+#include <memory>
 
 // ------------------------------------------------------------------------
 
@@ -47,6 +48,28 @@ namespace jmx {
         template <class T = real_t>
         inline Volume_ro<T> getvol( key_t k )  { return get_volume<T>(_extractor_get(k)); }
 
+        template <class T = real_t>
+        inline SparseMatrix_ro<T> getsparse( key_t k )  { return get_sparse<T>(_extractor_get(k)); }
+
+        // packed logical arrays (see bits.h)
+        BitVector getbits( key_t k );
+        BitVolume getbitvol( key_t k );
+
+        // cells of numeric arrays (see ragged.h)
+        template <class T = real_t>
+        RaggedArray_ro<T> getragged( key_t k );
+
+        // cellstr transcoded to UTF-8 (see strings.h)
+        CellStr getcellstr( key_t k );
+
+        // Matlab functions evaluated in batches (see callback.h)
+        Callback getcallback( key_t k, index_t nin=1 );
+
+        // persistent objects (see handles.h)
+        uint64_t gethandle( key_t k );
+        template <class T>
+        std::shared_ptr<T> getobject( key_t k );
+
 
         // getters with defaults
         template <class T = real_t>
@@ -90,6 +90,32 @@ namespace jmx {
         return Cell( _creator_assign(k, make_cell( len )) );
     }
 
+    // ----------  =====  ----------
+
+    template <class K>
+    Struct Creator<K>::mkprofile( key_t k )
+    {
+        const std::vector<ProfileEntry> r = profile_report();
+        const index_t n = r.size();
+
+        Struct s = mkstruct( k, {"name", "count", "total", "max", "bytes"} );
+        mxArray *name = make_cell( n );
+        s.set_value( "name", name );
+        auto count = s.mkvec<double>( "count", n, true );
+        auto total = s.mkvec<double>( "total", n, true );
+        auto max = s.mkvec<double>( "max", n, true );
+        auto bytes = s.mkvec<double>( "bytes", n, true );
+
+        for ( index_t i = 0; i < n; ++i ) {
+            set_cell( name, i, make_string(r[i].name) );
+            count[i] = r[i].count;
+            total[i] = r[i].total;
+            max[i] = r[i].max;
+            bytes[i] = r[i].bytes;
+        }
+        return s;
+    }
+
 }
 
 #endif
\ No newline at end of file
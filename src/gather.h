@@ -0,0 +1,306 @@
+#ifndef JMX_GATHER_H_INCLUDED
+#define JMX_GATHER_H_INCLUDED
+
+//==================================================
+// @title        gather.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <vector>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// ------------------------------------------------------------------------
+
+/**
+ * Gather and scatter between arrays (e.g. Volume or Matrix) and compact vectors, as with
+ * Matlab's vol(mask) and vol(mask) = x. Elements are selected either by a packed mask
+ * (see bits.h), or by an IndexList of 0-based linear indices, which can be computed once
+ * and reused across calls.
+ *
+ * The kernels run in parallel over chunks; gathers of float and double use AVX2 when
+ * available, and dense words of a mask are copied as contiguous blocks.
+ *
+ * The batched sub2ind/ind2sub conversions use 1-based subscripts and indices, as in Matlab.
+ */
+namespace jmx {
+
+    class IndexList
+    {
+    public:
+
+        IndexList() : m_extent(0) {}
+        explicit IndexList( const BitVector& mask )
+            { assign(mask); }
+
+        // set bits of a mask
+        void assign( const BitVector& mask );
+
+        // 1-based indices (double), or logical mask, with bounds checked against numel
+        void assign( const mxArray *ms, index_t numel );
+
+        inline index_t size() const { return m_idx.size(); }
+        inline bool empty() const { return m_idx.empty(); }
+        inline void clear() { m_idx.clear(); m_extent = 0; }
+
+        // number of elements of the arrays indexed (checked by gather and scatter)
+        inline index_t extent() const { return m_extent; }
+
+        inline const index_t* data() const { return m_idx.data(); }
+        inline index_t operator[] ( index_t k ) const { return m_idx[k]; }
+        inline const std::vector<index_t>& indices() const { return m_idx; }
+
+    private:
+        std::vector<index_t> m_idx;
+        index_t m_extent;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // chunk size for parallel gathers and scatters
+    #ifndef JMX_GATHER_GRAIN
+    #define JMX_GATHER_GRAIN 32768
+    #endif
+
+    // 1-based subscript or index to 0-based, with bounds check
+    template <class T>
+    inline index_t _subscript( const T& v, index_t n ) {
+        const double d = static_cast<double>(v);
+        JMX_ASSERT( d >= 1 && d <= n && d == static_cast<index_t>(d), "Subscript %g out of range [1,%zu].", d, n );
+        return static_cast<index_t>(d) - 1;
+    }
+
+    template <class T>
+    inline void _gather( const T *src, const index_t *idx, T *out, index_t n )
+    {
+        for ( index_t k = 0; k < n; ++k ) out[k] = src[idx[k]];
+    }
+
+    template <class T>
+    inline void _scatter( const T *in, const index_t *idx, T *dst, index_t n )
+    {
+        for ( index_t k = 0; k < n; ++k ) dst[idx[k]] = in[k];
+    }
+
+#if defined(__AVX2__) && defined(JMX_64BIT)
+
+    inline void _gather( const double *src, const index_t *idx, double *out, index_t n )
+    {
+        index_t k = 0;
+        for ( ; k+4 <= n; k += 4 ) {
+            const __m256i i = _mm256_loadu_si256( (const __m256i*) (idx+k) );
+            _mm256_storeu_pd( out+k, _mm256_i64gather_pd( src, i, 8 ) );
+        }
+        for ( ; k < n; ++k ) out[k] = src[idx[k]];
+    }
+
+    inline void _gather( const float *src, const index_t *idx, float *out, index_t n )
+    {
+        index_t k = 0;
+        for ( ; k+4 <= n; k += 4 ) {
+            const __m256i i = _mm256_loadu_si256( (const __m256i*) (idx+k) );
+            _mm_storeu_ps( out+k, _mm256_i64gather_ps( src, i, 4 ) );
+        }
+        for ( ; k < n; ++k ) out[k] = src[idx[k]];
+    }
+
+#endif
+
+    // ----------  =====  ----------
+
+    // out[k] = src[idx[k]]
+    template <class T, class MS, class MO>
+    void gather( const Container<T,MS>& src, const IndexList& idx, const Vector<T,MO>& out )
+    {
+        JMX_ASSERT( src.numel() == idx.extent(), "Index list built for %zu elements, not %zu.", idx.extent(), src.numel() );
+        JMX_ASSERT( out.n == idx.size(), "Size mismatch." );
+        const T *s = src.memptr();
+        T *o = out.memptr();
+
+        parallel_chunks( 0, idx.size(), [&]( index_t b, index_t e, index_t ) {
+            _gather( s, idx.data()+b, o+b, e-b );
+        }, JMX_GATHER_GRAIN );
+    }
+
+    // dst[idx[k]] = in[k], indices should be unique
+    template <class T, class MI, class MD>
+    void scatter( const Vector<T,MI>& in, const IndexList& idx, const Container<T,MD>& dst )
+    {
+        JMX_ASSERT( dst.numel() == idx.extent(), "Index list built for %zu elements, not %zu.", idx.extent(), dst.numel() );
+        JMX_ASSERT( in.n == idx.size(), "Size mismatch." );
+        const T *i = in.memptr();
+        T *d = dst.memptr();
+
+        parallel_chunks( 0, idx.size(), [&]( index_t b, index_t e, index_t ) {
+            _scatter( i+b, idx.data()+b, d, e-b );
+        }, JMX_GATHER_GRAIN );
+    }
+
+    // ----------  =====  ----------
+
+    /**
+     * Visit the set bits of a mask in parallel, with the rank of the first set bit in each
+     * chunk of words. fn is called as fn( word, bits, rank ) for each non-zero word.
+     */
+    template <class F>
+    void _for_each_word( const BitVector& mask, F&& fn )
+    {
+        const index_t nw = mask.nwords();
+        const index_t grain = JMX_BITS_GRAIN / 8;
+        const bitword_t *words = mask.words();
+
+        // number of set bits before each chunk
+        std::vector<index_t> rank( (nw + grain-1) / grain + 1, 0 );
+        parallel_chunks( 0, nw, [&]( index_t wb, index_t we, index_t ) {
+            index_t c = 0;
+            for ( index_t w = wb; w < we; ++w ) c += __builtin_popcountll( words[w] );
+            rank[ wb/grain + 1 ] = c;
+        }, grain );
+        for ( index_t k = 1; k < rank.size(); ++k ) rank[k] += rank[k-1];
+
+        parallel_chunks( 0, nw, [&]( index_t wb, index_t we, index_t ) {
+            index_t r = rank[ wb/grain ];
+            for ( index_t w = wb; w < we; ++w ) if ( words[w] ) {
+                fn( w, words[w], r );
+                r += __builtin_popcountll( words[w] );
+            }
+        }, grain );
+    }
+
+    // out = src(mask)
+    template <class T, class MS, class MO>
+    void gather( const Container<T,MS>& src, const BitVector& mask, const Vector<T,MO>& out )
+    {
+        JMX_ASSERT( src.numel() == mask.size(), "Size mismatch." );
+        JMX_ASSERT( out.n == mask.count(), "Size mismatch." );
+        const T *s = src.memptr();
+        T *o = out.memptr();
+
+        _for_each_word( mask, [&]( index_t w, bitword_t m, index_t r ) {
+            if ( m == ~bitword_t(0) )
+                std::copy( s + 64*w, s + 64*w + 64, o+r );
+            else
+                for ( ; m; m &= m-1 ) o[r++] = s[ 64*w + __builtin_ctzll(m) ];
+        });
+    }
+
+    // dst(mask) = in
+    template <class T, class MI, class MD>
+    void scatter( const Vector<T,MI>& in, const BitVector& mask, const Container<T,MD>& dst )
+    {
+        JMX_ASSERT( dst.numel() == mask.size(), "Size mismatch." );
+        JMX_ASSERT( in.n == mask.count(), "Size mismatch." );
+        const T *i = in.memptr();
+        T *d = dst.memptr();
+
+        _for_each_word( mask, [&]( index_t w, bitword_t m, index_t r ) {
+            if ( m == ~bitword_t(0) )
+                std::copy( i+r, i+r+64, d + 64*w );
+            else
+                for ( ; m; m &= m-1 ) d[ 64*w + __builtin_ctzll(m) ] = i[r++];
+        });
+    }
+
+    // ------------------------------------------------------------------------
+
+    inline void IndexList::assign( const BitVector& mask )
+    {
+        m_extent = mask.size();
+        m_idx.resize( mask.count() );
+        index_t *out = m_idx.data();
+
+        _for_each_word( mask, [out]( index_t w, bitword_t m, index_t r ) {
+            for ( ; m; m &= m-1 ) out[r++] = 64*w + __builtin_ctzll(m);
+        });
+    }
+
+    inline void IndexList::assign( const mxArray *ms, index_t numel )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        if ( mxIsLogical(ms) ) {
+            JMX_ASSERT( mxGetNumberOfElements(ms) == numel, "Mask size mismatch." );
+            assign( get_bits(ms) );
+            return;
+        }
+
+        JMX_ASSERT( isCompatible<double>(ms) && !mxIsSparse(ms), "Indices should be double or logical." );
+        const index_t n = mxGetNumberOfElements(ms);
+        const double *in = data_ptr<double>(ms);
+
+        m_idx.resize(n);
+        index_t *out = m_idx.data();
+        try {
+            parallel_chunks( 0, n, [&]( index_t b, index_t e, index_t ) {
+                for ( index_t k = b; k < e; ++k ) out[k] = _subscript( in[k], numel );
+            }, JMX_GATHER_GRAIN );
+        }
+        catch (...) { clear(); throw; }
+        m_extent = numel;
+    }
+
+    // ------------------------------------------------------------------------
+
+    // ind = sub2ind( [nr,nc], r, c )
+    template <class T, class M1, class M2, class M3>
+    void sub2ind( index_t nr, index_t nc, const Vector<T,M1>& r, const Vector<T,M2>& c, const Vector<T,M3>& ind )
+    {
+        JMX_ASSERT( r.n == c.n && r.n == ind.n, "Size mismatch." );
+        parallel_chunks( 0, r.n, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t k = b; k < e; ++k ) {
+                ind[k] = static_cast<T>( _subscript(r[k],nr) + nr*_subscript(c[k],nc) + 1 );
+            }
+        }, JMX_GATHER_GRAIN );
+    }
+
+    // ind = sub2ind( [nr,nc,ns], r, c, s )
+    template <class T, class M1, class M2, class M3, class M4>
+    void sub2ind( index_t nr, index_t nc, index_t ns,
+        const Vector<T,M1>& r, const Vector<T,M2>& c, const Vector<T,M3>& s, const Vector<T,M4>& ind )
+    {
+        JMX_ASSERT( r.n == c.n && r.n == s.n && r.n == ind.n, "Size mismatch." );
+        parallel_chunks( 0, r.n, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t k = b; k < e; ++k ) {
+                ind[k] = static_cast<T>( _subscript(r[k],nr) + nr*_subscript(c[k],nc) + nr*nc*_subscript(s[k],ns) + 1 );
+            }
+        }, JMX_GATHER_GRAIN );
+    }
+
+    // [r,c] = ind2sub( [nr,nc], ind )
+    template <class T, class M1, class M2, class M3>
+    void ind2sub( index_t nr, index_t nc, const Vector<T,M1>& ind, const Vector<T,M2>& r, const Vector<T,M3>& c )
+    {
+        JMX_ASSERT( r.n == ind.n && c.n == ind.n, "Size mismatch." );
+        parallel_chunks( 0, ind.n, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t k = b; k < e; ++k ) {
+                const index_t i = _subscript( ind[k], nr*nc );
+                r[k] = static_cast<T>( i % nr + 1 );
+                c[k] = static_cast<T>( i / nr + 1 );
+            }
+        }, JMX_GATHER_GRAIN );
+    }
+
+    // [r,c,s] = ind2sub( [nr,nc,ns], ind )
+    template <class T, class M1, class M2, class M3, class M4>
+    void ind2sub( index_t nr, index_t nc, index_t ns,
+        const Vector<T,M1>& ind, const Vector<T,M2>& r, const Vector<T,M3>& c, const Vector<T,M4>& s )
+    {
+        JMX_ASSERT( r.n == ind.n && c.n == ind.n && s.n == ind.n, "Size mismatch." );
+        const index_t np = nr*nc;
+        parallel_chunks( 0, ind.n, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t k = b; k < e; ++k ) {
+                const index_t i = _subscript( ind[k], np*ns );
+                const index_t p = i % np;
+                r[k] = static_cast<T>( p % nr + 1 );
+                c[k] = static_cast<T>( p / nr + 1 );
+                s[k] = static_cast<T>( i / np + 1 );
+            }
+        }, JMX_GATHER_GRAIN );
+    }
+
+}
+
+#endif
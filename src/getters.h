@@ -30,9 +30,12 @@ namespace jmx {
     template <class T, class M = ReadOnlyMemory<T> >
     Vector<T,M> get_vector( const mxArray *ms )
     {
+        JMX_PROFILE_SCOPE( "get_vector" );
         JMX_ASSERT( ms, "Null pointer." );
-        JMX_ASSERT( isNumberLike(ms), "Bad input type." );
+        JMX_ASSERT( isNumberLike<T>(ms), "Bad input type." );
         JMX_ASSERT( isCompatible<T>(ms), "Incompatible types." );
+        JMX_PROFILE_BYTES( mxGetNumberOfElements(ms)*sizeof(T) );
+        JMX_ASSERT( !mxIsSparse(ms), "Sparse input, use get_sparse instead." );
         JMX_ASSERT( mxGetNumberOfDimensions(ms)==2, "Not a vector." );
 
         index_t nr = mxGetM(ms);
@@ -40,39 +43,56 @@ namespace jmx {
 
         if ( nr*nc == 0 ) {
             // empty vector
-            return Vector<T,M>( static_cast<T*>(mxGetData(ms)), 0 );
+            return Vector<T,M>( data_ptr<T>(ms), 0 );
         }
         else if ( nr < nc )
         {
             JMX_ASSERT( (nr==1) && (nc>1), "Not a vector." );
-            return Vector<T,M>( static_cast<T*>(mxGetData(ms)), nc );
+            return Vector<T,M>( data_ptr<T>(ms), nc );
         }
         else
         {
             JMX_ASSERT( (nc==1) && (nr>1), "Not a vector." );
-            return Vector<T,M>( static_cast<T*>(mxGetData(ms)), nr );
+            return Vector<T,M>( data_ptr<T>(ms), nr );
         }
     }
 
     template <class T, class M = ReadOnlyMemory<T> >
     Matrix<T,M> get_matrix( const mxArray *ms )
     {
+        JMX_PROFILE_SCOPE( "get_matrix" );
         JMX_ASSERT( ms, "Null pointer." );
-        JMX_ASSERT( isNumberLike(ms), "Bad input type." );
+        JMX_ASSERT( isNumberLike<T>(ms), "Bad input type." );
         JMX_ASSERT( isCompatible<T>(ms), "Incompatible types." );
+        JMX_PROFILE_BYTES( mxGetNumberOfElements(ms)*sizeof(T) );
+        JMX_ASSERT( !mxIsSparse(ms), "Sparse input, use get_sparse instead." );
         JMX_ASSERT( mxGetNumberOfDimensions(ms)==2, "Not a matrix." );
-        return Matrix<T,M>( static_cast<T*>(mxGetData(ms)), mxGetM(ms), mxGetN(ms) );
+        return Matrix<T,M>( data_ptr<T>(ms), mxGetM(ms), mxGetN(ms) );
     }
 
     template <class T, class M = ReadOnlyMemory<T> >
     Volume<T,M> get_volume( const mxArray *ms )
     {
+        JMX_PROFILE_SCOPE( "get_volume" );
         JMX_ASSERT( ms, "Null pointer." );
-        JMX_ASSERT( isNumberLike(ms), "Bad input type." );
+        JMX_ASSERT( isNumberLike<T>(ms), "Bad input type." );
         JMX_ASSERT( isCompatible<T>(ms), "Incompatible types." );
+        JMX_PROFILE_BYTES( mxGetNumberOfElements(ms)*sizeof(T) );
         JMX_ASSERT( mxGetNumberOfDimensions(ms)==3, "Not a volume." );
         const index_t *size = mxGetDimensions(ms);
-        return Volume<T,M>( static_cast<T*>(mxGetData(ms)), size[0], size[1], size[2] );
+        return Volume<T,M>( data_ptr<T>(ms), size[0], size[1], size[2] );
+    }
+
+    template <class T, class M = ReadOnlyMemory<T> >
+    SparseMatrix<T,M> get_sparse( const mxArray *ms )
+    {
+        JMX_PROFILE_SCOPE( "get_sparse" );
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( mxIsSparse(ms), "Input is not sparse." );
+        JMX_ASSERT( isCompatible<T>(ms), "Incompatible types." );
+        JMX_PROFILE_BYTES( mxGetNzmax(ms)*sizeof(T) );
+        return SparseMatrix<T,M>( data_ptr<T>(ms), mxGetIr(ms), mxGetJc(ms), 
+            mxGetM(ms), mxGetN(ms), mxGetNzmax(ms) );
     }
     
     // ----------  =====  ----------
@@ -86,6 +106,9 @@ namespace jmx {
     template <class T, class M = MatlabMemory<T> >
     Volume<T,M> get_volume_rw( const mxArray *ms ) { return get_volume<T,M>(ms); }
 
+    template <class T, class M = MatlabMemory<T> >
+    SparseMatrix<T,M> get_sparse_rw( const mxArray *ms ) { return get_sparse<T,M>(ms); }
+
     // ----------  =====  ----------
 
     // forward declarations (see forward.h)
@@ -0,0 +1,114 @@
+#ifndef JMX_HANDLES_H_INCLUDED
+#define JMX_HANDLES_H_INCLUDED
+
+//==================================================
+// @title        handles.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <memory>
+#include <string>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Handles to persistent objects (see registry.h), e.g.:
+ *
+ *      JMX_COMMAND(build) {
+ *          auto tree = std::make_shared<KDTree>( args.getmat(0) );
+ *          args.mkhandle( 0, create_handle( tree, tree->bytes(), "kdtree" ) );
+ *      }
+ *      JMX_COMMAND(query) {
+ *          auto tree = args.getobject<KDTree>(0);
+ *          ...
+ *      }
+ *      JMX_COMMAND(free) {
+ *          destroy_handle( args.gethandle(0) );
+ *      }
+ *
+ * The code of an object (e.g. its destructor) belongs to the Mex file which created it.
+ * This Mex file is therefore locked (mexLock) while it owns objects, and its objects are
+ * destroyed if it is cleared anyway (e.g. when Matlab exits).
+ */
+namespace jmx {
+
+    JMX_LOCAL inline bool& _session_locked() {
+        static bool locked = false;
+        return locked;
+    }
+
+    // lock the Mex file while it owns objects
+    JMX_LOCAL inline void _session_update_lock()
+    {
+        bool& locked = _session_locked();
+        const bool owns = runtime().registry().size( _session_id() ) > 0;
+        if ( owns && !locked ) { mexLock(); locked = true; }
+        if ( !owns && locked ) { mexUnlock(); locked = false; }
+    }
+
+    template <class T>
+    JMX_LOCAL inline handle_t create_handle( std::shared_ptr<T> obj, index_t bytes=sizeof(T), const std::string& label="" )
+    {
+        const handle_t h = session().registry().create( obj, _session_id(), bytes, label );
+        _session_update_lock();
+        return h;
+    }
+
+    JMX_LOCAL inline bool destroy_handle( handle_t h )
+    {
+        const bool ok = session().registry().destroy(h);
+        _session_update_lock();
+        return ok;
+    }
+
+    template <class T>
+    inline std::shared_ptr<T> get_object( handle_t h ) {
+        return runtime().registry().get<T>(h);
+    }
+
+    // ----------  =====  ----------
+
+    inline handle_t get_handle( const mxArray *ms )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( mxGetClassID(ms) == mxUINT64_CLASS && mxGetNumberOfElements(ms) == 1,
+            "Handles should be uint64 scalars." );
+        return *static_cast<const uint64_t*>(mxGetData(ms));
+    }
+
+    inline mxArray* make_handle( handle_t h )
+    {
+        mxArray *ms = make_matrix( 1, 1, mxUINT64_CLASS );
+        *static_cast<uint64_t*>(mxGetData(ms)) = h;
+        return ms;
+    }
+
+    // struct-array with fields handle, type, label and bytes, for each object
+    inline mxArray* make_registry_info()
+    {
+        StructBuilder sb({ "handle", "type", "label", "bytes" });
+        for ( auto& i: runtime().registry().info() ) {
+            sb.push();
+            sb.set( "handle", make_handle(i.handle) );
+            sb.set( "type", make_string(i.type) );
+            sb.set( "label", make_string(i.label) );
+            sb.set( "bytes", make_scalar(i.bytes) );
+        }
+        return sb.release();
+    }
+
+    // forwarded from extractor.h and creator.h
+    template <class K>
+    inline handle_t Extractor<K>::gethandle( key_t k ) { return get_handle(_extractor_get(k)); }
+
+    template <class K>
+    template <class T>
+    inline std::shared_ptr<T> Extractor<K>::getobject( key_t k ) { return get_object<T>( gethandle(k) ); }
+
+    template <class K>
+    inline mxArray* Creator<K>::mkhandle( key_t k, handle_t h ) { return _creator_assign(k, make_handle(h)); }
+
+}
+
+#endif
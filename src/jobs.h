@@ -0,0 +1,169 @@
+#ifndef JMX_JOBS_H_INCLUDED
+#define JMX_JOBS_H_INCLUDED
+
+//==================================================
+// @title        jobs.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Asynchronous jobs: a gateway starts a computation on a background thread, and returns
+ * a handle immediately (see handles.h). Later calls poll, wait, cancel or fetch the result:
+ *
+ *      JMX_COMMAND(start) {
+ *          auto X = args.getmat<double>(0);    // inputs must outlive the job: copy them
+ *          Matrix<double> A( X.nr, X.nc ); std::copy( ... );
+ *          args.mkhandle( 0, launch_job<Matrix<double>>(
+ *              [A]( Job& job ) { ... job.advance(); if ( job.cancelled() ) ...; return result; },
+ *              []( const Matrix<double>& R ) { return copy_to_mx(R); }
+ *          ));
+ *      }
+ *      JMX_COMMAND(poll)  { args.out.assign( 0, make_job_info( *get_job(args.gethandle(0)) ) ); }
+ *      JMX_COMMAND(fetch) { args.out.assign( 0, get_job(args.gethandle(0))->fetch() ); }
+ *
+ * The job function runs off the Matlab thread, so it must not use the Mex API; it builds
+ * C++ results, which are converted to mxArrays by fetch, on the Matlab thread. Errors are
+ * rethrown by fetch. Destroying the handle (or clearing the Mex file) cancels the job and
+ * waits for its thread.
+ */
+namespace jmx {
+
+    class Job
+    {
+    public:
+
+        enum State { Running, Done, Failed, Cancelled };
+
+        Job();
+        virtual ~Job();
+
+        Job( const Job& ) = delete;
+        Job& operator= ( const Job& ) = delete;
+
+        // start the background thread
+        void start();
+
+        // ----------  =====  ----------
+        // called by the job
+
+        inline bool cancelled() const { return m_cancel.load( std::memory_order_relaxed ); }
+        inline void set_total( index_t n ) { m_total = n; }
+        inline void advance( index_t n=1 ) { m_count.fetch_add( n, std::memory_order_relaxed ); }
+
+        // ----------  =====  ----------
+        // called from the Matlab thread
+
+        State state() const;
+        inline bool finished() const { return state() != Running; }
+        inline void cancel() { m_cancel = true; }
+
+        inline index_t count() const { return m_count.load( std::memory_order_relaxed ); }
+        inline index_t total() const { return m_total; }
+        double progress() const;
+        double elapsed() const;
+
+        // wait for the job to finish (timeout in seconds, negative to wait forever);
+        // returns false on timeout, or if the user interrupts (Ctrl+C)
+        bool wait( double timeout=-1 );
+
+        // wait, rethrow errors, and convert the result
+        mxArray* fetch();
+
+        // message of the error, if the job failed
+        inline const char* error() const { return m_error.msg; }
+
+        static const char* state_name( State s );
+
+    protected:
+
+        virtual void _run() =0;
+        virtual mxArray* _convert() =0;
+
+        // cancel and join the thread (derived classes call this in their destructor)
+        void _stop();
+
+    private:
+
+        void _main();
+
+        using clock_t = std::chrono::steady_clock;
+
+        std::thread m_thread;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+        State m_state;
+        ErrorRecord m_error;
+
+        std::atomic<bool> m_cancel;
+        std::atomic<index_t> m_count;
+        std::atomic<index_t> m_total;
+        clock_t::time_point m_start, m_stop;
+    };
+
+    // ----------  =====  ----------
+
+    template <class R>
+    class TypedJob : public Job
+    {
+    public:
+
+        using run_t = std::function<R( Job& )>;
+        using convert_t = std::function<mxArray*( const R& )>;
+
+        TypedJob( run_t run, convert_t convert )
+            : m_fn(std::move(run)), m_convert(std::move(convert)) {}
+        ~TypedJob()
+            { _stop(); }
+
+        // the result, once finished
+        inline const R& result() const { return m_result; }
+
+    protected:
+
+        void _run() { m_result = m_fn(*this); }
+        mxArray* _convert() { return m_convert(m_result); }
+
+    private:
+
+        run_t m_fn;
+        convert_t m_convert;
+        R m_result;
+    };
+
+    // ----------  =====  ----------
+
+    // start a job owned by the calling Mex file, and return its handle
+    template <class R>
+    JMX_LOCAL inline handle_t launch_job(
+        typename TypedJob<R>::run_t run,
+        typename TypedJob<R>::convert_t convert,
+        const std::string& label="job" )
+    {
+        std::shared_ptr<Job> job( new TypedJob<R>( std::move(run), std::move(convert) ) );
+        const handle_t h = create_handle( job, sizeof(TypedJob<R>), label );
+        job->start();
+        return h;
+    }
+
+    inline std::shared_ptr<Job> get_job( handle_t h ) {
+        return get_object<Job>(h);
+    }
+
+    // struct with fields state, count, total, progress, elapsed (seconds) and error
+    mxArray* make_job_info( const Job& job );
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef JMX_LINALG_H_INCLUDED
+#define JMX_LINALG_H_INCLUDED
+
+//==================================================
+// @title        linalg.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Multi-threaded kernels for sparse matrices (see sparse.h), running on the runtime pool.
+ *
+ * Columns are split into parts with a similar number of non-zeros, to balance the load
+ * of matrices with irregular columns (e.g. graphs). Products which scatter into rows
+ * (A*x, row reductions) accumulate into per-thread buffers, allocated only for the threads
+ * taking part and freed on return, which are then combined in parallel.
+ *
+ * Outputs are overwritten, and should not alias the inputs.
+ */
+namespace jmx {
+
+    // boundaries of nparts column ranges with balanced number of non-zeros
+    template <class T, class M>
+    std::vector<index_t> balanced_columns( const SparseMatrix<T,M>& A, index_t nparts )
+    {
+        const index_t nnz = A.nnz();
+        nparts = std::max<index_t>( 1, std::min(nparts, A.nc) );
+
+        std::vector<index_t> bounds( nparts+1, A.nc );
+        bounds[0] = 0;
+        for ( index_t p = 1; p < nparts; ++p ) {
+            const index_t target = (nnz * p) / nparts;
+            bounds[p] = std::upper_bound( A.jc.data, A.jc.data + A.nc, target ) - A.jc.data - 1;
+            bounds[p] = std::max( bounds[p], bounds[p-1] );
+        }
+        return bounds;
+    }
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * Scatter the columns of A weighted by x into per-thread rows, and combine them:
+     *      y = init (op) A(:,c) * x[c] for all columns c
+     * This is used for A*x (op=+) and row reductions.
+     */
+    template <class T, class M, class U, class F, class G>
+    void _scatter_rows( const SparseMatrix<T,M>& A, U *y, const U& init, F&& accum, G&& combine )
+    {
+        const index_t nr = A.nr;
+        const index_t nt = runtime().nthreads();
+        const std::vector<index_t> bounds = balanced_columns( A, 4*nt );
+        const index_t nparts = bounds.size()-1;
+
+        // thread 0 writes directly into y; buffers of other threads are allocated when used,
+        // and freed on return (rather than kept by the arena, as they scale with nr)
+        std::vector< std::unique_ptr<U[]> > buf( nt );
+        std::fill( y, y+nr, init );
+
+        parallel_chunks( 0, nparts, [&]( index_t b, index_t e, index_t tid ) {
+            U *out = y;
+            if ( tid > 0 ) {
+                if ( !buf[tid] ) {
+                    buf[tid].reset( new U[nr] );
+                    std::fill( buf[tid].get(), buf[tid].get()+nr, init );
+                }
+                out = buf[tid].get();
+            }
+            for ( index_t c = bounds[b]; c < bounds[e]; ++c )
+                for ( index_t k = A.jc[c]; k < A.jc[c+1]; ++k )
+                    accum( out[A.ir[k]], A.val[k], c );
+        }, 1 );
+
+        parallel_chunks( 0, nr, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t t = 1; t < nt; ++t ) if ( buf[t] ) {
+                const U *in = buf[t].get();
+                for ( index_t r = b; r < e; ++r ) combine( y[r], in[r] );
+            }
+        });
+    }
+
+    // y = A*x, with raw pointers
+    template <class T, class M, class U>
+    void _spmv( const SparseMatrix<T,M>& A, const U *x, U *y )
+    {
+        _scatter_rows( A, y, U(0),
+            [x]( U& out, const T& a, index_t c ) { out += a * x[c]; },
+            []( U& out, const U& in ) { out += in; } );
+    }
+
+    // ------------------------------------------------------------------------
+
+    // y = A*x
+    template <class T, class MA, class U, class MX, class MY>
+    void spmv( const SparseMatrix<T,MA>& A, const Vector<U,MX>& x, const Vector<U,MY>& y )
+    {
+        JMX_ASSERT( x.n == A.nc && y.n == A.nr, "Dimension mismatch." );
+        _spmv( A, x.memptr(), y.memptr() );
+    }
+
+    // y = A'*x
+    template <class T, class MA, class U, class MX, class MY>
+    void spmv_t( const SparseMatrix<T,MA>& A, const Vector<U,MX>& x, const Vector<U,MY>& y )
+    {
+        JMX_ASSERT( x.n == A.nr && y.n == A.nc, "Dimension mismatch." );
+        const std::vector<index_t> bounds = balanced_columns( A, 4*runtime().nthreads() );
+
+        parallel_chunks( 0, bounds.size()-1, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t c = bounds[b]; c < bounds[e]; ++c ) {
+                U s = 0;
+                for ( index_t k = A.jc[c]; k < A.jc[c+1]; ++k )
+                    s += A.val[k] * x[A.ir[k]];
+                y[c] = s;
+            }
+        }, 1 );
+    }
+
+    // C = A*B
+    template <class T, class MA, class U, class MB, class MC>
+    void spmm( const SparseMatrix<T,MA>& A, const Matrix<U,MB>& B, const Matrix<U,MC>& C )
+    {
+        JMX_ASSERT( B.nr == A.nc && C.nr == A.nr && C.nc == B.nc, "Dimension mismatch." );
+        const index_t p = B.nc;
+
+        // few columns: parallelise each product
+        if ( p < runtime().nthreads() ) {
+            for ( index_t j = 0; j < p; ++j )
+                _spmv( A, B.memptr() + j*B.nr, C.memptr() + j*C.nr );
+            return;
+        }
+
+        // otherwise, one column of B per task
+        parallel_for( 0, p, [&]( index_t j ) {
+            const U *x = B.memptr() + j*B.nr;
+            U *y = C.memptr() + j*C.nr;
+
+            std::fill( y, y+C.nr, U(0) );
+            for ( index_t c = 0; c < A.nc; ++c ) {
+                const U xc = x[c];
+                if ( xc == U(0) ) continue;
+                for ( index_t k = A.jc[c]; k < A.jc[c+1]; ++k )
+                    y[A.ir[k]] += A.val[k] * xc;
+            }
+        }, 1 );
+    }
+
+    // C = A'*B
+    template <class T, class MA, class U, class MB, class MC>
+    void spmm_t( const SparseMatrix<T,MA>& A, const Matrix<U,MB>& B, const Matrix<U,MC>& C )
+    {
+        JMX_ASSERT( B.nr == A.nr && C.nr == A.nc && C.nc == B.nc, "Dimension mismatch." );
+        const std::vector<index_t> bounds = balanced_columns( A, 4*runtime().nthreads() );
+
+        parallel_chunks( 0, bounds.size()-1, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t c = bounds[b]; c < bounds[e]; ++c )
+            for ( index_t j = 0; j < B.nc; ++j ) {
+                const U *x = B.memptr() + j*B.nr;
+                U s = 0;
+                for ( index_t k = A.jc[c]; k < A.jc[c+1]; ++k )
+                    s += A.val[k] * x[A.ir[k]];
+                C(c,j) = s;
+            }
+        }, 1 );
+    }
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * Reductions of the stored elements in each column (output length nc) or each row
+     * (output length nr). Implicit zeros are not visited; empty columns/rows are set to init.
+     * The operator is called as op(accumulator,value) and should be associative.
+     */
+    template <class T, class MA, class U, class MY, class F>
+    void col_reduce( const SparseMatrix<T,MA>& A, const Vector<U,MY>& y, const U& init, F&& op )
+    {
+        JMX_ASSERT( y.n == A.nc, "Dimension mismatch." );
+        const std::vector<index_t> bounds = balanced_columns( A, 4*runtime().nthreads() );
+
+        parallel_chunks( 0, bounds.size()-1, [&]( index_t b, index_t e, index_t ) {
+            for ( index_t c = bounds[b]; c < bounds[e]; ++c ) {
+                U s = init;
+                for ( index_t k = A.jc[c]; k < A.jc[c+1]; ++k )
+                    s = op( s, static_cast<U>(A.val[k]) );
+                y[c] = s;
+            }
+        }, 1 );
+    }
+
+    template <class T, class MA, class U, class MY, class F>
+    void row_reduce( const SparseMatrix<T,MA>& A, const Vector<U,MY>& y, const U& init, F&& op )
+    {
+        JMX_ASSERT( y.n == A.nr, "Dimension mismatch." );
+        _scatter_rows( A, y.memptr(), init,
+            [&op]( U& out, const T& a, index_t ) { out = op( out, static_cast<U>(a) ); },
+            [&op]( U& out, const U& in ) { out = op( out, in ); } );
+    }
+
+    template <class T, class MA, class U, class MY>
+    inline void col_sum( const SparseMatrix<T,MA>& A, const Vector<U,MY>& y )
+        { col_reduce( A, y, U(0), std::plus<U>() ); }
+
+    template <class T, class MA, class U, class MY>
+    inline void row_sum( const SparseMatrix<T,MA>& A, const Vector<U,MY>& y )
+        { row_reduce( A, y, U(0), std::plus<U>() ); }
+
+}
+
+#endif
@@ -7,6 +7,30 @@
 
 #include "main.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cerrno>
+#include <map>
+#include <random>
+#include <set>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// call stacks of large allocations in debug builds
+#if !defined(NDEBUG) && (defined(__GLIBC__) || defined(__APPLE__))
+#define JMX_ALLOC_BACKTRACE
+#include <execinfo.h>
+#endif
+
 // ------------------------------------------------------------------------
 
 namespace jmx_types {
@@ -22,6 +46,9 @@ namespace jmx_types {
     template<> const mxClassID cpp2mex<uint64_t>::classid  = mxUINT64_CLASS;
     template<> const mxClassID cpp2mex<float>::classid     = mxSINGLE_CLASS;
     template<> const mxClassID cpp2mex<double>::classid    = mxDOUBLE_CLASS;
+
+    template<> const mxClassID cpp2mex< std::complex<float> >::classid   = mxSINGLE_CLASS;
+    template<> const mxClassID cpp2mex< std::complex<double> >::classid  = mxDOUBLE_CLASS;
     
 }
 
@@ -42,6 +69,206 @@ namespace jmx {
     
     // ----------  =====  ----------
     
+    void MessageQueue::_push( Node *node )
+    {
+        node->next.store( nullptr, std::memory_order_relaxed );
+        Node *prev = m_head.exchange( node, std::memory_order_acq_rel );
+        prev->next.store( node, std::memory_order_release );
+    }
+
+    void MessageQueue::push( std::string&& msg )
+    {
+        Node *node = new Node();
+        node->msg = std::move(msg);
+        _push(node);
+    }
+
+    bool MessageQueue::pop( std::string& msg )
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.load( std::memory_order_acquire );
+
+        // skip the stub node
+        if ( tail == &m_stub ) {
+            if ( !next ) return false;
+            m_tail = tail = next;
+            next = next->next.load( std::memory_order_acquire );
+        }
+
+        if ( !next ) {
+            // a producer is between exchange and link; try again later
+            if ( tail != m_head.load( std::memory_order_acquire ) ) 
+                return false;
+
+            // tail is the last node, put the stub behind it
+            _push( &m_stub );
+            next = tail->next.load( std::memory_order_acquire );
+            if ( !next ) return false;
+        }
+
+        m_tail = next;
+        msg = std::move(tail->msg);
+        delete tail;
+        return true;
+    }
+
+    // ----------  =====  ----------
+    
+    bool Console::is_owner() const
+    {
+        // if no thread claimed the console, any thread outside of the pool is the owner
+        const std::thread::id owner = m_owner.load();
+        if ( owner == std::thread::id() )
+            return !is_worker_thread();
+        else
+            return owner == std::this_thread::get_id();
+    }
+
+    void Console::write( const char *str, index_t len )
+    {
+        if ( len == 0 ) return;
+        if ( is_owner() ) {
+            drain(); // preserve ordering with queued messages
+            mexPrintf( "%.*s", static_cast<int>(len), str );
+        }
+        else {
+            m_queue.push(std::string( str, len ));
+        }
+    }
+
+    void Console::drain()
+    {
+        if ( !is_owner() ) return;
+
+        std::string msg;
+        while ( m_queue.pop(msg) )
+            mexPrintf( "%.*s", static_cast<int>(msg.size()), msg.data() );
+    }
+
+    Console& console()
+    {
+        static Console c;
+        return c;
+    }
+
+    // line buffer of each thread
+    static thread_local std::string g_line;
+
+    void console_write( const char *str, index_t len )
+    {
+        std::string& buf = g_line;
+        buf.append( str, len );
+
+        if ( buf.size() >= JMX_CONSOLE_BUFSIZE ) {
+            console().write( buf.data(), buf.size() );
+            buf.clear();
+        }
+        else if ( std::memchr( str, '\n', len ) ) {
+            const index_t n = buf.rfind('\n') + 1;
+            console().write( buf.data(), n );
+            buf.erase( 0, n );
+        }
+    }
+
+    void console_flush()
+    {
+        std::string& buf = g_line;
+        if ( !buf.empty() ) {
+            console().write( buf.data(), buf.size() );
+            buf.clear();
+        }
+        console().drain();
+    }
+
+    void console_printf( bool newline, const char *fmt, ... )
+    {
+        va_list args;
+        va_start( args, fmt );
+        console_vprintf( newline, fmt, args );
+        va_end( args );
+    }
+
+    void console_vprintf( bool newline, const char *fmt, va_list args )
+    {
+        char buf[JMX_MSGBUF_SIZE+1];
+        
+        va_list copy;
+        va_copy( copy, args );
+        const int n = vsnprintf( buf, sizeof(buf), fmt, copy );
+        va_end( copy );
+        if ( n < 0 ) return;
+
+        if ( n < static_cast<int>(sizeof(buf)) ) {
+            console_write( buf, n );
+        }
+        else {
+            // message too long for the stack buffer
+            std::string big( n+1, '\0' );
+            vsnprintf( &big[0], big.size(), fmt, args );
+            console_write( big.data(), n );
+        }
+
+        if ( newline ) console_write( "\n", 1 );
+    }
+    
+    // ----------  =====  ----------
+    
+    void ErrorRecord::set( const char *id, const char *msg )
+    {
+        snprintf( this->id, sizeof(this->id), "%s", id );
+        snprintf( this->msg, sizeof(this->msg), "%s", msg );
+    }
+
+    void ErrorRecord::capture()
+    {
+        try { throw; }
+        catch ( const Exception& e ) { set( e.id(), e.what() ); }
+        catch ( const std::exception& e ) { set( "JMX:exception", e.what() ); }
+        catch (...) { set( "JMX:unknown", "Unknown exception." ); }
+    }
+
+    ErrorRecord& thread_error()
+    {
+        static thread_local ErrorRecord r;
+        return r;
+    }
+
+    const ErrorChannel*& _thread_channel()
+    {
+        static thread_local const ErrorChannel *c = nullptr;
+        return c;
+    }
+
+    const std::atomic<bool>*& _thread_cancel()
+    {
+        static thread_local const std::atomic<bool> *f = nullptr;
+        return f;
+    }
+
+    void ErrorChannel::capture()
+    {
+        // only the first thread to fail writes its record
+        if ( m_failed.exchange(true) ) return;
+
+        ErrorRecord& r = thread_error();
+        r.capture();
+        m_error.store( &r, std::memory_order_release );
+    }
+
+    void ErrorChannel::rethrow() const
+    {
+        const ErrorRecord *r = error();
+        if ( r ) throw Exception( r->id, "%s", r->msg );
+    }
+
+    void raise( const ErrorRecord& r )
+    {
+        console_flush();
+        mexErrMsgIdAndTxt( r.id, "%s", r.msg );
+    }
+    
+    // ----------  =====  ----------
+    
     int set_field( mxArray *mxs, index_t index, const char *field, mxArray *value )
     {
         JMX_ASSERT( mxs, "Null pointer." );
@@ -72,7 +299,7 @@ namespace jmx {
     int set_cell( mxArray *mxc, index_t index, mxArray *value )
     {
         JMX_ASSERT( mxc, "Null pointer." );
-        JMX_ASSERT( mxIsStruct(mxc), "Input is not a cell." );
+        JMX_ASSERT( mxIsCell(mxc), "Input is not a cell." );
 
         mxSetCell( mxc, index, value );
         return 0; // mxSetCell doesn't return a status...
@@ -88,14 +315,259 @@ namespace jmx {
     
     std::string get_string( const mxArray *ms ) 
     {
+        JMX_PROFILE_SCOPE( "get_string" );
         JMX_ASSERT( ms, "Null pointer." );
         JMX_ASSERT( mxIsChar(ms), "Input is not a string." );
 
         std::string val;
+        alloc_transient( mxGetNumberOfElements(ms)+1 );
         val.resize( mxGetNumberOfElements(ms) );
         mxGetString( ms, &val[0], val.size()+1 );
         return val;
     }
+
+    // ----------  =====  ----------
+
+    static const uint32_t UNICODE_REPLACEMENT = 0xFFFD;
+
+    // length of the leading ASCII run, copied to out (if not null)
+    template <class I, class O>
+    static index_t ascii_run( const I *in, index_t n, O *out );
+
+    template <>
+    index_t ascii_run( const mxChar *in, index_t n, char *out )
+    {
+        index_t k = 0;
+    #ifdef __SSE2__
+        const __m128i hi = _mm_set1_epi16( static_cast<short>(0xFF80) );
+        const __m128i z = _mm_setzero_si128();
+        for ( ; k+8 <= n; k += 8 ) {
+            const __m128i v = _mm_loadu_si128( (const __m128i*) (in+k) );
+            if ( _mm_movemask_epi8(_mm_cmpeq_epi16( _mm_and_si128(v,hi), z )) != 0xFFFF ) break;
+            if ( out ) _mm_storel_epi64( (__m128i*) (out+k), _mm_packus_epi16(v,z) );
+        }
+    #endif
+        for ( ; k < n && static_cast<uint16_t>(in[k]) < 0x80; ++k )
+            if ( out ) out[k] = static_cast<char>(in[k]);
+        return k;
+    }
+
+    template <>
+    index_t ascii_run( const char *in, index_t n, mxChar *out )
+    {
+        index_t k = 0;
+    #ifdef __SSE2__
+        const __m128i z = _mm_setzero_si128();
+        for ( ; k+16 <= n; k += 16 ) {
+            const __m128i v = _mm_loadu_si128( (const __m128i*) (in+k) );
+            if ( _mm_movemask_epi8(v) ) break;
+            if ( out ) {
+                _mm_storeu_si128( (__m128i*) (out+k),   _mm_unpacklo_epi8(v,z) );
+                _mm_storeu_si128( (__m128i*) (out+k+8), _mm_unpackhi_epi8(v,z) );
+            }
+        }
+    #endif
+        for ( ; k < n && static_cast<uint8_t>(in[k]) < 0x80; ++k )
+            if ( out ) out[k] = static_cast<mxChar>(in[k]);
+        return k;
+    }
+
+    // decode one code point, and advance k
+    static uint32_t decode_utf16( const mxChar *in, index_t n, index_t& k )
+    {
+        const uint32_t c = static_cast<uint16_t>(in[k++]);
+        if ( c < 0xD800 || c > 0xDFFF ) return c;
+        if ( c < 0xDC00 && k < n ) {
+            const uint32_t d = static_cast<uint16_t>(in[k]);
+            if ( d >= 0xDC00 && d <= 0xDFFF ) {
+                ++k;
+                return 0x10000 + ((c - 0xD800) << 10) + (d - 0xDC00);
+            }
+        }
+        return UNICODE_REPLACEMENT;
+    }
+
+    static uint32_t decode_utf8( const char *str, index_t n, index_t& k )
+    {
+        const uint8_t *s = reinterpret_cast<const uint8_t*>(str);
+        const uint32_t c = s[k++];
+        if ( c < 0x80 ) return c;
+
+        index_t len; uint32_t cp, min;
+        if ( (c >> 5) == 0x6 )       { len = 1; cp = c & 0x1F; min = 0x80; }
+        else if ( (c >> 4) == 0xE )  { len = 2; cp = c & 0x0F; min = 0x800; }
+        else if ( (c >> 3) == 0x1E ) { len = 3; cp = c & 0x07; min = 0x10000; }
+        else return UNICODE_REPLACEMENT;
+
+        if ( k+len > n ) return UNICODE_REPLACEMENT;
+        for ( index_t i = 0; i < len; ++i ) {
+            if ( (s[k+i] >> 6) != 0x2 ) return UNICODE_REPLACEMENT;
+            cp = (cp << 6) | (s[k+i] & 0x3F);
+        }
+        k += len;
+
+        // overlong encodings, surrogates and out of range
+        if ( cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF) ) return UNICODE_REPLACEMENT;
+        return cp;
+    }
+
+    index_t utf8_length( const mxChar *in, index_t n )
+    {
+        index_t len = 0;
+        for ( index_t k = 0; ; ) {
+            const index_t a = ascii_run<mxChar,char>( in+k, n-k, nullptr );
+            len += a; k += a;
+            if ( k >= n ) break;
+
+            const uint32_t cp = decode_utf16( in, n, k );
+            len += cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4);
+        }
+        return len;
+    }
+
+    char* utf16_to_utf8( const mxChar *in, index_t n, char *out )
+    {
+        for ( index_t k = 0; ; ) {
+            const index_t a = ascii_run( in+k, n-k, out );
+            out += a; k += a;
+            if ( k >= n ) break;
+
+            const uint32_t cp = decode_utf16( in, n, k );
+            if ( cp < 0x800 ) {
+                *out++ = static_cast<char>( 0xC0 | (cp >> 6) );
+            }
+            else if ( cp < 0x10000 ) {
+                *out++ = static_cast<char>( 0xE0 | (cp >> 12) );
+                *out++ = static_cast<char>( 0x80 | ((cp >> 6) & 0x3F) );
+            }
+            else {
+                *out++ = static_cast<char>( 0xF0 | (cp >> 18) );
+                *out++ = static_cast<char>( 0x80 | ((cp >> 12) & 0x3F) );
+                *out++ = static_cast<char>( 0x80 | ((cp >> 6) & 0x3F) );
+            }
+            *out++ = static_cast<char>( 0x80 | (cp & 0x3F) );
+        }
+        return out;
+    }
+
+    index_t utf16_length( const char *in, index_t n )
+    {
+        index_t len = 0;
+        for ( index_t k = 0; ; ) {
+            const index_t a = ascii_run<char,mxChar>( in+k, n-k, nullptr );
+            len += a; k += a;
+            if ( k >= n ) break;
+
+            len += decode_utf8( in, n, k ) < 0x10000 ? 1 : 2;
+        }
+        return len;
+    }
+
+    mxChar* utf8_to_utf16( const char *in, index_t n, mxChar *out )
+    {
+        for ( index_t k = 0; ; ) {
+            const index_t a = ascii_run( in+k, n-k, out );
+            out += a; k += a;
+            if ( k >= n ) break;
+
+            const uint32_t cp = decode_utf8( in, n, k );
+            if ( cp < 0x10000 )
+                *out++ = static_cast<mxChar>(cp);
+            else {
+                *out++ = static_cast<mxChar>( 0xD800 + ((cp - 0x10000) >> 10) );
+                *out++ = static_cast<mxChar>( 0xDC00 + ((cp - 0x10000) & 0x3FF) );
+            }
+        }
+        return out;
+    }
+
+    // ----------  =====  ----------
+
+    void CellStr::clear()
+    {
+        m_buf.clear();
+        m_off.clear();
+    }
+
+    void CellStr::wrap( const mxArray *ms )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( mxIsCell(ms), "Input is not a cell." );
+
+        // read the pointers on the calling thread
+        const index_t n = mxGetNumberOfElements(ms);
+        std::vector<const mxChar*> src(n);
+        std::vector<index_t> len(n);
+        for ( index_t k = 0; k < n; ++k ) {
+            const mxArray *e = mxGetCell(ms,k);
+            len[k] = e ? mxGetNumberOfElements(e) : 0;
+            if ( len[k] > 0 ) {
+                JMX_ASSERT( mxIsChar(e) && mxGetM(e) == 1, "Element %zu is not a string.", k );
+                src[k] = mxGetChars(e);
+            }
+        }
+
+        // byte offsets, with terminating nulls
+        m_off.resize(n+1);
+        m_off[0] = 0;
+        parallel_for( 0, n, [&]( index_t k ) {
+            m_off[k+1] = utf8_length( src[k], len[k] ) + 1;
+        });
+        for ( index_t k = 0; k < n; ++k ) m_off[k+1] += m_off[k];
+
+        alloc_transient( m_off[n] + (n+1)*sizeof(index_t) );
+        m_buf.resize( m_off[n] );
+        parallel_for( 0, n, [&]( index_t k ) {
+            *utf16_to_utf8( src[k], len[k], &m_buf[m_off[k]] ) = 0;
+        });
+    }
+
+    std::vector<string_view> CellStr::views() const
+    {
+        std::vector<string_view> v( size() );
+        for ( index_t k = 0; k < v.size(); ++k ) v[k] = (*this)[k];
+        return v;
+    }
+
+    std::vector<uint64_t> CellStr::hashes() const
+    {
+        std::vector<uint64_t> h( size() );
+        parallel_for( 0, h.size(), [&]( index_t k ) {
+            h[k] = hash_string( c_str(k), length(k) );
+        });
+        return h;
+    }
+
+    index_t CellStr::intern( std::vector<index_t>& codes, std::vector<string_view>& labels ) const
+    {
+        const index_t n = size();
+        const std::vector<uint64_t> h = hashes();
+
+        // open addressing, slots contain code+1 (0 if empty)
+        index_t cap = 16;
+        while ( cap < 2*n ) cap *= 2;
+        std::vector<index_t> table( cap, 0 );
+        std::vector<uint64_t> lh;
+
+        codes.resize(n);
+        labels.clear();
+        for ( index_t k = 0; k < n; ++k )
+        {
+            const string_view s = (*this)[k];
+            index_t slot = h[k] & (cap-1);
+            for ( ; table[slot]; slot = (slot+1) & (cap-1) ) {
+                const index_t c = table[slot]-1;
+                if ( lh[c] == h[k] && labels[c] == s ) break;
+            }
+            if ( !table[slot] ) {
+                labels.push_back(s);
+                lh.push_back(h[k]);
+                table[slot] = labels.size();
+            }
+            codes[k] = table[slot]-1;
+        }
+        return labels.size();
+    }
     
     // ----------  =====  ----------
     
@@ -137,6 +609,7 @@ namespace jmx {
 
     bool MAT::open( const char *name )
     {
+        JMX_PROFILE_SCOPE( "MAT::open" );
         clear();
         JMX_ASSERT( name, "Null filename." );
 
@@ -182,6 +655,7 @@ namespace jmx {
 
     bool Struct::wrap( const mxArray* ms, index_t index )
     {
+        JMX_PROFILE_SCOPE( "Struct::wrap" );
         clear();
         JMX_ASSERT( ms, "Null pointer." );
         JMX_ASSERT( mxIsStruct(ms), "Input is not a structure." );
@@ -201,4 +675,2377 @@ namespace jmx {
         return true;
     }
 
+
+    // ----------  =====  ----------
+    
+    static thread_local bool g_worker = false;
+
+    bool is_worker_thread() 
+    {
+        return g_worker;
+    }
+
+    index_t default_nthreads()
+    {
+        const char *env = std::getenv("JMX_NUM_THREADS");
+        if ( env && std::atoi(env) > 0 )
+            return std::atoi(env);
+
+        const index_t n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    void ThreadPool::start( index_t nthreads )
+    {
+        JMX_ASSERT( !running(), "Thread pool already started." );
+        m_stop = false;
+
+        for ( index_t t = 0; t < nthreads; ++t )
+            m_workers.emplace_back( &ThreadPool::work, this );
+    }
+
+    void ThreadPool::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+
+        for ( auto& w: m_workers ) 
+            if ( w.joinable() ) w.join();
+
+        m_workers.clear();
+        m_queue.clear();
+    }
+
+    void ThreadPool::submit( task_t task )
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back( std::move(task) );
+        }
+        m_cv.notify_one();
+    }
+
+    void ThreadPool::work()
+    {
+        g_worker = true;
+        for (;;)
+        {
+            task_t task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait( lock, [this](){ return m_stop || !m_queue.empty(); } );
+                if ( m_stop && m_queue.empty() ) return;
+
+                task = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            JMX_TRACE_SCOPE( "task", "pool" );
+            task();
+        }
+    }
+    
+    // ----------  =====  ----------
+    
+    bool Cache::has( const std::string& key ) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_map.find(key) != m_map.end();
+    }
+
+    bool Cache::erase( const std::string& key )
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_map.erase(key) > 0;
+    }
+
+    void Cache::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_map.clear();
+    }
+
+    index_t Cache::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_map.size();
+    }
+
+    // ----------  =====  ----------
+
+    /**
+     * Generations are drawn from one counter for the whole process, which survives the
+     * teardown of the runtime: slots of a new registry never reuse the generation of a stale
+     * handle. It starts at random, for handles kept by Matlab across a reload of the library.
+     */
+    static uint32_t _registry_seed() { return std::random_device()(); }
+    static std::atomic<uint32_t> g_registry_gen( _registry_seed() );
+
+    static uint32_t _registry_next_gen()
+    {
+        uint32_t g;
+        do { g = g_registry_gen.fetch_add( 1, std::memory_order_relaxed ) + 1; }
+        while ( g == 0 ); // handle 0 is never valid
+        return g;
+    }
+
+    handle_t Registry::_create( std::shared_ptr<void> ptr, std::type_index type, const void *owner, index_t bytes, const std::string& label )
+    {
+        JMX_ASSERT( ptr, "Null object." );
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        uint32_t k;
+        if ( m_free.empty() ) {
+            JMX_ASSERT( m_slot.size() < 0xFFFFFFFFu, "Too many objects." );
+            k = static_cast<uint32_t>( m_slot.size() );
+            m_slot.emplace_back();
+        }
+        else {
+            k = m_free.back();
+            m_free.pop_back();
+        }
+
+        Slot& s = m_slot[k];
+        s.ptr = std::move(ptr);
+        s.type = type;
+        s.owner = owner;
+        s.bytes = bytes;
+        s.label = label;
+        s.gen = _registry_next_gen();
+
+        return (static_cast<handle_t>(s.gen) << 32) | k;
+    }
+
+    const Registry::Slot* Registry::_slot( handle_t h ) const
+    {
+        const index_t k = h & 0xFFFFFFFFu;
+        const uint32_t gen = static_cast<uint32_t>( h >> 32 );
+        if ( k >= m_slot.size() || !m_slot[k].ptr || m_slot[k].gen != gen ) return nullptr;
+        return &m_slot[k];
+    }
+
+    Registry::Slot* Registry::_slot( handle_t h )
+    {
+        return const_cast<Slot*>( static_cast<const Registry*>(this)->_slot(h) );
+    }
+
+    std::shared_ptr<void> Registry::_get( handle_t h, std::type_index type ) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Slot *s = _slot(h);
+        if ( !s ) JMX_THROW_ID( "JMX:staleHandle", "Invalid or stale handle %llu.", (unsigned long long) h );
+        if ( s->type != type ) JMX_THROW_ID( "JMX:handleType", "Handle %llu refers to an object of type %s.", (unsigned long long) h, s->type.name() );
+        return s->ptr;
+    }
+
+    bool Registry::valid( handle_t h ) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return _slot(h) != nullptr;
+    }
+
+    bool Registry::destroy( handle_t h )
+    {
+        std::shared_ptr<void> obj; // destroyed after unlocking
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Slot *s = _slot(h);
+            if ( !s ) return false;
+
+            obj.swap( s->ptr );
+            s->label.clear();
+            m_free.push_back( h & 0xFFFFFFFFu );
+        }
+        return true;
+    }
+
+    void Registry::set_bytes( handle_t h, index_t bytes )
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Slot *s = _slot(h);
+        JMX_ASSERT( s, "Invalid or stale handle." );
+        s->bytes = bytes;
+    }
+
+    index_t Registry::release( const void *owner )
+    {
+        std::vector< std::shared_ptr<void> > obj;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for ( uint32_t k = 0; k < m_slot.size(); ++k ) {
+                Slot& s = m_slot[k];
+                if ( s.ptr && s.owner == owner ) {
+                    obj.push_back( std::move(s.ptr) );
+                    s.ptr.reset();
+                    s.label.clear();
+                    m_free.push_back(k);
+                }
+            }
+        }
+        return obj.size();
+    }
+
+    void Registry::clear()
+    {
+        std::vector<Slot> slot;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_slot.swap(slot);
+            m_free.clear();
+        }
+    }
+
+    index_t Registry::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slot.size() - m_free.size();
+    }
+
+    index_t Registry::size( const void *owner ) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        index_t n = 0;
+        for ( auto& s: m_slot ) n += s.ptr && s.owner == owner;
+        return n;
+    }
+
+    index_t Registry::bytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        index_t n = 0;
+        for ( auto& s: m_slot ) if ( s.ptr ) n += s.bytes;
+        return n;
+    }
+
+    std::vector<Registry::Info> Registry::info() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Info> out;
+        for ( uint32_t k = 0; k < m_slot.size(); ++k ) {
+            const Slot& s = m_slot[k];
+            if ( s.ptr )
+                out.push_back(Info{ (static_cast<handle_t>(s.gen) << 32) | k, s.type.name(), s.label, s.bytes });
+        }
+        return out;
+    }
+
+    void* Arena::acquire( index_t bytes )
+    {
+        const index_t c = size_class(bytes);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if ( !m_free[c].empty() ) 
+            {
+                void *ptr = m_free[c].back();
+                m_free[c].pop_back();
+                m_reserved -= capacity(bytes);
+                return ptr;
+            }
+        }
+
+        void *ptr = nullptr;
+        JMX_ASSERT( posix_memalign( &ptr, alignment, capacity(bytes) ) == 0, 
+            "Failed to allocate %zu bytes.", capacity(bytes) );
+        return ptr;
+    }
+
+    void Arena::release( void *ptr, index_t bytes )
+    {
+        if ( !ptr ) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free[ size_class(bytes) ].push_back(ptr);
+        m_reserved += capacity(bytes);
+    }
+
+    void Arena::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for ( auto& f: m_free ) {
+            for ( auto ptr: f ) std::free(ptr);
+            f.clear();
+        }
+        m_reserved = 0;
+    }
+
+    index_t Arena::reserved() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_reserved;
+    }
+
+    index_t Arena::size_class( index_t bytes )
+    {
+        index_t c = 0;
+        while ( (index_t(alignment) << c) < bytes ) ++c;
+        JMX_ASSERT( c < nclasses, "Block too large: %zu bytes.", bytes );
+        return c;
+    }
+    
+    // ----------  =====  ----------
+
+    static const uint64_t HASH_KEY[4] = {
+        0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL
+    };
+
+    // finalizer of MurmurHash3
+    static inline uint64_t hash_mix( uint64_t h )
+    {
+        h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33; return h;
+    }
+
+    // acc[i] += d[i^1] + lo(d[i]^key[i]) * hi(d[i]^key[i]), for n stripes of 32 bytes
+    static inline void hash_stripes( uint64_t acc[4], const uint8_t *p, index_t n )
+    {
+    #ifdef __SSE2__
+        __m128i a0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(acc) );
+        __m128i a1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(acc+2) );
+        const __m128i k0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(HASH_KEY) );
+        const __m128i k1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(HASH_KEY+2) );
+
+        for ( index_t s = 0; s < n; ++s, p += 32 ) {
+            const __m128i d0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+            const __m128i d1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p+16) );
+            const __m128i x0 = _mm_xor_si128(d0,k0), x1 = _mm_xor_si128(d1,k1);
+            a0 = _mm_add_epi64( a0, _mm_add_epi64( _mm_shuffle_epi32(d0, _MM_SHUFFLE(1,0,3,2)),
+                _mm_mul_epu32( x0, _mm_shuffle_epi32(x0, _MM_SHUFFLE(2,3,0,1)) ) ) );
+            a1 = _mm_add_epi64( a1, _mm_add_epi64( _mm_shuffle_epi32(d1, _MM_SHUFFLE(1,0,3,2)),
+                _mm_mul_epu32( x1, _mm_shuffle_epi32(x1, _MM_SHUFFLE(2,3,0,1)) ) ) );
+        }
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>(acc), a0 );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>(acc+2), a1 );
+    #else
+        uint64_t d[4];
+        for ( index_t s = 0; s < n; ++s, p += 32 ) {
+            std::memcpy( d, p, 32 );
+            for ( int i = 0; i < 4; ++i ) {
+                const uint64_t x = d[i] ^ HASH_KEY[i];
+                acc[i] += d[i^1] + (x & 0xFFFFFFFFULL) * (x >> 32);
+            }
+        }
+    #endif
+    }
+
+    // hash of a contiguous block, scrambling the accumulators every kilobyte
+    static uint64_t hash_block( const uint8_t *p, index_t n, uint64_t seed )
+    {
+        uint64_t acc[4] = { seed + HASH_KEY[0], seed ^ HASH_KEY[1], seed - HASH_KEY[2], ~seed ^ HASH_KEY[3] };
+        const index_t nstripes = n / 32;
+
+        for ( index_t s = 0; s < nstripes; s += 32 ) {
+            hash_stripes( acc, p + 32*s, std::min( nstripes-s, index_t(32) ) );
+            for ( int i = 0; i < 4; ++i )
+                acc[i] = (acc[i] ^ (acc[i] >> 47) ^ HASH_KEY[i]) * 0x9E3779B1ULL;
+        }
+
+        // zero-padded tail
+        if ( n % 32 ) {
+            uint8_t tail[32] = {0};
+            std::memcpy( tail, p + 32*nstripes, n % 32 );
+            hash_stripes( acc, tail, 1 );
+        }
+
+        uint64_t h = hash_mix( n * 0x9E3779B97F4A7C15ULL + seed );
+        for ( int i = 0; i < 4; ++i )
+            h = hash_combine( h, hash_mix(acc[i]) );
+        return hash_mix(h);
+    }
+
+    uint64_t hash_bytes( const void *data, index_t n, uint64_t seed )
+    {
+        const uint8_t *p = static_cast<const uint8_t*>(data);
+        if ( n <= JMX_HASH_BLOCK ) return hash_block( p, n, seed );
+
+        // hash blocks in parallel, then hash the block hashes
+        const index_t nb = (n + JMX_HASH_BLOCK - 1) / JMX_HASH_BLOCK;
+        std::vector<uint64_t> h(nb);
+        parallel_for( 0, nb, [&]( index_t b ) {
+            const index_t first = b * JMX_HASH_BLOCK;
+            h[b] = hash_block( p + first, std::min( n-first, index_t(JMX_HASH_BLOCK) ), seed );
+        }, 1 );
+
+        return hash_block( reinterpret_cast<const uint8_t*>(h.data()), nb*sizeof(uint64_t), seed ^ n );
+    }
+
+    uint64_t hash_array( const mxArray *ms, uint64_t seed )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+
+        const mxClassID c = mxGetClassID(ms);
+        const index_t nd = mxGetNumberOfDimensions(ms);
+        const bool cplx = mxIsComplex(ms);
+
+        uint64_t h = hash_combine( seed, (static_cast<uint64_t>(c) << 2) | (mxIsSparse(ms) << 1) | cplx );
+        h = hash_bytes( mxGetDimensions(ms), nd*sizeof(mwSize), h );
+
+        switch (c)
+        {
+            case mxSTRUCT_CLASS:
+            {
+                const index_t n = mxGetNumberOfElements(ms);
+                const int nf = mxGetNumberOfFields(ms);
+                for ( int f = 0; f < nf; ++f ) {
+                    const char *name = mxGetFieldNameByNumber(ms,f);
+                    h = hash_bytes( name, std::strlen(name), h );
+                }
+                for ( index_t i = 0; i < n; ++i ) 
+                for ( int f = 0; f < nf; ++f ) {
+                    const mxArray *v = mxGetFieldByNumber(ms,i,f);
+                    h = v ? hash_array(v,h) : hash_combine(h,0);
+                }
+                return h;
+            }
+
+            case mxCELL_CLASS:
+            {
+                const index_t n = mxGetNumberOfElements(ms);
+                for ( index_t i = 0; i < n; ++i ) {
+                    const mxArray *v = mxGetCell(ms,i);
+                    h = v ? hash_array(v,h) : hash_combine(h,0);
+                }
+                return h;
+            }
+
+            default:
+                JMX_ASSERT( mxIsNumeric(ms) || mxIsLogical(ms) || mxIsChar(ms),
+                    "Cannot hash arrays of class %s.", mxGetClassName(ms) );
+                break;
+        }
+
+        index_t n = mxGetNumberOfElements(ms);
+        if ( mxIsSparse(ms) ) {
+            const index_t nc = mxGetN(ms);
+            const mwIndex *jc = mxGetJc(ms);
+            n = jc[nc];
+            h = hash_bytes( jc, (nc+1)*sizeof(mwIndex), h );
+            h = hash_bytes( mxGetIr(ms), n*sizeof(mwIndex), h );
+        }
+
+        const index_t esize = mxGetElementSize(ms);
+        h = hash_bytes( mxGetData(ms), n*esize, h );
+    #if !MX_HAS_INTERLEAVED_COMPLEX
+        if ( cplx ) h = hash_bytes( mxGetImagData(ms), n*esize, h );
+    #endif
+        return h;
+    }
+
+    index_t array_bytes( const mxArray *ms )
+    {
+        if ( !ms ) return 0;
+
+        index_t b = sizeof(mxArray*), n = mxGetNumberOfElements(ms);
+        if ( mxIsStruct(ms) ) {
+            const int nf = mxGetNumberOfFields(ms);
+            for ( index_t i = 0; i < n; ++i ) 
+            for ( int f = 0; f < nf; ++f )
+                b += array_bytes( mxGetFieldByNumber(ms,i,f) );
+        }
+        else if ( mxIsCell(ms) ) {
+            for ( index_t i = 0; i < n; ++i )
+                b += array_bytes( mxGetCell(ms,i) );
+        }
+        else if ( mxIsSparse(ms) ) {
+            const index_t nz = mxGetNzmax(ms);
+            b += (mxGetN(ms)+1 + nz) * sizeof(mwIndex) + nz * mxGetElementSize(ms) * (mxIsComplex(ms) ? 2 : 1);
+        }
+        else {
+            b += n * mxGetElementSize(ms) * (mxIsComplex(ms) ? 2 : 1);
+        }
+        return b;
+    }
+
+    // ----------  =====  ----------
+
+    bool Memo::lookup( uint64_t key, index_t nout, mxArray *out[] )
+    {
+        auto it = m_map.find(key);
+        if ( it == m_map.end() ) { ++m_stats.misses; return false; }
+
+        // most recently used
+        m_lru.splice( m_lru.begin(), m_lru, it->second );
+
+        const Entry& e = *it->second;
+        for ( index_t k = 0; k < nout && k < e.out.size(); ++k )
+            out[k] = e.out[k] ? mxDuplicateArray(e.out[k]) : nullptr;
+
+        ++m_stats.hits;
+        return true;
+    }
+
+    void Memo::store( uint64_t key, const void *owner, index_t nout, mxArray *const out[] )
+    {
+        if ( m_map.find(key) != m_map.end() ) return;
+
+        index_t bytes = 0;
+        for ( index_t k = 0; k < nout; ++k ) bytes += array_bytes(out[k]);
+        if ( bytes > m_budget ) return;
+        _evict( m_budget - bytes );
+
+        Entry e{ key, owner, bytes, std::vector<mxArray*>(nout,nullptr) };
+        for ( index_t k = 0; k < nout; ++k ) 
+            if ( out[k] ) {
+                e.out[k] = mxDuplicateArray(out[k]);
+                mexMakeArrayPersistent(e.out[k]);
+            }
+
+        m_lru.push_front( std::move(e) );
+        m_map[key] = m_lru.begin();
+        m_bytes += bytes;
+        ++m_stats.stores;
+    }
+
+    void Memo::_destroy( std::list<Entry>::iterator it )
+    {
+        for ( auto ms: it->out ) if ( ms ) mxDestroyArray(ms);
+        m_bytes -= it->bytes;
+        m_map.erase(it->key);
+        m_lru.erase(it);
+    }
+
+    void Memo::_evict( index_t bytes )
+    {
+        while ( m_bytes > bytes && !m_lru.empty() ) {
+            _destroy( std::prev(m_lru.end()) );
+            ++m_stats.evictions;
+        }
+    }
+
+    index_t Memo::release( const void *owner )
+    {
+        index_t n = 0;
+        for ( auto it = m_lru.begin(); it != m_lru.end(); ) {
+            auto cur = it++;
+            if ( cur->owner == owner ) { _destroy(cur); ++n; }
+        }
+        return n;
+    }
+
+    void Memo::clear()
+    {
+        while ( !m_lru.empty() ) _destroy( m_lru.begin() );
+    }
+
+    void Memo::set_budget( index_t bytes )
+    {
+        m_budget = bytes;
+        _evict(bytes);
+    }
+
+    mxArray* make_memo_info()
+    {
+        const Memo& m = memo();
+        mxArray *ms = make_struct({ "entries", "bytes", "budget", "hits", "misses", "stores", "evictions" });
+        set_field( ms, "entries", make_scalar(m.size()) );
+        set_field( ms, "bytes", make_scalar(m.bytes()) );
+        set_field( ms, "budget", make_scalar(m.budget()) );
+        set_field( ms, "hits", make_scalar(m.stats().hits) );
+        set_field( ms, "misses", make_scalar(m.stats().misses) );
+        set_field( ms, "stores", make_scalar(m.stats().stores) );
+        set_field( ms, "evictions", make_scalar(m.stats().evictions) );
+        return ms;
+    }
+    
+    // ----------  =====  ----------
+
+    static const char SNAPSHOT_MAGIC[8] = { 'J','M','X','S','N','A','P','\0' };
+    static const uint32_t SNAPSHOT_VERSION = 1;
+    static const uint64_t SNAPSHOT_RAW = uint64_t(1) << 63; // chunk stored as is
+
+    static inline uint64_t align64( uint64_t n ) { return (n + 63) & ~uint64_t(63); }
+
+    index_t class_size( mxClassID c )
+    {
+        switch (c)
+        {
+            case mxLOGICAL_CLASS: return sizeof(mxLogical);
+            case mxCHAR_CLASS: return sizeof(mxChar);
+            case mxINT8_CLASS: case mxUINT8_CLASS: return 1;
+            case mxINT16_CLASS: case mxUINT16_CLASS: return 2;
+            case mxINT32_CLASS: case mxUINT32_CLASS: case mxSINGLE_CLASS: return 4;
+            case mxINT64_CLASS: case mxUINT64_CLASS: case mxDOUBLE_CLASS: return 8;
+            default: JMX_THROW( "Unsupported class: %d", int(c) );
+        }
+    }
+
+    // group bytes by position within each element (the remainder is copied as is)
+    static void byte_shuffle( const uint8_t *src, index_t n, index_t esize, uint8_t *dst )
+    {
+        const index_t ne = n / esize;
+        for ( index_t i = 0; i < ne; ++i )
+            for ( index_t j = 0; j < esize; ++j )
+                dst[ j*ne + i ] = src[ i*esize + j ];
+        std::memcpy( dst + ne*esize, src + ne*esize, n - ne*esize );
+    }
+
+    static void byte_unshuffle( const uint8_t *src, index_t n, index_t esize, uint8_t *dst )
+    {
+        const index_t ne = n / esize;
+        for ( index_t j = 0; j < esize; ++j )
+            for ( index_t i = 0; i < ne; ++i )
+                dst[ i*esize + j ] = src[ j*ne + i ];
+        std::memcpy( dst + ne*esize, src + ne*esize, n - ne*esize );
+    }
+
+    /**
+     * Run-length encoding: a control byte c < 128 is followed by c+1 literal bytes, 
+     * otherwise the next byte is repeated c-125 times (3 to 130).
+     */
+    static index_t rle_encode( const uint8_t *src, index_t n, uint8_t *dst )
+    {
+        index_t i = 0, lit = 0, o = 0;
+        auto literals = [&]() {
+            while ( lit < i ) {
+                const index_t m = std::min( i-lit, index_t(128) );
+                dst[o++] = static_cast<uint8_t>(m-1);
+                std::memcpy( dst+o, src+lit, m );
+                o += m; lit += m;
+            }
+        };
+
+        while ( i < n ) {
+            index_t r = 1;
+            while ( i+r < n && r < 130 && src[i+r] == src[i] ) ++r;
+            if ( r >= 3 ) {
+                literals();
+                dst[o++] = static_cast<uint8_t>(r+125);
+                dst[o++] = src[i];
+                lit = i += r;
+            }
+            else i += r;
+        }
+        literals();
+        return o;
+    }
+
+    static bool rle_decode( const uint8_t *src, index_t n, uint8_t *dst, index_t cap )
+    {
+        index_t i = 0, o = 0;
+        while ( i < n ) {
+            const index_t c = src[i++];
+            if ( c < 128 ) {
+                const index_t m = c+1;
+                if ( i+m > n || o+m > cap ) return false;
+                std::memcpy( dst+o, src+i, m );
+                i += m; o += m;
+            }
+            else {
+                const index_t m = c-125;
+                if ( i >= n || o+m > cap ) return false;
+                std::memset( dst+o, src[i++], m );
+                o += m;
+            }
+        }
+        return o == cap;
+    }
+
+    static void write_all( int fd, const void *buf, index_t n, uint64_t offset )
+    {
+        const char *p = static_cast<const char*>(buf);
+        while ( n > 0 ) {
+            const ssize_t w = pwrite( fd, p, n, offset );
+            JMX_ASSERT( w > 0, "Failed to write snapshot." );
+            p += w; n -= w; offset += w;
+        }
+    }
+
+    void save_snapshot( const char *path, const mxArray *ms, bool compress )
+    {
+        JMX_ASSERT( path, "Null filename." );
+        JMX_ASSERT( ms, "Null pointer." );
+
+        using Node = Snapshot::Node;
+        using Segment = Snapshot::Segment;
+
+        std::vector<Node> node;
+        std::vector<Segment> seg;
+        std::vector<const void*> src;
+        std::vector<uint64_t> dims;
+        std::string names;
+
+        auto add_segment = [&]( const void *ptr, index_t bytes, index_t esize ) {
+            seg.push_back(Segment{ 0, bytes, bytes, static_cast<uint32_t>(esize), 0 });
+            src.push_back(ptr);
+        };
+
+        // sparse indices are stored in 64 bits, regardless of mwIndex (converted if needed)
+        std::vector< std::vector<uint64_t> > wide;
+        auto add_indices = [&]( const mwIndex *ptr, index_t n ) {
+            if ( sizeof(mwIndex) != sizeof(uint64_t) ) {
+                wide.emplace_back( ptr, ptr+n );
+                ptr = reinterpret_cast<const mwIndex*>( wide.back().data() );
+            }
+            add_segment( ptr, n*sizeof(uint64_t), sizeof(uint64_t) );
+        };
+
+        // breadth-first, so that the children of each node are contiguous
+        std::vector<const mxArray*> queue( 1, ms );
+        for ( index_t k = 0; k < queue.size(); ++k )
+        {
+            const mxArray *a = queue[k];
+            Node x = Node();
+            if ( !a ) { x.cls = -1; node.push_back(x); continue; }
+
+            const mxClassID c = mxGetClassID(a);
+            const index_t n = mxGetNumberOfElements(a);
+            const mwSize *d = mxGetDimensions(a);
+
+            x.cls = c;
+            x.flags = (mxIsComplex(a) ? uint32_t(Snapshot::Complex) : 0u)
+                | (mxIsSparse(a) ? uint32_t(Snapshot::Sparse) : 0u);
+            x.ndims = mxGetNumberOfDimensions(a);
+            x.dims = dims.size();
+            dims.insert( dims.end(), d, d + x.ndims );
+            x.seg = seg.size();
+
+            if ( c == mxSTRUCT_CLASS )
+            {
+                const int nf = mxGetNumberOfFields(a);
+                x.nfields = nf;
+                x.names = names.size();
+                for ( int f = 0; f < nf; ++f ) {
+                    names += mxGetFieldNameByNumber(a,f);
+                    names.push_back('\0');
+                }
+
+                x.child = queue.size();
+                x.nchild = n*nf;
+                for ( index_t i = 0; i < n; ++i )
+                    for ( int f = 0; f < nf; ++f )
+                        queue.push_back( mxGetFieldByNumber(a,i,f) );
+            }
+            else if ( c == mxCELL_CLASS )
+            {
+                x.child = queue.size();
+                x.nchild = n;
+                for ( index_t i = 0; i < n; ++i )
+                    queue.push_back( mxGetCell(a,i) );
+            }
+            else
+            {
+                JMX_ASSERT( mxIsNumeric(a) || mxIsLogical(a) || mxIsChar(a),
+                    "Cannot save arrays of class %s.", mxGetClassName(a) );
+
+                const index_t esize = class_size(c);
+                index_t ne = n;
+                if ( mxIsSparse(a) ) {
+                    const index_t nc = mxGetN(a);
+                    ne = mxGetJc(a)[nc];
+                    add_indices( mxGetJc(a), nc+1 );
+                    add_indices( mxGetIr(a), ne );
+                }
+
+            #if MX_HAS_INTERLEAVED_COMPLEX
+                add_segment( mxGetData(a), ne*esize*(mxIsComplex(a) ? 2 : 1), esize );
+            #else
+                add_segment( mxGetData(a), ne*esize, esize );
+                if ( mxIsComplex(a) ) 
+                    add_segment( mxGetImagData(a), ne*esize, esize );
+            #endif
+            }
+
+            x.nseg = seg.size() - x.seg;
+            node.push_back(x);
+        }
+
+        // split segments in chunks, compressed in parallel
+        struct Piece { index_t seg, first, bytes; };
+        std::vector<Piece> piece;
+        for ( index_t s = 0; s < seg.size(); ++s )
+            for ( index_t b = 0; b < seg[s].bytes; b += JMX_SNAPSHOT_CHUNK )
+                piece.push_back(Piece{ s, b, std::min( seg[s].bytes-b, uint64_t(JMX_SNAPSHOT_CHUNK) ) });
+
+        const index_t np = piece.size();
+        std::vector< std::vector<uint8_t> > packed( compress ? np : 0 );
+        std::vector<uint64_t> csize( compress ? np : 0 );
+        if ( compress ) 
+            parallel_chunks( 0, np, [&]( index_t b, index_t e, index_t ) {
+                std::vector<uint8_t> tmp( JMX_SNAPSHOT_CHUNK );
+                for ( index_t k = b; k < e; ++k ) {
+                    JMX_TRACE_SCOPE( "snapshot_compress", "io" );
+                    const Piece& p = piece[k];
+                    const uint8_t *data = static_cast<const uint8_t*>(src[p.seg]) + p.first;
+                    byte_shuffle( data, p.bytes, seg[p.seg].esize, tmp.data() );
+
+                    std::vector<uint8_t>& out = packed[k];
+                    out.resize( p.bytes + p.bytes/128 + 2 );
+                    const index_t n = rle_encode( tmp.data(), p.bytes, out.data() );
+                    if ( n < p.bytes ) { out.resize(n); csize[k] = n; }
+                    else { out.clear(); csize[k] = p.bytes | SNAPSHOT_RAW; }
+                }
+            }, 1 );
+
+        // layout: chunk table [chunk size, nchunks, sizes] before compressed segments
+        std::vector<uint64_t> poff(np);
+        std::vector< std::vector<uint64_t> > table( seg.size() );
+        uint64_t off = sizeof(Snapshot::Header);
+        for ( index_t s = 0, k = 0; s < seg.size(); ++s )
+        {
+            off = align64(off);
+            seg[s].offset = off;
+            if ( compress && seg[s].bytes > 0 ) 
+            {
+                seg[s].flags = Snapshot::Compressed;
+                table[s].push_back( JMX_SNAPSHOT_CHUNK );
+                table[s].push_back( 0 );
+                for ( ; k < np && piece[k].seg == s; ++k ) 
+                    table[s].push_back( csize[k] );
+                table[s][1] = table[s].size()-2;
+
+                off += table[s].size() * sizeof(uint64_t);
+                for ( index_t j = k - table[s][1]; j < k; ++j ) {
+                    poff[j] = off;
+                    off += csize[j] & ~SNAPSHOT_RAW;
+                }
+            }
+            else 
+            {
+                for ( ; k < np && piece[k].seg == s; ++k ) 
+                    poff[k] = off + piece[k].first;
+                off += seg[s].bytes;
+            }
+            seg[s].stored = off - seg[s].offset;
+        }
+
+        Snapshot::Header h;
+        std::memcpy( h.magic, SNAPSHOT_MAGIC, 8 );
+        h.version = SNAPSHOT_VERSION;
+    #if MX_HAS_INTERLEAVED_COMPLEX
+        h.flags = Snapshot::Interleaved;
+    #else
+        h.flags = 0;
+    #endif
+        h.nnodes = node.size();
+        h.nsegs = seg.size();
+        h.ndims = dims.size();
+        h.nnames = names.size();
+        h.tables = align64(off);
+        h.bytes = h.tables + node.size()*sizeof(Node) + seg.size()*sizeof(Segment) 
+            + dims.size()*sizeof(uint64_t) + names.size();
+
+        // write chunks in parallel
+        const int fd = ::open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        JMX_ASSERT( fd >= 0, "Error opening file: %s", path );
+        try 
+        {
+            JMX_ASSERT( ftruncate( fd, h.bytes ) == 0, "Failed to resize file: %s", path );
+
+            parallel_for( 0, np, [&]( index_t k ) {
+                JMX_TRACE_SCOPE( "snapshot_write", "io" );
+                const Piece& p = piece[k];
+                if ( compress && !(csize[k] & SNAPSHOT_RAW) )
+                    write_all( fd, packed[k].data(), packed[k].size(), poff[k] );
+                else 
+                    write_all( fd, static_cast<const uint8_t*>(src[p.seg]) + p.first, p.bytes, poff[k] );
+            }, 1 );
+
+            for ( index_t s = 0; s < seg.size(); ++s ) 
+                if ( !table[s].empty() )
+                    write_all( fd, table[s].data(), table[s].size()*sizeof(uint64_t), seg[s].offset );
+
+            off = h.tables;
+            write_all( fd, node.data(), node.size()*sizeof(Node), off ); off += node.size()*sizeof(Node);
+            write_all( fd, seg.data(), seg.size()*sizeof(Segment), off ); off += seg.size()*sizeof(Segment);
+            write_all( fd, dims.data(), dims.size()*sizeof(uint64_t), off ); off += dims.size()*sizeof(uint64_t);
+            write_all( fd, names.data(), names.size(), off );
+            write_all( fd, &h, sizeof(h), 0 );
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        JMX_ASSERT( ::close(fd) == 0, "Failed to close file: %s", path );
+    }
+
+    // ----------  =====  ----------
+
+    /**
+     * Consistency of a node with its segments, checked when opening (before any access):
+     * the sizes of the segments follow from the dimensions, so views and copies of the data
+     * never read past the mapping, even if the file is corrupt.
+     */
+    static bool snapshot_node_valid( const Snapshot::Node& x, const Snapshot::Segment *seg, 
+        const uint64_t *dims, bool inter )
+    {
+        const uint64_t MAX = ~uint64_t(0);
+
+        uint64_t ne = 1;
+        for ( index_t k = 0; k < x.ndims; ++k ) {
+            if ( dims[k] && ne > MAX / dims[k] ) return false;
+            ne *= dims[k];
+        }
+
+        if ( x.cls < 0 ) 
+            return x.nseg == 0 && x.nchild == 0;
+        if ( x.cls == mxSTRUCT_CLASS ) 
+            return x.nseg == 0 && (x.nfields == 0 || ne <= MAX / x.nfields) && x.nchild == ne*x.nfields;
+        if ( x.cls == mxCELL_CLASS ) 
+            return x.nseg == 0 && x.nfields == 0 && x.nchild == ne;
+
+        const mxClassID c = static_cast<mxClassID>(x.cls);
+        const bool cplx = x.flags & Snapshot::Complex, sparse = x.flags & Snapshot::Sparse;
+        const bool numeric = c >= mxDOUBLE_CLASS && c <= mxUINT64_CLASS;
+        if ( x.nchild || x.nfields || !(numeric || c == mxLOGICAL_CLASS || c == mxCHAR_CLASS) ) return false;
+        if ( cplx && !numeric ) return false;
+
+        // sparse: Jc (nc+1) and Ir (nnz) in 64 bits, then the values of the non-zeros
+        if ( sparse ) 
+        {
+            if ( x.ndims != 2 || !(c == mxDOUBLE_CLASS || c == mxLOGICAL_CLASS) || x.nseg < 2 ) return false;
+            const uint64_t nc = dims[1];
+            if ( nc >= MAX/8 || seg[0].bytes != (nc+1)*8 || seg[0].esize != 8 ) return false;
+            if ( seg[1].bytes % 8 != 0 || seg[1].esize != 8 || seg[1].bytes/8 > ne ) return false;
+            ne = seg[1].bytes / 8;
+            seg += 2;
+        }
+
+        // values: interleaved complex in one segment, or real and imaginary parts separately
+        const index_t nval = (cplx && !inter) ? 2 : 1;
+        const uint64_t esize = class_size(c) * ((cplx && inter) ? 2 : 1);
+        if ( x.nseg != nval + (sparse ? 2 : 0) || ne > MAX / esize ) return false;
+        for ( index_t k = 0; k < nval; ++k )
+            if ( seg[k].bytes != ne*esize || seg[k].esize != class_size(c) ) return false;
+
+        return true;
+    }
+
+    bool Snapshot::open( const char *path )
+    {
+        JMX_TRACE_SCOPE( "snapshot_open", "io" );
+        close();
+        JMX_ASSERT( path, "Null filename." );
+
+        const int fd = ::open( path, O_RDONLY );
+        JMX_ASSERT( fd >= 0, "Error opening file: %s", path );
+
+        struct stat st;
+        const bool ok = fstat( fd, &st ) == 0 && st.st_size >= off_t(sizeof(Header));
+        void *ptr = ok ? mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+        ::close(fd);
+        JMX_ASSERT( ptr != MAP_FAILED, "Failed to map file: %s", path );
+
+        m_data = static_cast<const uint8_t*>(ptr);
+        m_size = st.st_size;
+        try 
+        {
+            std::memcpy( &m_head, m_data, sizeof(Header) );
+            JMX_ASSERT( std::memcmp( m_head.magic, SNAPSHOT_MAGIC, 8 ) == 0, "Not a snapshot: %s", path );
+            JMX_ASSERT( m_head.version == SNAPSHOT_VERSION, "Unsupported snapshot version: %u", m_head.version );
+            JMX_ASSERT( m_head.bytes == m_size && m_head.tables <= m_size, "Truncated snapshot: %s", path );
+
+            const uint8_t *p = m_data + m_head.tables;
+            auto table = [&]( void *dst, index_t bytes ) {
+                JMX_ASSERT( p + bytes <= m_data + m_size, "Truncated snapshot: %s", path );
+                std::memcpy( dst, p, bytes );
+                p += bytes;
+            };
+
+            m_node.resize( m_head.nnodes );
+            m_seg.resize( m_head.nsegs );
+            m_dims.resize( m_head.ndims );
+            table( m_node.data(), m_node.size()*sizeof(Node) );
+            table( m_seg.data(), m_seg.size()*sizeof(Segment) );
+            table( m_dims.data(), m_dims.size()*sizeof(uint64_t) );
+            const char *names = reinterpret_cast<const char*>(p);
+
+            JMX_ASSERT( !m_node.empty() && m_head.nnames <= index_t(m_data + m_size - p), "Corrupt snapshot: %s", path );
+            JMX_ASSERT( m_head.nnames == 0 || names[m_head.nnames-1] == '\0', "Corrupt snapshot: %s", path );
+
+            for ( auto& s: m_seg )
+                JMX_ASSERT( s.offset <= m_head.tables && s.stored <= m_head.tables - s.offset
+                    && ((s.flags & Compressed) || s.stored >= s.bytes), "Corrupt snapshot: %s", path );
+
+            m_fields.resize( m_node.size() );
+            for ( index_t n = 0; n < m_node.size(); ++n )
+            {
+                const Node& x = m_node[n];
+                JMX_ASSERT( x.dims + x.ndims <= m_dims.size() && x.seg + x.nseg <= m_seg.size() 
+                    && (x.nchild == 0 || (x.child > n && x.child + x.nchild <= m_node.size())),
+                    "Corrupt snapshot: %s", path );
+                JMX_ASSERT( snapshot_node_valid( x, m_seg.data() + x.seg, m_dims.data() + x.dims, m_head.flags & Interleaved ),
+                    "Corrupt snapshot: %s", path );
+
+                index_t pos = x.names;
+                for ( index_t f = 0; f < x.nfields; ++f ) {
+                    JMX_ASSERT( pos < m_head.nnames, "Corrupt snapshot: %s", path );
+                    m_fields[n].push_back( names + pos );
+                    pos += std::strlen(names + pos) + 1;
+                }
+            }
+        }
+        catch (...) {
+            close();
+            throw;
+        }
+
+        return true;
+    }
+
+    void Snapshot::close()
+    {
+        if ( m_data ) munmap( const_cast<uint8_t*>(m_data), m_size );
+        m_data = nullptr;
+        m_size = 0;
+        
+        m_node.clear();
+        m_seg.clear();
+        m_dims.clear();
+        m_fields.clear();
+        m_unpacked.clear();
+    }
+
+    index_t Snapshot::numel( index_t n ) const
+    {
+        index_t ne = 1;
+        for ( index_t k = 0; k < ndims(n); ++k ) ne *= dim(n,k);
+        return ne;
+    }
+
+    bool Snapshot::has_field( index_t n, const char *name ) const
+    {
+        for ( auto f: m_fields.at(n) ) 
+            if ( std::strcmp(f,name) == 0 ) return true;
+        return false;
+    }
+
+    index_t Snapshot::field( index_t n, const char *name, index_t elem ) const
+    {
+        JMX_ASSERT( is_struct(n), "Not a struct." );
+        const auto& f = m_fields.at(n);
+        for ( index_t k = 0; k < f.size(); ++k )
+            if ( std::strcmp(f[k],name) == 0 ) 
+                return child( n, elem*f.size() + k );
+
+        JMX_THROW( "Field not found: %s", name );
+    }
+
+    index_t Snapshot::child( index_t n, index_t k ) const
+    {
+        const Node& x = node(n);
+        JMX_ASSERT( k < x.nchild, "Index out of bounds." );
+        return x.child + k;
+    }
+
+    const void* Snapshot::_segment( index_t s ) const
+    {
+        JMX_ASSERT( m_data, "Snapshot is not open." );
+        const Segment& g = m_seg.at(s);
+        const uint8_t *p = m_data + g.offset;
+        if ( !(g.flags & Compressed) ) return p;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_unpacked.find(s);
+        if ( it != m_unpacked.end() ) return it->second.get();
+
+        // decompress chunks in parallel
+        const uint64_t *table = reinterpret_cast<const uint64_t*>(p);
+        JMX_ASSERT( g.stored >= 2*sizeof(uint64_t), "Corrupt snapshot." );
+        const index_t chunk = table[0], nc = table[1];
+        JMX_ASSERT( chunk > 0 && (g.bytes + chunk-1)/chunk == nc && nc <= g.stored/sizeof(uint64_t) - 2, 
+            "Corrupt snapshot." );
+
+        std::vector<uint64_t> coff(nc+1);
+        coff[0] = (nc+2) * sizeof(uint64_t);
+        for ( index_t k = 0; k < nc; ++k ) 
+            coff[k+1] = coff[k] + (table[k+2] & ~SNAPSHOT_RAW);
+        JMX_ASSERT( coff[nc] <= g.stored, "Corrupt snapshot." );
+
+        std::unique_ptr<uint8_t[]> out( new uint8_t[g.bytes] );
+        parallel_chunks( 0, nc, [&]( index_t b, index_t e, index_t ) {
+            std::vector<uint8_t> tmp( chunk );
+            for ( index_t k = b; k < e; ++k ) {
+                JMX_TRACE_SCOPE( "snapshot_decompress", "io" );
+                const index_t first = k*chunk, n = std::min( index_t(g.bytes)-first, chunk );
+                const uint8_t *in = p + coff[k];
+                if ( table[k+2] & SNAPSHOT_RAW )
+                    std::memcpy( out.get() + first, in, n );
+                else {
+                    JMX_ASSERT( rle_decode( in, coff[k+1]-coff[k], tmp.data(), n ), "Corrupt snapshot." );
+                    byte_unshuffle( tmp.data(), n, g.esize, out.get() + first );
+                }
+            }
+        }, 1 );
+
+        return (m_unpacked[s] = std::move(out)).get();
+    }
+
+    // sparse indices are stored in 64 bits
+    static void copy_indices( mwIndex *dst, const void *src, index_t n )
+    {
+        if ( sizeof(mwIndex) == sizeof(uint64_t) ) 
+            std::memcpy( dst, src, n*sizeof(uint64_t) );
+        else
+            std::copy_n( static_cast<const uint64_t*>(src), n, dst );
+    }
+
+    mxArray* Snapshot::materialize( index_t n ) const
+    {
+        const Node& x = node(n);
+        if ( x.cls < 0 ) return nullptr;
+
+        std::vector<mwSize> d( m_dims.begin() + x.dims, m_dims.begin() + x.dims + x.ndims );
+        const mxClassID c = classid(n);
+        const bool cplx = x.flags & Complex;
+        mxArray *ms = nullptr;
+
+        if ( c == mxSTRUCT_CLASS ) 
+        {
+            std::vector<const char*> f( m_fields[n] );
+            ms = mxCreateStructArray( d.size(), d.data(), f.size(), f.data() );
+            for ( index_t k = 0; k < x.nchild; ++k )
+                mxSetFieldByNumber( ms, k / x.nfields, k % x.nfields, materialize(x.child + k) );
+            return ms;
+        }
+        if ( c == mxCELL_CLASS ) 
+        {
+            ms = mxCreateCellArray( d.size(), d.data() );
+            for ( index_t k = 0; k < x.nchild; ++k )
+                mxSetCell( ms, k, materialize(x.child + k) );
+            return ms;
+        }
+
+        index_t s = x.seg, ne = numel(n);
+        if ( x.flags & Sparse )
+        {
+            const uint64_t nnz = m_seg.at(s+1).bytes / sizeof(uint64_t);
+            JMX_ASSERT( nnz == index_t(nnz) && m_dims[x.dims] == d[0] && m_dims[x.dims+1] == d[1],
+                "Sparse matrix too large for 32-bit indices." );
+
+            const index_t nc = d.at(1);
+            ms = (c == mxLOGICAL_CLASS) ? mxCreateSparseLogicalMatrix( d[0], nc, std::max<index_t>(nnz,1) )
+                : mxCreateSparse( d[0], nc, std::max<index_t>(nnz,1), cplx ? mxCOMPLEX : mxREAL );
+            copy_indices( mxGetJc(ms), _segment(s), nc+1 );
+            copy_indices( mxGetIr(ms), _segment(s+1), nnz );
+            s += 2; ne = nnz;
+
+            // the indices are used by Matlab without checks
+            const mwIndex *jc = mxGetJc(ms), *ir = mxGetIr(ms);
+            bool ok = jc[0] == 0 && jc[nc] == nnz;
+            for ( index_t k = 0; ok && k < nc; ++k ) ok = jc[k] <= jc[k+1];
+            for ( index_t k = 0; ok && k < nnz; ++k ) ok = ir[k] < d[0];
+            if ( !ok ) {
+                mxDestroyArray(ms);
+                JMX_THROW( "Corrupt snapshot." );
+            }
+        }
+        else if ( c == mxCHAR_CLASS ) 
+            ms = mxCreateCharArray( d.size(), d.data() );
+        else if ( c == mxLOGICAL_CLASS )
+            ms = mxCreateLogicalArray( d.size(), d.data() );
+        else
+            ms = mxCreateNumericArray( d.size(), d.data(), c, cplx ? mxCOMPLEX : mxREAL );
+
+        // complex data is converted if the snapshot was written with the other API
+        const index_t esize = class_size(c);
+        const bool inter = m_head.flags & Interleaved;
+        uint8_t *dst = static_cast<uint8_t*>(mxGetData(ms));
+
+        if ( !cplx ) 
+            std::memcpy( dst, _segment(s), ne*esize );
+    #if MX_HAS_INTERLEAVED_COMPLEX
+        else if ( inter ) 
+            std::memcpy( dst, _segment(s), 2*ne*esize );
+        else {
+            const uint8_t *re = static_cast<const uint8_t*>(_segment(s));
+            const uint8_t *im = static_cast<const uint8_t*>(_segment(s+1));
+            for ( index_t k = 0; k < ne; ++k ) {
+                std::memcpy( dst + 2*k*esize, re + k*esize, esize );
+                std::memcpy( dst + (2*k+1)*esize, im + k*esize, esize );
+            }
+        }
+    #else
+        else if ( !inter ) {
+            std::memcpy( dst, _segment(s), ne*esize );
+            std::memcpy( mxGetImagData(ms), _segment(s+1), ne*esize );
+        }
+        else {
+            const uint8_t *ri = static_cast<const uint8_t*>(_segment(s));
+            uint8_t *im = static_cast<uint8_t*>(mxGetImagData(ms));
+            for ( index_t k = 0; k < ne; ++k ) {
+                std::memcpy( dst + k*esize, ri + 2*k*esize, esize );
+                std::memcpy( im + k*esize, ri + (2*k+1)*esize, esize );
+            }
+        }
+    #endif
+
+        return ms;
+    }
+    
+    // ----------  =====  ----------
+
+    static inline index_t page_size() {
+        static const index_t p = sysconf(_SC_PAGESIZE);
+        return p;
+    }
+
+    static const uint64_t SHARED_MAGIC = 0x4a4d58534841524bULL;
+
+    // POSIX names start with a slash
+    static inline std::string shared_path( const std::string& name ) {
+        JMX_ASSERT( !name.empty(), "Empty segment name." );
+        return name[0] == '/' ? name : "/" + name;
+    }
+
+    // the runtime may be linked statically into several Mex files of the same process, so
+    // the counter is qualified with a nonce per copy (random, and the address of the counter)
+    std::string shared_name()
+    {
+        static std::atomic<unsigned> count(0);
+        static const unsigned nonce = std::random_device()() 
+            ^ static_cast<unsigned>( reinterpret_cast<uintptr_t>(&count) >> 4 );
+        char buf[64];
+        std::snprintf( buf, sizeof(buf), "/jmx.%d.%08x.%u", int(getpid()), nonce, count++ );
+        return buf;
+    }
+
+    std::shared_ptr<SharedSegment> SharedSegment::create( const std::string& name, mxClassID cls, bool cplx,
+        const std::vector<index_t>& dims )
+    {
+        JMX_ASSERT( dims.size() <= JMX_SHARED_MAXDIMS, "Too many dimensions." );
+        const std::string path = shared_path(name);
+
+        index_t n = 1;
+        for ( auto d: dims ) n *= d;
+        const index_t bytes = n * class_size(cls) * (cplx ? 2 : 1);
+        const index_t offset = page_size();
+        const index_t size = offset + std::max<index_t>(bytes,1);
+
+        const int fd = shm_open( path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+        JMX_ASSERT( fd >= 0, "Failed to create shared segment '%s' (%s).", path.c_str(), std::strerror(errno) );
+
+        void *ptr = MAP_FAILED;
+        if ( ftruncate( fd, size ) == 0 )
+            ptr = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        ::close(fd);
+
+        if ( ptr == MAP_FAILED ) {
+            shm_unlink( path.c_str() );
+            JMX_THROW( "Failed to map shared segment '%s' (%s).", path.c_str(), std::strerror(errno) );
+        }
+
+        Header *h = static_cast<Header*>(ptr);
+        h->refs.store(1);
+        h->bytes = bytes;
+        h->offset = offset;
+        h->cls = cls;
+        h->complex = cplx;
+        h->ndims = dims.size();
+        for ( index_t k = 0; k < dims.size(); ++k ) h->dims[k] = dims[k];
+
+        // ready to be attached
+        h->magic.store( SHARED_MAGIC, std::memory_order_release );
+        return std::shared_ptr<SharedSegment>( new SharedSegment( path, static_cast<uint8_t*>(ptr), size, false ) );
+    }
+
+    std::shared_ptr<SharedSegment> SharedSegment::attach( const std::string& name, bool readonly )
+    {
+        const std::string path = shared_path(name);
+        // the header is always writable, to update the reference count
+        const int fd = shm_open( path.c_str(), O_RDWR, 0 );
+        JMX_ASSERT( fd >= 0, "Failed to open shared segment '%s' (%s).", path.c_str(), std::strerror(errno) );
+
+        struct stat st;
+        void *ptr = MAP_FAILED;
+        if ( fstat( fd, &st ) == 0 && st.st_size >= off_t(sizeof(Header)) )
+            ptr = mmap( nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        ::close(fd);
+        JMX_ASSERT( ptr != MAP_FAILED, "Failed to map shared segment '%s'.", path.c_str() );
+
+        uint8_t *base = static_cast<uint8_t*>(ptr);
+        Header *h = reinterpret_cast<Header*>(base);
+        const index_t offset = h->offset;
+        if ( h->magic.load( std::memory_order_acquire ) != SHARED_MAGIC
+            || offset % page_size() != 0 || offset + h->bytes > index_t(st.st_size) ) {
+            munmap( ptr, st.st_size );
+            JMX_THROW( "Shared segment '%s' is not ready or corrupt.", path.c_str() );
+        }
+
+        // data pages are protected against writes
+        if ( readonly && mprotect( base + offset, st.st_size - offset, PROT_READ ) != 0 ) {
+            const int err = errno;
+            munmap( ptr, st.st_size );
+            JMX_THROW( "Failed to protect shared segment '%s' (%s).", path.c_str(), std::strerror(err) );
+        }
+
+        h->refs.fetch_add(1);
+        return std::shared_ptr<SharedSegment>( new SharedSegment( path, base, st.st_size, readonly ) );
+    }
+
+    bool SharedSegment::remove( const std::string& name )
+    {
+        return shm_unlink( shared_path(name).c_str() ) == 0;
+    }
+
+    SharedSegment::~SharedSegment()
+    {
+        if ( m_head->refs.fetch_sub(1) == 1 ) 
+            shm_unlink( m_name.c_str() );
+        munmap( m_base, m_size );
+    }
+
+    index_t SharedSegment::numel() const
+    {
+        index_t n = 1;
+        for ( index_t k = 0; k < ndims(); ++k ) n *= dim(k);
+        return n;
+    }
+    
+    // ----------  =====  ----------
+
+    std::shared_ptr<MappedFile> MappedFile::open( const std::string& path, Mode mode, index_t bytes, index_t offset )
+    {
+        JMX_TRACE_SCOPE( "mmap_open", "io" );
+        const int fd = ::open( path.c_str(), mode == ReadWrite ? (O_RDWR | O_CREAT) : O_RDONLY, 0644 );
+        JMX_ASSERT( fd >= 0, "Error opening file: %s (%s)", path.c_str(), std::strerror(errno) );
+
+        struct stat st;
+        if ( fstat( fd, &st ) != 0 ) {
+            ::close(fd);
+            JMX_THROW( "Failed to stat file: %s", path.c_str() );
+        }
+
+        index_t fsize = st.st_size;
+        if ( bytes == 0 ) 
+            bytes = fsize > offset ? fsize - offset : 0;
+        else if ( mode == ReadWrite && offset + bytes > fsize ) {
+            if ( ftruncate( fd, offset + bytes ) != 0 ) {
+                ::close(fd);
+                JMX_THROW( "Failed to resize file: %s", path.c_str() );
+            }
+            fsize = offset + bytes;
+        }
+
+        if ( bytes == 0 || offset + bytes > fsize ) {
+            ::close(fd);
+            JMX_THROW( "File '%s' is too small (%zu bytes).", path.c_str(), fsize );
+        }
+
+        // mappings start on a page boundary
+        const index_t delta = offset % page_size();
+        const int prot = mode == ReadOnly ? PROT_READ : (PROT_READ | PROT_WRITE);
+        const int flags = mode == CopyOnWrite ? MAP_PRIVATE : MAP_SHARED;
+        void *ptr = mmap( nullptr, bytes + delta, prot, flags, fd, offset - delta );
+        ::close(fd);
+        JMX_ASSERT( ptr != MAP_FAILED, "Failed to map file: %s (%s)", path.c_str(), std::strerror(errno) );
+
+        return std::shared_ptr<MappedFile>( new MappedFile( path, mode, static_cast<uint8_t*>(ptr), delta, bytes ) );
+    }
+
+    MappedFile::~MappedFile()
+    {
+        munmap( m_base, m_bytes + m_delta );
+    }
+
+    void MappedFile::_range( index_t first, index_t len, uint8_t*& ptr, index_t& n ) const
+    {
+        JMX_ASSERT( first <= m_bytes, "Range out of bounds." );
+        if ( len == 0 || first + len > m_bytes ) len = m_bytes - first;
+
+        // extend to the start of the page
+        const index_t b = m_delta + first;
+        const index_t a = b - b % page_size();
+        ptr = m_base + a;
+        n = b + len - a;
+    }
+
+    void MappedFile::advise( Advice a, index_t first, index_t len ) const
+    {
+        uint8_t *ptr; index_t n;
+        _range( first, len, ptr, n );
+
+        // DONTNEED would discard private (copy-on-write) modifications
+        JMX_REJECT( a == DontNeed && m_mode == CopyOnWrite, 
+            "DontNeed would discard the modifications of a copy-on-write mapping." );
+
+        int adv = MADV_NORMAL;
+        switch (a) 
+        {
+            case Sequential: adv = MADV_SEQUENTIAL; break;
+            case Random: adv = MADV_RANDOM; break;
+            case WillNeed: adv = MADV_WILLNEED; break;
+            case DontNeed: adv = MADV_DONTNEED; break;
+            default: break;
+        }
+
+        JMX_WREJECT( madvise( ptr, n, adv ) != 0, "madvise failed (%s).", std::strerror(errno) );
+    }
+
+    void MappedFile::sync( bool wait, index_t first, index_t len ) const
+    {
+        JMX_ASSERT( m_mode == ReadWrite, "Only read-write mappings can be synchronised." );
+        uint8_t *ptr; index_t n;
+        _range( first, len, ptr, n );
+        JMX_ASSERT( msync( ptr, n, wait ? MS_SYNC : MS_ASYNC ) == 0, 
+            "Failed to sync file: %s (%s)", m_path.c_str(), std::strerror(errno) );
+    }
+    
+    // ----------  =====  ----------
+
+    void prefetch_memory( const void *ptr, index_t bytes )
+    {
+        if ( !ptr || bytes == 0 ) return;
+        const uintptr_t a = reinterpret_cast<uintptr_t>(ptr);
+        const uintptr_t b = a - a % page_size();
+        madvise( reinterpret_cast<void*>(b), bytes + (a-b), MADV_WILLNEED );
+    }
+
+    void prefetch_file( int fd, index_t offset, index_t bytes )
+    {
+    #ifdef POSIX_FADV_WILLNEED
+        posix_fadvise( fd, offset, bytes, POSIX_FADV_WILLNEED );
+    #endif
+    }
+
+    void read_file( int fd, void *buf, index_t bytes, index_t offset )
+    {
+        JMX_TRACE_SCOPE( "read_file", "io" );
+        char *p = static_cast<char*>(buf);
+        while ( bytes > 0 ) {
+            const ssize_t r = pread( fd, p, bytes, offset );
+            JMX_ASSERT( r > 0, "Failed to read file (%s).", r == 0 ? "unexpected end of file" : std::strerror(errno) );
+            p += r; bytes -= r; offset += r;
+        }
+    }
+    
+    // ----------  =====  ----------
+
+    Job::Job()
+        : m_state(Running), m_cancel(false), m_count(0), m_total(0)
+    {
+        m_error.set( "", "" );
+    }
+
+    Job::~Job()
+    {
+        _stop();
+    }
+
+    void Job::start()
+    {
+        JMX_ASSERT( !m_thread.joinable(), "Job already started." );
+        m_start = m_stop = clock_t::now();
+        m_thread = std::thread( &Job::_main, this );
+    }
+
+    void Job::_stop()
+    {
+        m_cancel = true;
+        if ( m_thread.joinable() ) m_thread.join();
+    }
+
+    void Job::_main()
+    {
+        State s = Done;
+        try {
+            _run();
+            if ( cancelled() ) s = Cancelled;
+        } 
+        catch (...) {
+            m_error.capture();
+            s = cancelled() ? Cancelled : Failed;
+        }
+        console_flush();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = clock_t::now();
+        m_state = s;
+        m_cv.notify_all();
+    }
+
+    Job::State Job::state() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_state;
+    }
+
+    double Job::progress() const
+    {
+        const index_t t = total();
+        if ( finished() ) return 1.0;
+        return t > 0 ? std::min( 1.0, double(count()) / t ) : 0.0;
+    }
+
+    double Job::elapsed() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const clock_t::time_point t = m_state == Running ? clock_t::now() : m_stop;
+        return std::chrono::duration<double>( t - m_start ).count();
+    }
+
+    bool Job::wait( double timeout )
+    {
+        const auto deadline = clock_t::now() + std::chrono::duration_cast<clock_t::duration>(
+            std::chrono::duration<double>( std::max(timeout,0.0) ));
+
+        // wake up regularly to print messages, and check for Ctrl+C
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while ( m_state == Running )
+        {
+            auto until = clock_t::now() + std::chrono::milliseconds(50);
+            if ( timeout >= 0 ) {
+                if ( clock_t::now() >= deadline ) return false;
+                until = std::min( until, deadline );
+            }
+            m_cv.wait_until( lock, until );
+
+            lock.unlock();
+            console().drain();
+            const bool stop = interruption_pending();
+            lock.lock();
+            if ( stop ) return m_state != Running;
+        }
+        return true;
+    }
+
+    mxArray* Job::fetch()
+    {
+        JMX_ASSERT( wait(), "Interrupted while waiting for the job." );
+        console_flush();
+
+        switch ( state() ) 
+        {
+            case Failed: 
+                throw Exception( m_error.id, "%s", m_error.msg );
+            case Cancelled: 
+                JMX_THROW_ID( "JMX:cancelled", "The job was cancelled." );
+            default:
+                return _convert();
+        }
+    }
+
+    const char* Job::state_name( State s )
+    {
+        switch (s)
+        {
+            case Running: return "running";
+            case Done: return "done";
+            case Failed: return "failed";
+            case Cancelled: return "cancelled";
+            default: return "unknown";
+        }
+    }
+
+    mxArray* make_job_info( const Job& job )
+    {
+        const Job::State s = job.state();
+        mxArray *ms = make_struct({ "state", "count", "total", "progress", "elapsed", "error" });
+        set_field( ms, "state", make_string(Job::state_name(s)) );
+        set_field( ms, "count", make_scalar(job.count()) );
+        set_field( ms, "total", make_scalar(job.total()) );
+        set_field( ms, "progress", make_scalar(job.progress()) );
+        set_field( ms, "elapsed", make_scalar(job.elapsed()) );
+        set_field( ms, "error", make_string( s == Job::Failed ? job.error() : "" ) );
+        return ms;
+    }
+    
+    // ----------  =====  ----------
+
+    Progress*& _thread_progress()
+    {
+        static thread_local Progress *p = nullptr;
+        return p;
+    }
+
+    Progress::Progress( index_t total, const std::string& label )
+        : m_count(0), m_cancel(false), m_total(total), 
+          m_poll(JMX_POLL_INTERVAL), m_print(JMX_PRINT_INTERVAL), m_auto(false), 
+          m_label(label), m_printed(false)
+    {
+        m_start = m_last_poll = m_last_print = clock_t::now();
+
+        // current token of this thread
+        m_outer = _thread_progress();
+        m_outer_flag = _thread_cancel();
+        _thread_progress() = this;
+        _thread_cancel() = &m_cancel;
+    }
+
+    Progress::~Progress()
+    {
+        _thread_progress() = m_outer;
+        _thread_cancel() = m_outer_flag;
+        if ( m_printed && !cancelled() ) _print(true);
+    }
+
+    bool Progress::checkpoint()
+    {
+        const clock_t::time_point now = clock_t::now();
+        auto ms = [&now]( clock_t::time_point t ) {
+            return index_t(std::chrono::duration_cast<std::chrono::milliseconds>( now - t ).count());
+        };
+
+        if ( !cancelled() && ms(m_last_poll) >= m_poll ) {
+            m_last_poll = now;
+            if ( interruption_pending() ) cancel();
+        }
+        if ( !m_label.empty() && ms(m_last_print) >= m_print ) {
+            m_last_print = now;
+            _print(false);
+        }
+        return !cancelled();
+    }
+
+    void Progress::check()
+    {
+        if ( cancelled() ) 
+            JMX_THROW_ID( "JMX:interrupted", "Interrupted." );
+    }
+
+    void Progress::_print( bool last )
+    {
+        const double t = std::chrono::duration<double>( clock_t::now() - m_start ).count();
+        const index_t n = count();
+        const double rate = t > 0 ? n / t : 0;
+        m_printed = true;
+
+        if ( last )
+            println( "%s: done, %zu items in %.1fs (%.3g items/s).", m_label.c_str(), n, t, rate );
+        else if ( m_total > 0 && rate > 0 ) 
+            println( "%s: %zu/%zu (%.1f%%), %.3g items/s, ETA %.1fs", m_label.c_str(), n, m_total,
+                100.0*n/m_total, rate, n < m_total ? (m_total-n)/rate : 0.0 );
+        else
+            println( "%s: %zu items, %.3g items/s", m_label.c_str(), n, rate );
+        
+        console_flush();
+    }
+    
+    // ----------  =====  ----------
+
+    Callback::Callback( const mxArray *fn, index_t nin, index_t batch )
+        : m_fn(fn), m_nin(nin), m_batch(std::max<index_t>(batch,1)), m_vec(true), 
+          m_trips(0), m_evals(0), m_time(0)
+    {
+        JMX_ASSERT( fn, "Null pointer." );
+        JMX_ASSERT( nin > 0, "Callbacks should have at least one input." );
+        if ( mxIsChar(fn) ) 
+            m_name = get_string(fn);
+        else 
+            JMX_ASSERT( mxIsClass(fn,"function_handle"), "Expected a function handle or a function name." );
+    }
+
+    void Callback::push( const double *x, double *out )
+    {
+        m_in.insert( m_in.end(), x, x+m_nin );
+        m_out.push_back(out);
+        if ( pending() >= m_batch ) flush();
+    }
+
+    double Callback::call( const double *x )
+    {
+        double y;
+        push( x, &y );
+        flush();
+        return y;
+    }
+
+    void Callback::map( const double *x, double *y, index_t n )
+    {
+        for ( index_t k = 0; k < n; ++k )
+            push( x + k*m_nin, y+k );
+        flush();
+    }
+
+    // copy n values returned by Matlab
+    static void _callback_output( const mxArray *ms, double *const *out, index_t n )
+    {
+        JMX_ASSERT( mxGetNumberOfElements(ms) == n, 
+            "Callback returned %zu values for %zu evaluations (use set_vectorised(false) if it is not vectorised).",
+            mxGetNumberOfElements(ms), n );
+        JMX_ASSERT( !mxIsComplex(ms) && !mxIsSparse(ms), "Callback should return real values." );
+
+        switch ( mxGetClassID(ms) )
+        {
+            case mxDOUBLE_CLASS: {
+                const double *v = static_cast<const double*>(mxGetData(ms));
+                for ( index_t k = 0; k < n; ++k ) *out[k] = v[k];
+                break; }
+            case mxSINGLE_CLASS: {
+                const float *v = static_cast<const float*>(mxGetData(ms));
+                for ( index_t k = 0; k < n; ++k ) *out[k] = v[k];
+                break; }
+            case mxLOGICAL_CLASS: {
+                const mxLogical *v = mxGetLogicals(ms);
+                for ( index_t k = 0; k < n; ++k ) *out[k] = v[k];
+                break; }
+            default:
+                JMX_THROW( "Callback should return double, single or logical values." );
+        }
+    }
+
+    void Callback::flush()
+    {
+        const index_t n = pending();
+        if ( n == 0 ) return;
+
+        try {
+            if ( m_vec ) {
+                mxArray *ms = _call( n, m_in.data() );
+                std::unique_ptr<mxArray,void(*)(mxArray*)> guard( ms, mxDestroyArray );
+                _callback_output( ms, m_out.data(), n );
+            }
+            else for ( index_t k = 0; k < n; ++k ) {
+                mxArray *ms = _call( 1, &m_in[k*m_nin] );
+                std::unique_ptr<mxArray,void(*)(mxArray*)> guard( ms, mxDestroyArray );
+                _callback_output( ms, &m_out[k], 1 );
+            }
+        }
+        catch (...) {
+            m_in.clear(); m_out.clear();
+            throw;
+        }
+        m_in.clear(); m_out.clear();
+    }
+
+    mxArray* Callback::_call( index_t n, const double *x )
+    {
+        // inputs as column vectors, after the function handle
+        std::vector<mxArray*> rhs;
+        if ( m_name.empty() ) rhs.push_back( const_cast<mxArray*>(m_fn) );
+        for ( index_t j = 0; j < m_nin; ++j ) {
+            mxArray *col = mxCreateNumericMatrix( n, 1, mxDOUBLE_CLASS, mxREAL );
+            double *p = static_cast<double*>(mxGetData(col));
+            for ( index_t i = 0; i < n; ++i ) p[i] = x[ i*m_nin + j ];
+            rhs.push_back(col);
+        }
+
+        mxArray *lhs = nullptr;
+        const clock_t::time_point start = clock_t::now();
+        mxArray *err = mexCallMATLABWithTrap( 1, &lhs, static_cast<int>(rhs.size()), rhs.data(), 
+            m_name.empty() ? "feval" : m_name.c_str() );
+        m_time += std::chrono::duration<double>( clock_t::now() - start ).count();
+        ++m_trips; m_evals += n;
+
+        for ( index_t j = rhs.size() - m_nin; j < rhs.size(); ++j )
+            mxDestroyArray( rhs[j] );
+
+        if ( err ) {
+            const mxArray *msg = mxGetProperty( err, 0, "message" );
+            const std::string str = msg ? get_string(msg) : "unknown error";
+            if ( msg ) mxDestroyArray( const_cast<mxArray*>(msg) );
+            mxDestroyArray(err);
+            JMX_THROW_ID( "JMX:callback", "Callback failed: %s", str.c_str() );
+        }
+        JMX_ASSERT( lhs, "Callback returned no output." );
+        return lhs;
+    }
+
+    mxArray* make_callback_info( const Callback& cb )
+    {
+        mxArray *ms = make_struct({ "roundtrips", "evaluations", "seconds", "batch", "vectorised" });
+        set_field( ms, "roundtrips", make_scalar(cb.roundtrips()) );
+        set_field( ms, "evaluations", make_scalar(cb.evaluations()) );
+        set_field( ms, "seconds", make_scalar(cb.seconds()) );
+        set_field( ms, "batch", make_scalar(cb.batch()) );
+        set_field( ms, "vectorised", make_logical(cb.vectorised()) );
+        return ms;
+    }
+    
+    // ----------  =====  ----------
+
+    struct _ProfileTable
+    {
+        _ProfileSlot slots[JMX_PROFILE_SLOTS];
+        _ProfileSlot other;
+    };
+
+    // tables of all threads, kept after the threads exit
+    static std::mutex g_profile_mutex;
+    static std::vector< std::unique_ptr<_ProfileTable> > g_profile_tables;
+
+    _ProfileSlot* _profile_slot( const char *name )
+    {
+        static thread_local _ProfileTable *table = nullptr;
+        if ( !table ) {
+            std::lock_guard<std::mutex> lock(g_profile_mutex);
+            g_profile_tables.emplace_back( new _ProfileTable() );
+            table = g_profile_tables.back().get();
+        }
+
+        // open addressing on the address of the name; the copy is compared as well, in case
+        // a literal of a Mex file which was cleared had the same address
+        const uint64_t h = (reinterpret_cast<uintptr_t>(name) >> 3) * 0x9E3779B97F4A7C15ULL;
+        for ( index_t i = 0; i < JMX_PROFILE_SLOTS; ++i ) {
+            _ProfileSlot& s = table->slots[ (h + i) % JMX_PROFILE_SLOTS ];
+            const char *k = s.key.load( std::memory_order_relaxed );
+            if ( k == name && std::strncmp( s.name, name, JMX_PROFILE_NAME-1 ) == 0 ) return &s;
+            if ( !k ) {
+                std::snprintf( s.name, JMX_PROFILE_NAME, "%s", name );
+                s.key.store( name, std::memory_order_release );
+                return &s;
+            }
+        }
+
+        _ProfileSlot& o = table->other;
+        if ( !o.key.load( std::memory_order_relaxed ) ) {
+            std::snprintf( o.name, JMX_PROFILE_NAME, "(other)" );
+            o.key.store( o.name, std::memory_order_release );
+        }
+        return &o;
+    }
+
+    ProfileScope*& ProfileScope::_current()
+    {
+        static thread_local ProfileScope *p = nullptr;
+        return p;
+    }
+
+    std::vector<ProfileEntry> profile_report()
+    {
+        std::unordered_map< std::string, ProfileEntry > agg;
+        {
+            std::lock_guard<std::mutex> lock(g_profile_mutex);
+            for ( auto& t: g_profile_tables )
+            for ( index_t i = 0; i <= JMX_PROFILE_SLOTS; ++i ) {
+                const _ProfileSlot& s = i < JMX_PROFILE_SLOTS ? t->slots[i] : t->other;
+                if ( !s.key.load( std::memory_order_acquire ) ) continue;
+
+                ProfileEntry& e = agg[s.name];
+                e.name = s.name;
+                e.count += s.count.load( std::memory_order_relaxed );
+                e.bytes += s.bytes.load( std::memory_order_relaxed );
+                e.total += 1e-9 * s.total.load( std::memory_order_relaxed );
+                e.max = std::max( e.max, 1e-9 * s.max.load( std::memory_order_relaxed ) );
+            }
+        }
+
+        std::vector<ProfileEntry> out;
+        for ( auto& kv: agg ) 
+            if ( kv.second.count > 0 || kv.second.bytes > 0 ) out.push_back( kv.second );
+        std::sort( out.begin(), out.end(), 
+            []( const ProfileEntry& a, const ProfileEntry& b ) { return a.total > b.total; } );
+        return out;
+    }
+
+    void profile_reset()
+    {
+        std::lock_guard<std::mutex> lock(g_profile_mutex);
+        for ( auto& t: g_profile_tables )
+        for ( index_t i = 0; i <= JMX_PROFILE_SLOTS; ++i ) {
+            _ProfileSlot& s = i < JMX_PROFILE_SLOTS ? t->slots[i] : t->other;
+            s.count = 0; s.total = 0; s.max = 0; s.bytes = 0;
+        }
+    }
+    
+    // ----------  =====  ----------
+
+    struct _TraceEvent
+    {
+        const char *name, *cat;
+        int64_t ts, dur; // ns
+    };
+
+    // ring buffer of one thread (written by that thread only)
+    struct _TraceBuffer
+    {
+        std::vector<_TraceEvent> ring;
+        std::atomic<uint64_t> head;
+        std::atomic<bool> busy;
+        std::atomic<uint64_t> gen;      // published after head and capacity are reset
+        std::atomic<index_t> capacity;  // size of the ring, readable while recording
+        index_t tid;
+        std::string label;
+    };
+
+    static std::mutex g_trace_mutex;
+    static std::vector< std::unique_ptr<_TraceBuffer> > g_trace_buffers;
+    static std::atomic<uint64_t> g_trace_gen(0);
+    static std::atomic<index_t> g_trace_capacity(JMX_TRACE_CAPACITY);
+    static std::atomic<trace_clock::rep> g_trace_origin(0);
+
+    static _TraceBuffer& _trace_buffer()
+    {
+        static thread_local _TraceBuffer *buf = nullptr;
+        if ( !buf ) {
+            std::lock_guard<std::mutex> lock(g_trace_mutex);
+            g_trace_buffers.emplace_back( new _TraceBuffer() );
+            buf = g_trace_buffers.back().get();
+            buf->tid = g_trace_buffers.size();
+            buf->label = console().is_owner() ? "Matlab" : (is_worker_thread() ? "worker" : "thread");
+        }
+        return *buf;
+    }
+
+    /**
+     * Names are interned in storage of the runtime (never freed): the literals belong to the
+     * Mex file which recorded the event, and may be unloaded before the trace is written.
+     * The per-thread cache is checked by name, in case another literal has the same address.
+     */
+    static const char* _trace_intern( const char *s )
+    {
+        static std::mutex mutex;
+        static std::set<std::string> names;
+        static thread_local std::unordered_map< const char*, const char* > cache;
+
+        auto it = cache.find(s);
+        if ( it != cache.end() && std::strcmp( it->second, s ) == 0 ) return it->second;
+
+        const char *p;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            p = names.insert(s).first->c_str();
+        }
+        return cache[s] = p;
+    }
+
+    void trace_event( const char *name, const char *cat, trace_clock::time_point start, trace_clock::time_point stop )
+    {
+        _TraceBuffer& b = _trace_buffer();
+
+        // the writer waits for busy buffers after clearing the flag
+        b.busy.store( true );
+        if ( _trace_flag().load() )
+        {
+            const uint64_t gen = g_trace_gen.load( std::memory_order_relaxed );
+            if ( b.gen.load( std::memory_order_relaxed ) != gen ) {
+                b.ring.assign( g_trace_capacity.load(), _TraceEvent() );
+                b.head.store( 0, std::memory_order_relaxed );
+                b.capacity.store( b.ring.size(), std::memory_order_relaxed );
+                b.gen.store( gen, std::memory_order_release );
+            }
+
+            const int64_t origin = g_trace_origin.load( std::memory_order_relaxed );
+            const int64_t t0 = std::chrono::duration_cast<std::chrono::nanoseconds>( start.time_since_epoch() ).count();
+            const int64_t t1 = std::chrono::duration_cast<std::chrono::nanoseconds>( stop.time_since_epoch() ).count();
+
+            const uint64_t h = b.head.load( std::memory_order_relaxed );
+            b.ring[ h % b.ring.size() ] = _TraceEvent{ _trace_intern(name), _trace_intern(cat), 
+                std::max<int64_t>( t0-origin, 0 ), t1-t0 };
+            b.head.store( h+1, std::memory_order_relaxed );
+        }
+        b.busy.store( false, std::memory_order_release );
+    }
+
+    // stop recording, and wait for events being written (with the mutex held)
+    static bool _trace_pause()
+    {
+        const bool was = _trace_flag().exchange(false);
+        for ( auto& b: g_trace_buffers )
+            while ( b->busy.load() ) std::this_thread::yield();
+        return was;
+    }
+
+    void trace_start( index_t capacity )
+    {
+        JMX_ASSERT( capacity > 0, "Trace capacity should be positive." );
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        _trace_pause();
+
+        g_trace_capacity = capacity;
+        g_trace_origin = std::chrono::duration_cast<std::chrono::nanoseconds>( 
+            trace_clock::now().time_since_epoch() ).count();
+        ++g_trace_gen;
+        _trace_flag() = true;
+    }
+
+    void trace_stop()
+    {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        _trace_pause();
+    }
+
+    // counts of the current generation, read without pausing the writers
+    index_t trace_count()
+    {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        index_t n = 0;
+        for ( auto& b: g_trace_buffers )
+            if ( b->gen.load( std::memory_order_acquire ) == g_trace_gen )
+                n += b->head.load();
+        return n;
+    }
+
+    index_t trace_dropped()
+    {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        index_t n = 0;
+        for ( auto& b: g_trace_buffers )
+            if ( b->gen.load( std::memory_order_acquire ) == g_trace_gen ) {
+                const index_t h = b->head.load(), c = b->capacity.load();
+                if ( h > c ) n += h - c;
+            }
+        return n;
+    }
+
+    // quoted and escaped JSON string
+    static void json_string( FILE *f, const char *s )
+    {
+        std::fputc( '"', f );
+        for ( ; *s; ++s ) {
+            const unsigned char c = *s;
+            if ( c == '"' || c == '\\' ) { std::fputc( '\\', f ); std::fputc( c, f ); }
+            else if ( c < 0x20 ) std::fprintf( f, "\\u%04x", c );
+            else std::fputc( c, f );
+        }
+        std::fputc( '"', f );
+    }
+
+    void trace_write( const std::string& path )
+    {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        const bool was = _trace_pause();
+
+        FILE *f = std::fopen( path.c_str(), "w" );
+        if ( f ) 
+        {
+            const int pid = getpid();
+            index_t dropped = 0;
+            bool first = true;
+            auto sep = [&]() { if ( !first ) std::fputs( ",\n", f ); first = false; };
+
+            std::fputs( "{\"traceEvents\":[\n", f );
+            for ( auto& b: g_trace_buffers )
+            {
+                if ( b->gen != g_trace_gen ) continue;
+                sep();
+                std::fprintf( f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%zu,\"args\":{\"name\":\"%s %zu\"}}",
+                    pid, b->tid, b->label.c_str(), b->tid ); // labels are fixed words
+
+                // oldest first
+                const uint64_t h = b->head, cap = b->ring.size(), n = std::min( h, cap );
+                dropped += h - n;
+                for ( uint64_t k = h-n; k < h; ++k ) {
+                    const _TraceEvent& e = b->ring[ k % cap ];
+                    sep();
+                    std::fputs( "{\"name\":", f ); json_string( f, e.name );
+                    std::fputs( ",\"cat\":", f ); json_string( f, e.cat );
+                    std::fprintf( f, ",\"ph\":\"X\",\"pid\":%d,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+                        pid, b->tid, 1e-3*e.ts, 1e-3*e.dur );
+                }
+            }
+            std::fprintf( f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%zu}}\n", dropped );
+        }
+        const bool ok = f && std::fclose(f) == 0;
+
+        _trace_flag() = was;
+        JMX_ASSERT( ok, "Failed to write trace: %s", path.c_str() );
+    }
+    
+    // ----------  =====  ----------
+
+    struct _AllocSite
+    {
+        index_t bytes;
+        std::string tag, stack;
+    };
+
+    // counters updated concurrently by the workers
+    struct _AllocCounter
+    {
+        std::atomic<index_t> count, bytes, current, peak;
+
+        _AllocCounter() { reset(); }
+
+        void reset()
+        {
+            count = 0; bytes = 0;
+            current = 0; peak = 0;
+        }
+
+        void add( index_t n, bool live, index_t transient=0 )
+        {
+            count.fetch_add( 1, std::memory_order_relaxed );
+            bytes.fetch_add( n, std::memory_order_relaxed );
+            index_t c = live ? current.fetch_add( n, std::memory_order_relaxed ) + n
+                             : current.load( std::memory_order_relaxed );
+            c += transient;
+
+            index_t p = peak.load( std::memory_order_relaxed );
+            while ( p < c && !peak.compare_exchange_weak( p, c, std::memory_order_relaxed ) ) {}
+        }
+
+        // saturates, in case of a reset while allocations are live
+        void sub( index_t n )
+        {
+            index_t c = current.load( std::memory_order_relaxed );
+            while ( !current.compare_exchange_weak( c, c - std::min(c,n), std::memory_order_relaxed ) ) {}
+        }
+
+        AllocStats load() const
+        {
+            return AllocStats{ count.load(), bytes.load(), current.load(), peak.load() };
+        }
+
+        void store( const AllocStats& s )
+        {
+            count = s.count; bytes = s.bytes;
+            current = s.current; peak = s.peak;
+        }
+    };
+
+    // interned tag, never freed: allocations keep a pointer to it until they are released
+    struct _AllocTagStats
+    {
+        std::string name;
+        _AllocCounter stats;
+
+        explicit _AllocTagStats( const char *name ) : name(name) {}
+    };
+
+    static std::mutex g_alloc_mutex; // interning and sites only
+    static _AllocCounter g_alloc_total, g_alloc_call, g_alloc_last;
+    static std::atomic<index_t> g_alloc_budget(0);
+    static std::map< std::string, _AllocTagStats* > g_alloc_tags;
+    static std::deque<_AllocSite> g_alloc_sites;
+
+    const char*& _alloc_tag()
+    {
+        static thread_local const char *tag = nullptr;
+        return tag;
+    }
+
+    static _AllocTagStats* _alloc_intern( const char *name )
+    {
+        std::lock_guard<std::mutex> lock(g_alloc_mutex);
+        _AllocTagStats*& t = g_alloc_tags[name];
+        if ( !t ) t = new _AllocTagStats(name);
+        return t;
+    }
+
+    /**
+     * Interned tag of the calling thread, looked up by pointer in a small per-thread cache.
+     * The name is compared as well, because the literal of a Mex file which was cleared may
+     * have the same address as that of another one.
+     */
+    static _AllocTagStats* _alloc_tag_stats()
+    {
+        static thread_local std::vector< std::pair<const char*,_AllocTagStats*> > cache;
+
+        const char *name = _alloc_tag();
+        if ( !name ) name = "(untagged)";
+
+        for ( auto& c: cache )
+            if ( c.first == name && c.second->name == name )
+                return c.second;
+
+        _AllocTagStats *t = _alloc_intern(name);
+        for ( auto& c: cache )
+            if ( c.first == name ) { c.second = t; return t; }
+
+        cache.emplace_back( name, t );
+        return t;
+    }
+
+    static void _alloc_check( index_t bytes, const _AllocTagStats *tag )
+    {
+        const index_t budget = g_alloc_budget.load( std::memory_order_relaxed );
+        const index_t current = g_alloc_call.current.load( std::memory_order_relaxed );
+        if ( budget > 0 && current + bytes > budget )
+            JMX_THROW_ID( "JMX:budget", "Allocation of %zu bytes (%s) would exceed the memory budget (%zu of %zu bytes in use).",
+                bytes, tag->name.c_str(), current, budget );
+    }
+
+    static void _alloc_site( index_t bytes, const _AllocTagStats *tag )
+    {
+    #ifdef JMX_ALLOC_BACKTRACE
+        if ( bytes < index_t(JMX_ALLOC_LARGE) ) return;
+
+        void *frames[16];
+        const int n = backtrace( frames, 16 );
+        char **sym = backtrace_symbols( frames, n );
+
+        _AllocSite site{ bytes, tag->name, "" };
+        for ( int k = 2; sym && k < n; ++k ) // skip the hooks
+            site.stack += std::string(sym[k]) + "\n";
+        std::free(sym);
+
+        std::lock_guard<std::mutex> lock(g_alloc_mutex);
+        g_alloc_sites.push_back( std::move(site) );
+        if ( g_alloc_sites.size() > JMX_ALLOC_SITES ) g_alloc_sites.pop_front();
+    #else
+        (void) bytes; (void) tag;
+    #endif
+    }
+
+    _AllocTagStats* alloc_acquire( index_t bytes )
+    {
+        _AllocTagStats *tag = _alloc_tag_stats();
+        _alloc_check( bytes, tag );
+        g_alloc_total.add( bytes, true );
+        g_alloc_call.add( bytes, true );
+        tag->stats.add( bytes, true );
+        _alloc_site( bytes, tag );
+        return tag;
+    }
+
+    void alloc_release( _AllocTagStats *tag, index_t bytes, bool output )
+    {
+        g_alloc_total.sub( bytes );
+        if ( tag ) tag->stats.sub( bytes );
+        if ( !output ) g_alloc_call.sub( bytes );
+    }
+
+    void alloc_output( index_t bytes )
+    {
+        _AllocTagStats *tag = _alloc_tag_stats();
+        _alloc_check( bytes, tag );
+        g_alloc_total.add( bytes, false );
+        g_alloc_call.add( bytes, true );
+        tag->stats.add( bytes, false );
+        _alloc_site( bytes, tag );
+    }
+
+    void alloc_transient( index_t bytes )
+    {
+        _AllocTagStats *tag = _alloc_tag_stats();
+        _alloc_check( bytes, tag );
+        g_alloc_total.add( bytes, false, bytes );
+        g_alloc_call.add( bytes, false, bytes );
+        tag->stats.add( bytes, false, bytes );
+    }
+
+    void set_alloc_budget( index_t bytes ) { g_alloc_budget = bytes; }
+    index_t alloc_budget() { return g_alloc_budget; }
+
+    void alloc_begin_call() { g_alloc_call.reset(); }
+    void alloc_end_call() { g_alloc_last.store( g_alloc_call.load() ); }
+
+    AllocStats alloc_total()     { return g_alloc_total.load(); }
+    AllocStats alloc_call()      { return g_alloc_call.load(); }
+    AllocStats alloc_last_call() { return g_alloc_last.load(); }
+
+    void alloc_reset()
+    {
+        g_alloc_total.reset();
+        g_alloc_call.reset();
+        g_alloc_last.reset();
+
+        // tags are kept (live allocations point to them), but no longer reported
+        std::lock_guard<std::mutex> lock(g_alloc_mutex);
+        for ( auto& t: g_alloc_tags ) t.second->stats.reset();
+        g_alloc_sites.clear();
+    }
+
+    static mxArray* _make_alloc_stats( const AllocStats& s, mxArray *ms=nullptr, index_t k=0 )
+    {
+        if ( !ms ) ms = make_struct({ "count", "bytes", "current", "peak" });
+        mxSetField( ms, k, "count", make_scalar(s.count) );
+        mxSetField( ms, k, "bytes", make_scalar(s.bytes) );
+        mxSetField( ms, k, "current", make_scalar(s.current) );
+        mxSetField( ms, k, "peak", make_scalar(s.peak) );
+        return ms;
+    }
+
+    mxArray* make_alloc_info()
+    {
+        // copy the state first: creating the struct is accounted
+        const AllocStats total = alloc_total(), call = alloc_call(), last = alloc_last_call();
+        const index_t budget = alloc_budget();
+        std::vector< std::pair<std::string,AllocStats> > tags;
+        std::vector<_AllocSite> sites;
+        {
+            std::lock_guard<std::mutex> lock(g_alloc_mutex);
+            for ( auto& t: g_alloc_tags )
+                if ( t.second->stats.count.load() > 0 )
+                    tags.emplace_back( t.first, t.second->stats.load() );
+            sites.assign( g_alloc_sites.begin(), g_alloc_sites.end() );
+        }
+
+        mxArray *ms = make_struct({ "total", "call", "last", "budget", "tags", "sites" });
+        set_field( ms, "total", _make_alloc_stats(total) );
+        set_field( ms, "call", _make_alloc_stats(call) );
+        set_field( ms, "last", _make_alloc_stats(last) );
+        set_field( ms, "budget", make_scalar(budget) );
+
+        mxArray *t = make_struct( { "name", "count", "bytes", "current", "peak" }, tags.size(), 1 );
+        for ( index_t k = 0; k < tags.size(); ++k ) {
+            mxSetField( t, k, "name", make_string(tags[k].first) );
+            _make_alloc_stats( tags[k].second, t, k );
+        }
+        set_field( ms, "tags", t );
+
+        mxArray *s = make_struct( { "bytes", "tag", "stack" }, sites.size(), 1 );
+        for ( index_t k = 0; k < sites.size(); ++k ) {
+            mxSetField( s, k, "bytes", make_scalar(sites[k].bytes) );
+            mxSetField( s, k, "tag", make_string(sites[k].tag) );
+            mxSetField( s, k, "stack", make_string(sites[k].stack) );
+        }
+        set_field( ms, "sites", s );
+        return ms;
+    }
+    
+    // ----------  =====  ----------
+    
+    template <class T>
+    T& Runtime::_service( std::atomic<T*>& ptr )
+    {
+        T *p = ptr.load( std::memory_order_acquire );
+        if ( !p ) 
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            p = ptr.load( std::memory_order_relaxed );
+            if ( !p ) {
+                p = new T();
+                ptr.store( p, std::memory_order_release );
+                ++m_counters.inits;
+            }
+        }
+        return *p;
+    }
+
+    ThreadPool& Runtime::pool()
+    {
+        ThreadPool& p = _service(m_pool);
+
+        // the calling thread also takes part in parallel loops
+        if ( !p.running() ) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if ( !p.running() ) p.start( default_nthreads()-1 );
+        }
+        return p;
+    }
+
+    Arena& Runtime::arena() { return _service(m_arena); }
+    Cache& Runtime::cache() { return _service(m_cache); }
+    Registry& Runtime::registry() { return _service(m_registry); }
+
+    void Runtime::release_objects( const void *owner )
+    {
+        Registry *r = m_registry.load( std::memory_order_acquire );
+        if ( r ) r->release(owner);
+    }
+
+    void Runtime::attach()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_clients;
+    }
+
+    void Runtime::detach()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if ( m_clients > 0 ) --m_clients;
+            if ( m_clients > 0 ) return;
+        }
+        teardown();
+    }
+
+    void Runtime::teardown()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // stop the workers before releasing the resources they might use
+        delete m_pool.exchange(nullptr);
+        delete m_registry.exchange(nullptr);
+        delete m_cache.exchange(nullptr);
+        delete m_arena.exchange(nullptr);
+        m_counters.reset();
+    }
+
+    Runtime& runtime()
+    {
+        static Runtime r;
+        return r;
+    }
+
+}
+
+// ------------------------------------------------------------------------
+
+int jmx_abi_version()
+{
+    return JMX_ABI_VERSION;
 }
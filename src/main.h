@@ -19,6 +19,9 @@
 
 // common stuff
 #include "common.h"
+#include "trace.h"
+#include "profile.h"
+#include "accounting.h"
 
 #include "redirect.h"
 #include "makers.h"
@@ -26,17 +29,46 @@
 
 // sequence containers
 #include "sequence.h"
+#include "sparse.h"
+#include "builder.h"
 
 // forward declarations of Struct and Cell
 // Allows Abstract mapping to implement creator/extractor interfaces.
-namespace jmx { class Struct; class Cell; }
+namespace jmx { class Struct; class Cell; template <class T> class SparseBuilder; class BitVector; class BitVolume; template <class T> class RaggedArray_ro; class CellStr; class Callback; }
 #include "getters.h"
 #include "creator.h"
 #include "extractor.h"
 
+// persistent runtime, shared by all Mex files
+#include "runtime.h"
+#include "memo.h"
+
 // definition of Struct, and forward definitions
 #include "mapping.h"
 #include "forward.h"
 #include "args.h"
+#include "handles.h"
+
+// error propagation, parallel loops, background jobs, callbacks, and command bundles
+#include "error.h"
+#include "parallel.h"
+#include "jobs.h"
+#include "callback.h"
+#include "router.h"
+
+// data conversions
+#include "complex.h"
+#include "linalg.h"
+#include "triplets.h"
+#include "bits.h"
+#include "gather.h"
+#include "ragged.h"
+#include "strings.h"
+
+// binary snapshots, shared memory, mapped files and streaming
+#include "snapshot.h"
+#include "shared.h"
+#include "mmap.h"
+#include "stream.h"
 
 #endif
\ No newline at end of file
@@ -26,32 +26,54 @@ namespace jmx {
         return mxCreateString( val.c_str() );
     }
 
-    inline mxArray* make_matrix( index_t nr, index_t nc, mxClassID classid=mxDOUBLE_CLASS ) {
-        return mxCreateNumericMatrix( nr, nc, classid, mxREAL );
+    inline mxArray* make_matrix( index_t nr, index_t nc, mxClassID classid=mxDOUBLE_CLASS, mxComplexity cplx=mxREAL ) {
+        const index_t bytes = nr*nc*class_size(classid)*(cplx == mxCOMPLEX ? 2 : 1);
+        JMX_PROFILE_SCOPE( "make_matrix", bytes );
+        alloc_output( bytes );
+        return mxCreateNumericMatrix( nr, nc, classid, cplx );
     }
 
-    inline mxArray* make_vector( index_t len, bool column=false, mxClassID classid=mxDOUBLE_CLASS )
+    inline mxArray* make_vector( index_t len, bool column=false, mxClassID classid=mxDOUBLE_CLASS, mxComplexity cplx=mxREAL )
     {
         if (column)
-            return make_matrix( len, 1, classid );
+            return make_matrix( len, 1, classid, cplx );
         else
-            return make_matrix( 1, len, classid );
+            return make_matrix( 1, len, classid, cplx );
     }
 
-    inline mxArray* make_volume( index_t nr, index_t nc, index_t ns, mxClassID classid=mxDOUBLE_CLASS ) {
+    inline mxArray* make_volume( index_t nr, index_t nc, index_t ns, mxClassID classid=mxDOUBLE_CLASS, mxComplexity cplx=mxREAL ) {
+        const index_t bytes = nr*nc*ns*class_size(classid)*(cplx == mxCOMPLEX ? 2 : 1);
+        JMX_PROFILE_SCOPE( "make_volume", bytes );
+        alloc_output( bytes );
         index_t size[3] = {nr,nc,ns};
-        return mxCreateNumericArray( 3, size, classid, mxREAL );
+        return mxCreateNumericArray( 3, size, classid, cplx );
+    }
+
+    // only double (real or complex) and logical sparse matrices are supported by Matlab
+    inline mxArray* make_sparse( index_t nr, index_t nc, index_t nzmax, mxClassID classid=mxDOUBLE_CLASS, mxComplexity cplx=mxREAL ) 
+    {
+        JMX_ASSERT( classid == mxDOUBLE_CLASS || (classid == mxLOGICAL_CLASS && cplx == mxREAL), 
+            "Sparse matrices should be double or logical." );
+        JMX_PROFILE_SCOPE( "make_sparse" );
+        alloc_output( nzmax*(class_size(classid)*(cplx == mxCOMPLEX ? 2 : 1) + sizeof(mwIndex)) + (nc+1)*sizeof(mwIndex) );
+        if ( classid == mxLOGICAL_CLASS )
+            return mxCreateSparseLogicalMatrix( nr, nc, nzmax );
+        else
+            return mxCreateSparse( nr, nc, nzmax, cplx );
     }
 
     inline mxArray* make_cell( index_t nc ) {
+        JMX_PROFILE_SCOPE( "make_cell" );
         return mxCreateCellMatrix( 1, nc );
     }
 
     inline mxArray* make_struct( const char *fields[], index_t nfields, index_t nrows=1, index_t ncols=1 ) { 
+        JMX_PROFILE_SCOPE( "make_struct" );
         return mxCreateStructMatrix( nrows, ncols, nfields, (const char**) fields ); 
     }
 
     inline mxArray* make_struct( inilst<const char*> fields, index_t nrows=1, index_t ncols=1 ) {
+        JMX_PROFILE_SCOPE( "make_struct" );
         return mxCreateStructMatrix( nrows, ncols, fields.size(), const_cast<const char**>(fields.begin()) );
     }
 
@@ -0,0 +1,135 @@
+#ifndef JMX_MEMO_H_INCLUDED
+#define JMX_MEMO_H_INCLUDED
+
+//==================================================
+// @title        memo.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Content hashes of mxArrays, and memoization of gateway calls.
+ *
+ * hash_bytes processes 32 bytes per step with four 64-bit lanes (multiply-accumulate on
+ * 32-bit halves, with SSE2 when available); large buffers are split into blocks hashed
+ * in parallel. hash_array combines the class, size and contents of an mxArray tree
+ * (numeric, logical, char, sparse, struct and cell); other classes (e.g. objects or
+ * function handles) cannot be hashed.
+ *
+ * Memoization is opt-in, with Arguments::memoize (see args.h):
+ *
+ *      if ( args.memoize() ) return; // outputs copied from the cache
+ *      ... compute and assign outputs as usual ...
+ *
+ * On a miss, the outputs are copied into the cache (as persistent arrays) when the
+ * Arguments are destroyed, unless an exception is being thrown. The least recently used
+ * entries are evicted beyond the memory budget, and the entries of a Mex file are released
+ * when it is cleared. Keys include the Mex file, the command (in a bundle), the number of
+ * outputs and the hash of each input.
+ */
+namespace jmx {
+
+    // blocks hashed in parallel
+    #ifndef JMX_HASH_BLOCK
+    #define JMX_HASH_BLOCK (1 << 20)
+    #endif
+
+    // default memory budget of the memoization cache
+    #ifndef JMX_MEMO_BUDGET
+    #define JMX_MEMO_BUDGET (index_t(1) << 30)
+    #endif
+
+    uint64_t hash_bytes( const void *data, index_t n, uint64_t seed=0 );
+    uint64_t hash_array( const mxArray *ms, uint64_t seed=0 );
+
+    // combine two hashes
+    inline uint64_t hash_combine( uint64_t h, uint64_t v ) {
+        h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+        return h;
+    }
+
+    // memory used by the data of an mxArray tree
+    index_t array_bytes( const mxArray *ms );
+
+    // ------------------------------------------------------------------------
+
+    class Memo
+    {
+    public:
+
+        struct Stats
+        {
+            uint64_t hits, misses, stores, evictions;
+        };
+
+        Memo()
+            : m_budget(JMX_MEMO_BUDGET), m_bytes(0), m_stats{0,0,0,0} {}
+        ~Memo()
+            { clear(); }
+
+        // copy the cached outputs into out, if any
+        bool lookup( uint64_t key, index_t nout, mxArray *out[] );
+
+        // copy outputs into the cache
+        void store( uint64_t key, const void *owner, index_t nout, mxArray *const out[] );
+
+        // drop the entries stored by a Mex file, or all entries
+        index_t release( const void *owner );
+        void clear();
+        void set_budget( index_t bytes );
+
+        inline index_t budget() const { return m_budget; }
+        inline index_t bytes() const { return m_bytes; }
+        inline index_t size() const { return m_map.size(); }
+        inline const Stats& stats() const { return m_stats; }
+
+    private:
+
+        struct Entry
+        {
+            uint64_t key;
+            const void *owner;
+            index_t bytes;
+            std::vector<mxArray*> out;
+        };
+
+        void _evict( index_t bytes );
+        void _destroy( std::list<Entry>::iterator it );
+
+        index_t m_budget, m_bytes;
+        Stats m_stats;
+
+        // most recently used first
+        std::list<Entry> m_lru;
+        std::unordered_map< uint64_t, std::list<Entry>::iterator > m_map;
+    };
+
+    // cache of the runtime (must only be used on the Matlab thread)
+    inline Memo& memo() {
+        return *runtime().cache().get_or_create<Memo>("jmx:memo");
+    }
+
+    // cached outputs are persistent arrays of the Mex file, released when it is cleared
+    JMX_LOCAL inline void _session_memo_exit() {
+        if ( auto m = runtime().cache().get<Memo>("jmx:memo") ) m->release( _session_id() );
+    }
+
+    JMX_LOCAL inline Memo& session_memo()
+    {
+        static bool registered = false;
+        if ( !registered ) { on_exit( &_session_memo_exit ); registered = true; }
+        return memo();
+    }
+
+    // struct with fields entries, bytes, budget, hits, misses, stores and evictions
+    mxArray* make_memo_info();
+
+}
+
+#endif
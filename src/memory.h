@@ -8,8 +8,10 @@
 //==================================================
 
 #include "common.h"
+#include "accounting.h"
 
 #include<type_traits>
+#include <algorithm>
 
 // ------------------------------------------------------------------------
 
@@ -62,14 +64,31 @@ namespace jmx {
     {
         using value_type = T;
 
+        _AllocTagStats *tag = nullptr; // charged with the allocation
+
         void alloc( index_t n )
         {
+            tag = alloc_acquire( n*sizeof(T) );
             this->data = static_cast<T*>( mxCalloc( n, sizeof(T) ) ); 
             this->size = n;
         }
 
         void free()
-            { mxFree(this->data); this->clear(); }
+            { mxFree(this->data); alloc_release( tag, this->size*sizeof(T) ); this->clear(); }
+
+        // resize keeping the contents (new elements are not initialised)
+        void realloc( index_t n )
+        {
+            _AllocTagStats *t = alloc_acquire( n*sizeof(T) );
+            this->data = static_cast<T*>( mxRealloc( this->data, n*sizeof(T) ) );
+            alloc_release( tag, this->size*sizeof(T) );
+            tag = t;
+            this->size = n;
+        }
+
+        // the data was given to an output array, which owns it
+        void handover()
+            { alloc_release( tag, this->size*sizeof(T), true ); this->clear(); }
 
         inline T& operator[] ( index_t k ) const { return this->data[k]; }
     };
@@ -81,18 +100,50 @@ namespace jmx {
     {
         using value_type = T;
 
+        _AllocTagStats *tag = nullptr;
+
         void alloc( index_t n )
         {
-            this->data = new T[n](); 
+            _AllocTagStats *t = alloc_acquire( n*sizeof(T) );
+            try { this->data = new T[n](); }
+            catch (...) { alloc_release( t, n*sizeof(T) ); throw; }
             this->size = n;
+            tag = t;
         }
 
         void free()
-            { delete[] this->data; this->clear(); }
+            { delete[] this->data; alloc_release( tag, this->size*sizeof(T) ); this->clear(); }
+
+        void realloc( index_t n )
+        {
+            _AllocTagStats *t = alloc_acquire( n*sizeof(T) );
+            T *p;
+            try { p = new T[n](); }
+            catch (...) { alloc_release( t, n*sizeof(T) ); throw; }
+
+            std::copy( this->data, this->data + std::min(n,this->size), p );
+            delete[] this->data;
+            alloc_release( tag, this->size*sizeof(T) );
+            this->data = p;
+            this->size = n;
+            tag = t;
+        }
 
         inline T& operator[] ( index_t k ) const { return this->data[k]; }
     };
 
+    // ------------------------------------------------------------------------
+
+    // same memory policy, with a different element type
+    template <class M, class U>
+    struct rebind_memory;
+
+    template <template <class> class P, class T, class U>
+    struct rebind_memory< P<T>, U >
+    {
+        using type = P<U>;
+    };
+
 }
 
 #endif
@@ -0,0 +1,197 @@
+#ifndef JMX_MMAP_H_INCLUDED
+#define JMX_MMAP_H_INCLUDED
+
+//==================================================
+// @title        mmap.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <memory>
+#include <string>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Containers backed by raw binary files (column-major, native endianness) through mmap,
+ * for datasets larger than memory. Pages are loaded on access, and evicted by the OS.
+ *
+ *      auto X = map_volume_ro<float>( "stack.bin", nr, nc, ns );   // read-only
+ *      X.mem.advise( MappedFile::Sequential );
+ *
+ *      auto Y = map_matrix<double>( "out.bin", nr, nc );           // read-write, file resized
+ *      ... fill Y ...
+ *      Y.mem.sync();
+ *
+ * With CopyOnWrite, modifications are private to the process, and never written to file.
+ * Kernels written against the container API run unchanged on mapped containers.
+ */
+namespace jmx {
+
+    class MappedFile
+    {
+    public:
+
+        enum Mode { ReadOnly, ReadWrite, CopyOnWrite };
+        enum Advice { Normal, Sequential, Random, WillNeed, DontNeed };
+
+        /**
+         * Map bytes from offset (any offset, not necessarily page-aligned).
+         * If bytes is 0, the rest of the file is mapped. In ReadWrite mode, the file is
+         * created or extended if needed.
+         */
+        static std::shared_ptr<MappedFile> open( const std::string& path, Mode mode, index_t bytes=0, index_t offset=0 );
+
+        ~MappedFile();
+
+        MappedFile( const MappedFile& ) = delete;
+        MappedFile& operator= ( const MappedFile& ) = delete;
+
+        inline const std::string& path() const { return m_path; }
+        inline Mode mode() const { return m_mode; }
+        inline void* data() const { return m_base + m_delta; }
+        inline index_t bytes() const { return m_bytes; }
+
+        // hints for a range of bytes (the whole mapping if len is 0)
+        void advise( Advice a, index_t first=0, index_t len=0 ) const;
+
+        // write modified pages to file (ReadWrite only)
+        void sync( bool wait=true, index_t first=0, index_t len=0 ) const;
+
+    private:
+
+        MappedFile( const std::string& path, Mode mode, uint8_t *base, index_t delta, index_t bytes )
+            : m_path(path), m_mode(mode), m_base(base), m_delta(delta), m_bytes(bytes) {}
+
+        // page-aligned range
+        void _range( index_t first, index_t len, uint8_t*& ptr, index_t& n ) const;
+
+        std::string m_path;
+        Mode m_mode;
+        uint8_t *m_base;
+        index_t m_delta, m_bytes;
+    };
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * Memory policies backed by mapped files; copies of a container share the mapping,
+     * which is released with the last copy (or explicitly with free). Ranges for hints
+     * and sync are in elements.
+     */
+    template <class T>
+    struct MmapMemory : public AbstractMemory<T>
+    {
+        using value_type = T;
+        std::shared_ptr<MappedFile> file;
+
+        void alloc( index_t n )
+            { JMX_THROW( "Mapped memory cannot be allocated; use map_vector/matrix/volume instead." ); }
+
+        void free()
+            { file.reset(); this->clear(); }
+
+        inline void advise( MappedFile::Advice a, index_t first=0, index_t n=0 ) const
+            { file->advise( a, first*sizeof(T), n*sizeof(T) ); }
+        inline void sync( bool wait=true ) const
+            { file->sync(wait); }
+
+        inline T& operator[] ( index_t k ) const { return this->data[k]; }
+    };
+
+    template <class T>
+    struct MmapReadOnlyMemory : public AbstractMemory<T>
+    {
+        using value_type = typename std::add_const<T>::type;
+        std::shared_ptr<MappedFile> file;
+
+        void alloc( index_t n )
+            { JMX_THROW( "Read-only memory cannot be allocated." ); }
+
+        void free()
+            { file.reset(); this->clear(); }
+
+        inline void advise( MappedFile::Advice a, index_t first=0, index_t n=0 ) const
+            { file->advise( a, first*sizeof(T), n*sizeof(T) ); }
+
+        inline value_type& operator[] ( index_t k ) const { return this->data[k]; }
+    };
+
+    template <class T> using Vector_mm = Vector<T, MmapMemory<T> >;
+    template <class T> using Matrix_mm = Matrix<T, MmapMemory<T> >;
+    template <class T> using Volume_mm = Volume<T, MmapMemory<T> >;
+
+    template <class T> using Vector_mmro = Vector<T, MmapReadOnlyMemory<T> >;
+    template <class T> using Matrix_mmro = Matrix<T, MmapReadOnlyMemory<T> >;
+    template <class T> using Volume_mmro = Volume<T, MmapReadOnlyMemory<T> >;
+
+    // ----------  =====  ----------
+
+    template <class T, class M>
+    inline T* _map_file( M& mem, const std::string& path, MappedFile::Mode mode, index_t n, index_t offset )
+    {
+        mem.file = MappedFile::open( path, mode, n*sizeof(T), offset );
+        JMX_ASSERT( mem.file->bytes() >= n*sizeof(T), "File '%s' is too small.", path.c_str() );
+        return static_cast<T*>(mem.file->data());
+    }
+
+    // read-write or copy-on-write (offset in bytes)
+    template <class T>
+    Vector_mm<T> map_vector( const std::string& path, index_t n,
+        MappedFile::Mode mode=MappedFile::ReadWrite, index_t offset=0 )
+    {
+        JMX_REJECT( mode == MappedFile::ReadOnly, "Use map_vector_ro instead." );
+        Vector_mm<T> out;
+        out.assign( _map_file<T>( out.mem, path, mode, n, offset ), n );
+        return out;
+    }
+
+    template <class T>
+    Matrix_mm<T> map_matrix( const std::string& path, index_t nr, index_t nc,
+        MappedFile::Mode mode=MappedFile::ReadWrite, index_t offset=0 )
+    {
+        JMX_REJECT( mode == MappedFile::ReadOnly, "Use map_matrix_ro instead." );
+        Matrix_mm<T> out;
+        out.assign( _map_file<T>( out.mem, path, mode, nr*nc, offset ), nr, nc );
+        return out;
+    }
+
+    template <class T>
+    Volume_mm<T> map_volume( const std::string& path, index_t nr, index_t nc, index_t ns,
+        MappedFile::Mode mode=MappedFile::ReadWrite, index_t offset=0 )
+    {
+        JMX_REJECT( mode == MappedFile::ReadOnly, "Use map_volume_ro instead." );
+        Volume_mm<T> out;
+        out.assign( _map_file<T>( out.mem, path, mode, nr*nc*ns, offset ), nr, nc, ns );
+        return out;
+    }
+
+    // read-only (the length of a vector is deduced from the file size if n is 0)
+    template <class T>
+    Vector_mmro<T> map_vector_ro( const std::string& path, index_t n=0, index_t offset=0 )
+    {
+        Vector_mmro<T> out;
+        T *ptr = _map_file<T>( out.mem, path, MappedFile::ReadOnly, n, offset );
+        out.assign( ptr, n ? n : out.mem.file->bytes() / sizeof(T) );
+        return out;
+    }
+
+    template <class T>
+    Matrix_mmro<T> map_matrix_ro( const std::string& path, index_t nr, index_t nc, index_t offset=0 )
+    {
+        Matrix_mmro<T> out;
+        out.assign( _map_file<T>( out.mem, path, MappedFile::ReadOnly, nr*nc, offset ), nr, nc );
+        return out;
+    }
+
+    template <class T>
+    Volume_mmro<T> map_volume_ro( const std::string& path, index_t nr, index_t nc, index_t ns, index_t offset=0 )
+    {
+        Volume_mmro<T> out;
+        out.assign( _map_file<T>( out.mem, path, MappedFile::ReadOnly, nr*nc*ns, offset ), nr, nc, ns );
+        return out;
+    }
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef JMX_PARALLEL_H_INCLUDED
+#define JMX_PARALLEL_H_INCLUDED
+
+//==================================================
+// @title        parallel.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "runtime.h"
+#include "error.h"
+#include "progress.h"
+
+#include <atomic>
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+namespace jmx {
+
+    // state shared between the calling thread and the helpers of a parallel loop
+    struct _ForkJoin
+    {
+        std::atomic<index_t> next;
+        std::atomic<index_t> active;
+        std::mutex mutex;
+        std::condition_variable cv;
+        ErrorChannel errors;
+
+        _ForkJoin( index_t nhelpers )
+            : next(0), active(nhelpers) {}
+
+        inline void done() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if ( --active == 0 ) cv.notify_all();
+        }
+
+        inline void join() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait( lock, [this](){ return active == 0; } );
+        }
+    };
+
+    /**
+     * Split the range [first,last) into chunks of size grain, and process them with the
+     * workers of the runtime pool and the calling thread. The callback is called as:
+     *      fn( begin, end, tid )
+     * where tid is 0 for the calling thread, and between 1 and runtime().pool().size()
+     * for the workers. This can be used to index per-thread buffers.
+     *
+     * If grain is 0, the range is split into about 4 chunks per thread.
+     * Loops nested inside a worker run serially on that worker.
+     *
+     * If any thread throws, the remaining chunks are cancelled (see cancellation_requested),
+     * and the first error is rethrown on the calling thread once all helpers are done.
+     *
+     * With a Progress token on the calling thread (see progress.h), the calling thread polls
+     * for interruptions after each chunk; the remaining chunks are then cancelled, and the
+     * loop throws JMX:interrupted.
+     */
+    template <class F>
+    void parallel_chunks( index_t first, index_t last, F&& fn, index_t grain=0 )
+    {
+        if ( last <= first ) return;
+        JMX_PROFILE_SCOPE( "parallel_loop" );
+
+        const index_t n = last - first;
+        const index_t nt = is_worker_thread() ? 1 : runtime().nthreads();
+        if ( grain == 0 ) grain = std::max<index_t>( 1, n / (4*nt) );
+
+        const index_t nchunks = (n + grain - 1) / grain;
+        const index_t nhelpers = std::min( nt, nchunks ) - 1;
+        Progress *prog = _thread_progress();
+        if ( nhelpers == 0 && (!prog || is_worker_thread()) ) {
+            fn( first, last, 0 );
+            return;
+        }
+
+        Runtime& rt = runtime();
+        ++rt.counters().loops;
+        rt.counters().tasks += nhelpers;
+
+        _ForkJoin state(nhelpers);
+        const char *tag = _alloc_tag();
+        auto stopped = [&]() { return state.errors.cancelled() || (prog && prog->cancelled()); };
+        auto run = [&]( index_t tid ) {
+            JMX_TRACE_SCOPE( "parallel_run", "parallel" );
+            const ErrorChannel*& current = _thread_channel();
+            const ErrorChannel *outer = current;
+            current = &state.errors;
+
+            // workers share the progress token and allocation tag of the calling thread
+            AllocTag alloc_tag( tid > 0 ? tag : _alloc_tag() );
+            Progress *outer_prog = _thread_progress();
+            const std::atomic<bool> *outer_flag = _thread_cancel();
+            if ( tid > 0 && prog ) { 
+                _thread_progress() = prog; 
+                _thread_cancel() = prog->flag(); 
+            }
+
+            try {
+                for ( index_t c = state.next++; c < nchunks && !stopped(); c = state.next++ ) {
+                    const index_t b = first + c*grain, e = std::min(b+grain,last);
+                    {
+                        JMX_PROFILE_SCOPE( "parallel_chunk" );
+                        fn( b, e, tid );
+                    }
+                    if ( prog && prog->is_auto() ) prog->advance(e-b);
+
+                    // checkpoint: print messages from the workers, poll for interruptions
+                    if ( tid == 0 ) {
+                        console().drain();
+                        if ( prog ) prog->checkpoint();
+                    }
+                }
+            } catch (...) {
+                state.errors.capture();
+            }
+
+            current = outer;
+            _thread_progress() = outer_prog;
+            _thread_cancel() = outer_flag;
+            if ( tid > 0 ) console_flush();
+        };
+
+        ThreadPool& pool = rt.pool();
+        for ( index_t t = 1; t <= nhelpers; ++t )
+            pool.submit( [&run,&state,t]() { run(t); state.done(); } );
+
+        run(0);
+        state.join();
+        console_flush();
+        state.errors.rethrow();
+        if ( prog ) prog->check();
+    }
+
+    /**
+     * Call fn(i) for each index i in [first,last), in parallel.
+     */
+    template <class F>
+    void parallel_for( index_t first, index_t last, F&& fn, index_t grain=0 )
+    {
+        parallel_chunks( first, last, [&fn]( index_t b, index_t e, index_t ) {
+            for ( index_t i = b; i < e; ++i ) fn(i);
+        }, grain );
+    }
+
+}
+
+#endif
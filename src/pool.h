@@ -0,0 +1,69 @@
+#ifndef JMX_POOL_H_INCLUDED
+#define JMX_POOL_H_INCLUDED
+
+//==================================================
+// @title        pool.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// ------------------------------------------------------------------------
+
+namespace jmx {
+
+    /**
+     * Fixed-size pool of worker threads, consuming tasks from a shared queue.
+     *
+     * The workers are started on construction, and joined on destruction.
+     * The pool is meant to persist across Mex calls (see runtime.h), so that
+     * thread creation is only paid once per session.
+     */
+    class ThreadPool
+    {
+    public:
+
+        using task_t = std::function<void()>;
+
+        ThreadPool()
+            : m_stop(false) {}
+        ThreadPool( index_t nthreads )
+            : m_stop(false) { start(nthreads); }
+
+        ~ThreadPool()
+            { stop(); }
+
+        void start( index_t nthreads );
+        void stop();
+
+        void submit( task_t task );
+
+        inline index_t size() const { return m_workers.size(); }
+        inline bool running() const { return !m_workers.empty(); }
+
+    protected:
+
+        void work();
+
+        std::vector<std::thread> m_workers;
+        std::deque<task_t> m_queue;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop;
+    };
+
+    // default number of workers: hardware concurrency, or JMX_NUM_THREADS if set
+    index_t default_nthreads();
+
+    // true if called from one of the workers of a ThreadPool
+    bool is_worker_thread();
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef JMX_PROFILE_H_INCLUDED
+#define JMX_PROFILE_H_INCLUDED
+
+//==================================================
+// @title        profile.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Scoped profiler, enabled by compiling with -DJMX_PROFILE (otherwise the macros are empty):
+ *
+ *      JMX_PROFILE_SCOPE("kernel");                // until the end of the enclosing scope
+ *      JMX_PROFILE_SCOPE("copy", n*sizeof(T));     // with bytes touched
+ *      JMX_PROFILE_BYTES(n);                       // add bytes to the innermost scope
+ *
+ *      args.mkprofile(0);                          // struct of aggregated timings
+ *
+ * Names must be string literals (copied up to JMX_PROFILE_NAME characters). Each thread
+ * updates its own table of counters (without locks); tables are aggregated by name when
+ * reported. Getters, makers, Struct::wrap,
+ * MAT::open and parallel loops have built-in scopes. Scopes are also recorded by the
+ * tracer when it is started (see trace.h).
+ */
+
+#ifdef JMX_PROFILE
+    #define JMX_PROFILE_SCOPE( name, args... ) \
+        jmx::ProfileScope JMX_CONCAT(_jmx_profile_,__LINE__)( name, ##args )
+    #define JMX_PROFILE_BYTES( n ) jmx::ProfileScope::add_bytes(n)
+#else
+    #define JMX_PROFILE_SCOPE( name, args... )
+    #define JMX_PROFILE_BYTES( n )
+#endif
+
+#ifndef JMX_PROFILE_SLOTS
+#define JMX_PROFILE_SLOTS 256   // distinct names per thread
+#endif
+
+#ifndef JMX_PROFILE_NAME
+#define JMX_PROFILE_NAME 64     // characters kept of each name
+#endif
+
+namespace jmx {
+
+    /**
+     * Counters of one name in one thread (written by that thread only). The name is copied,
+     * because the literal belongs to the Mex file which opened the scope, and may be unloaded
+     * before the report (with the shared runtime); its address is only used for lookup.
+     */
+    struct _ProfileSlot
+    {
+        std::atomic<const char*> key;   // set after the name is copied
+        char name[JMX_PROFILE_NAME];
+        std::atomic<uint64_t> count, total, max, bytes; // times in ns
+
+        inline void add( std::atomic<uint64_t>& c, uint64_t n )
+            { c.store( c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed ); }
+    };
+
+    // slot of the calling thread for a name
+    _ProfileSlot* _profile_slot( const char *name );
+
+    class ProfileScope
+    {
+    public:
+
+        using clock_t = trace_clock;
+
+        ProfileScope( const char *name, index_t bytes=0 )
+            : m_slot(_profile_slot(name)), m_outer(_current())
+        {
+            _current() = this;
+            if ( bytes ) m_slot->add( m_slot->bytes, bytes );
+            m_start = clock_t::now();
+            m_trace = trace_enabled();
+        }
+
+        ~ProfileScope()
+        {
+            const clock_t::time_point stop = clock_t::now();
+            const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>( stop - m_start ).count();
+            m_slot->add( m_slot->count, 1 );
+            m_slot->add( m_slot->total, t );
+            if ( t > m_slot->max.load(std::memory_order_relaxed) )
+                m_slot->max.store( t, std::memory_order_relaxed );
+            _current() = m_outer;
+            if ( m_trace ) trace_event( name(), "scope", m_start, stop );
+        }
+
+        ProfileScope( const ProfileScope& ) = delete;
+        ProfileScope& operator= ( const ProfileScope& ) = delete;
+
+        inline const char* name() const { return m_slot->name; }
+
+        // bytes touched by the innermost scope of the calling thread
+        static inline void add_bytes( index_t n )
+            { if ( _current() ) _current()->m_slot->add( _current()->m_slot->bytes, n ); }
+
+    private:
+
+        static ProfileScope*& _current();
+
+        _ProfileSlot *m_slot;
+        ProfileScope *m_outer;
+        clock_t::time_point m_start;
+        bool m_trace;
+    };
+
+    // ----------  =====  ----------
+
+    struct ProfileEntry
+    {
+        std::string name;
+        index_t count, bytes;
+        double total, max;  // seconds
+    };
+
+    // aggregated over threads, sorted by decreasing total time
+    std::vector<ProfileEntry> profile_report();
+
+    // reset the counters of all threads
+    void profile_reset();
+
+}
+
+#endif
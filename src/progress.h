@@ -0,0 +1,107 @@
+#ifndef JMX_PROGRESS_H_INCLUDED
+#define JMX_PROGRESS_H_INCLUDED
+
+//==================================================
+// @title        progress.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// ------------------------------------------------------------------------
+
+#ifndef JMX_POLL_INTERVAL
+#define JMX_POLL_INTERVAL 100   // ms between checks for Ctrl+C
+#endif
+
+#ifndef JMX_PRINT_INTERVAL
+#define JMX_PRINT_INTERVAL 1000 // ms between progress messages
+#endif
+
+/**
+ * Progress and cancellation token, for long loops:
+ *
+ *      Progress p( n, "Processing" );          // label is optional; no messages without it
+ *      parallel_for( 0, n, [&]( index_t i ) {
+ *          ...
+ *          p.advance();                        // any thread, relaxed atomic increment
+ *      });
+ *
+ * While a Progress exists on the Matlab thread, parallel loops started from that thread
+ * call checkpoint() after each chunk: at most every JMX_POLL_INTERVAL ms, it checks for
+ * Ctrl+C (utIsInterruptPending is costly in tight loops), and at most every
+ * JMX_PRINT_INTERVAL ms, it prints the count, rate (items/s) and ETA.
+ *
+ * On interruption (or cancel()), the workers stop taking new chunks, cancellation_requested()
+ * becomes true in all threads of the loop, and the loop throws JMX:interrupted.
+ * Serial code on the Matlab thread can call checkpoint() directly.
+ */
+namespace jmx {
+
+    class Progress
+    {
+    public:
+
+        Progress( index_t total=0, const std::string& label="" );
+        ~Progress();
+
+        Progress( const Progress& ) = delete;
+        Progress& operator= ( const Progress& ) = delete;
+
+        // any thread
+        inline void advance( index_t n=1 ) { m_count.fetch_add( n, std::memory_order_relaxed ); }
+        inline bool cancelled() const { return m_cancel.load( std::memory_order_relaxed ); }
+        inline void cancel() { m_cancel.store( true, std::memory_order_relaxed ); }
+
+        inline index_t count() const { return m_count.load( std::memory_order_relaxed ); }
+        inline index_t total() const { return m_total; }
+        inline void set_total( index_t n ) { m_total = n; }
+
+        // parallel loops advance the counter by the size of each chunk
+        inline void set_auto( bool a ) { m_auto = a; }
+        inline bool is_auto() const { return m_auto; }
+
+        // intervals in ms (0 to poll/print at every checkpoint)
+        inline void set_intervals( index_t poll, index_t print ) { m_poll = poll; m_print = print; }
+
+        /**
+         * Matlab thread only: poll for interruptions, and print progress (rate-limited).
+         * Returns false if cancelled.
+         */
+        bool checkpoint();
+
+        // throw JMX:interrupted if cancelled
+        void check();
+
+        // flag shared with the threads of parallel loops (see cancellation_requested)
+        inline const std::atomic<bool>* flag() const { return &m_cancel; }
+
+    private:
+
+        using clock_t = std::chrono::steady_clock;
+
+        void _print( bool last );
+
+        std::atomic<index_t> m_count;
+        std::atomic<bool> m_cancel;
+        index_t m_total, m_poll, m_print;
+        bool m_auto;
+        std::string m_label;
+
+        clock_t::time_point m_start, m_last_poll, m_last_print;
+        bool m_printed;
+
+        // restored on destruction
+        Progress *m_outer;
+        const std::atomic<bool> *m_outer_flag;
+    };
+
+    // token of the Matlab thread, or of the loop running on a worker
+    Progress*& _thread_progress();
+
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef JMX_RAGGED_H_INCLUDED
+#define JMX_RAGGED_H_INCLUDED
+
+//==================================================
+// @title        ragged.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <vector>
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Cells of numeric arrays with variable lengths (e.g. lists of neighbours, or tracts).
+ *
+ * RaggedArray_ro validates all the elements of a cell once (on the Matlab thread), and
+ * builds a table of data pointers and offsets, such that element k has length
+ * offset(k+1)-offset(k). Elements can then be accessed by workers directly, without
+ * calling the Matlab API. Empty elements (e.g. []) are allowed with any type.
+ *
+ * Conversely, mkragged creates a cell of vectors from a packed buffer and offsets; all
+ * elements are allocated first, and the data is then copied in parallel.
+ */
+namespace jmx {
+
+    template <class T>
+    class RaggedArray_ro
+    {
+    public:
+
+        using value_type = const T;
+
+        RaggedArray_ro()
+            { clear(); }
+        RaggedArray_ro( const mxArray *ms )
+            { wrap(ms); }
+
+        void clear();
+        void wrap( const mxArray *ms );
+
+        inline index_t size() const { return m_ptr.size(); }
+        inline bool empty() const { return m_ptr.empty(); }
+
+        // total number of elements in all arrays
+        inline index_t total() const { return m_off.back(); }
+
+        inline index_t offset( index_t k ) const { return m_off[k]; }
+        inline const std::vector<index_t>& offsets() const { return m_off; }
+
+        inline index_t length( index_t k ) const { return m_off[k+1] - m_off[k]; }
+        inline const T* data( index_t k ) const { return m_ptr[k]; }
+
+        inline Vector_ro<T> operator[] ( index_t k ) const
+            { return Vector_ro<T>( const_cast<T*>(m_ptr[k]), length(k) ); }
+
+        // true if all elements are matrices of the same size
+        inline bool uniform() const { return m_uniform; }
+
+        // call fn(k, vec, tid) for each element in parallel
+        template <class F>
+        void parallel_for_each( F&& fn, index_t grain=0 ) const
+        {
+            parallel_chunks( 0, size(), [&]( index_t b, index_t e, index_t tid ) {
+                for ( index_t k = b; k < e; ++k ) fn( k, (*this)[k], tid );
+            }, grain );
+        }
+
+        // copy a uniform cell of nr x nc matrices into a nr x nc x n volume
+        template <class M>
+        void pack( const Volume<T,M>& out ) const;
+
+    private:
+
+        std::vector<const T*> m_ptr;
+        std::vector<index_t> m_off;
+        index_t m_nr, m_nc;
+        bool m_uniform;
+    };
+
+    // ------------------------------------------------------------------------
+
+    template <class T>
+    void RaggedArray_ro<T>::clear()
+    {
+        m_ptr.clear();
+        m_off.assign( 1, 0 );
+        m_nr = m_nc = 0;
+        m_uniform = true;
+    }
+
+    template <class T>
+    void RaggedArray_ro<T>::wrap( const mxArray *ms )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( mxIsCell(ms), "Input is not a cell." );
+        clear();
+
+        const index_t n = mxGetNumberOfElements(ms);
+        m_ptr.resize(n);
+        m_off.resize(n+1);
+
+        for ( index_t k = 0; k < n; ++k )
+        {
+            const mxArray *e = mxGetCell(ms,k);
+            const index_t len = e ? mxGetNumberOfElements(e) : 0;
+
+            if ( len > 0 ) {
+                JMX_ASSERT( isCompatible<T>(e) && !mxIsSparse(e), "Bad type in cell element %zu.", k );
+                m_ptr[k] = data_ptr<T>(e);
+            }
+            else m_ptr[k] = nullptr;
+
+            m_off[k+1] = m_off[k] + len;
+
+            // check that the sizes are the same
+            const index_t nr = e ? mxGetM(e) : 0;
+            const index_t nc = e ? mxGetN(e) : 0;
+            if ( k == 0 ) { m_nr = nr; m_nc = nc; }
+            m_uniform = m_uniform && nr == m_nr && nc == m_nc && (!e || mxGetNumberOfDimensions(e) == 2);
+        }
+    }
+
+    template <class T>
+    template <class M>
+    void RaggedArray_ro<T>::pack( const Volume<T,M>& out ) const
+    {
+        JMX_ASSERT( m_uniform, "Cell elements should have the same size." );
+        JMX_ASSERT( out.nr == m_nr && out.nc == m_nc && out.ns == size(), "Size mismatch." );
+
+        const index_t len = m_nr * m_nc;
+        T *o = out.memptr();
+        parallel_for( 0, size(), [&]( index_t k ) {
+            std::copy( m_ptr[k], m_ptr[k] + len, o + k*len );
+        });
+    }
+
+    // ----------  =====  ----------
+
+    // forwarded from extractor.h
+    template <class K>
+    template <class T>
+    inline RaggedArray_ro<T> Extractor<K>::getragged( key_t k ) {
+        return RaggedArray_ro<T>(_extractor_get(k));
+    }
+
+    // forwarded from creator.h
+    template <class K>
+    template <class T>
+    mxArray* Creator<K>::mkragged( key_t k, const T *data, const std::vector<index_t>& offsets, bool col )
+    {
+        JMX_ASSERT( !offsets.empty() && offsets[0] == 0, "Bad offsets." );
+        const index_t n = offsets.size()-1;
+
+        // allocate on the calling thread
+        mxArray *out = make_cell(n);
+        std::vector<T*> dst(n);
+        for ( index_t i = 0; i < n; ++i ) {
+            JMX_ASSERT( offsets[i+1] >= offsets[i], "Offsets should be increasing." );
+            mxArray *e = make_vector( offsets[i+1]-offsets[i], col, cpp2mex<T>::classid, complexity<T>() );
+            dst[i] = data_ptr<T>(e);
+            mxSetCell( out, i, e );
+        }
+
+        // copy in parallel
+        parallel_for( 0, n, [&]( index_t i ) {
+            std::copy( data + offsets[i], data + offsets[i+1], dst[i] );
+        });
+
+        return _creator_assign(k, out);
+    }
+
+}
+
+#endif
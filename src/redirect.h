@@ -7,39 +7,135 @@
 // @contact      Jhadida87 [at] gmail
 //==================================================
 
+#include <atomic>
 #include <memory>
+#include <string>
+#include <thread>
 #include <iostream>
 #include <streambuf>
 
+#ifndef JMX_CONSOLE_BUFSIZE
+#define JMX_CONSOLE_BUFSIZE 4096
+#endif
+
 // ------------------------------------------------------------------------
 
 /**
- * These classes allow to redirect the standard output std::cout to the Matlab console.
- * They essentially replace the stream buffer of std::cout with a custom buffer.
+ * Output to the Matlab console is buffered, and thread-safe.
  *
- * To enable the redirection _temporarily_, you just need to instanciate an object of
- * type sa::coutRedirection at the beginning of the scope in your code.
+ * Only the Matlab thread can call mexPrintf. Text written by other threads (e.g. the
+ * workers of parallel loops) is pushed to a lock-free queue, which is drained by the
+ * Matlab thread at safe points: parallel loop checkpoints, and when Arguments go out of
+ * scope at the end of a Mex call. It can also be drained explicitly with console_flush().
  *
- * If you want to redirect _permanently_ (until the end of execution), you can call
- * sa::cout_redirect() at the beginning of your main. Note that there is no way to 
- * restore the standard output after that.
+ * Each thread accumulates text in its own line buffer, which is written to the console
+ * on newline, when it exceeds JMX_CONSOLE_BUFSIZE, or explicitly (e.g. std::flush).
  */
 namespace jmx {
 
+    /**
+     * Multiple-producer, single-consumer queue of messages.
+     * Push is lock-free (one atomic exchange); see Dmitry Vyukov's intrusive MPSC queue.
+     */
+    class MessageQueue
+    {
+    public:
+
+        MessageQueue()
+            : m_head(&m_stub), m_tail(&m_stub) { m_stub.next = nullptr; }
+        ~MessageQueue()
+            { std::string msg; while ( pop(msg) ) {} }
+
+        // any thread
+        void push( std::string&& msg );
+
+        // consumer only; returns false if the queue is empty
+        bool pop( std::string& msg );
+
+        inline bool empty() const
+            { return m_tail == &m_stub && !m_stub.next.load(std::memory_order_acquire); }
+
+    private:
+
+        struct Node
+        {
+            std::atomic<Node*> next;
+            std::string msg;
+        };
+
+        void _push( Node *node );
+
+        std::atomic<Node*> m_head;
+        Node *m_tail;
+        Node m_stub;
+    };
+
+    // ----------  =====  ----------
+
+    class Console
+    {
+    public:
+
+        // the owner is the Matlab thread (set when constructing Arguments)
+        inline void claim()
+            { m_owner = std::this_thread::get_id(); }
+
+        bool is_owner() const;
+
+        // write text now if called by the owner, otherwise queue it
+        void write( const char *str, index_t len );
+
+        // owner only: print queued messages
+        void drain();
+
+    private:
+
+        std::atomic<std::thread::id> m_owner;
+        MessageQueue m_queue;
+    };
+
+    Console& console();
+
+    // buffered text of the calling thread
+    void console_write( const char *str, index_t len );
+
+    // flush the buffer of the calling thread, and drain the queue if owner
+    void console_flush();
+
+    // ------------------------------------------------------------------------
+
     class mexPrintf_ostream
         : public std::streambuf
     {
     protected:
 
         virtual inline std::streamsize xsputn( const char* s, std::streamsize n )
-            { mexPrintf("%.*s", n, s); return n; }
+            { console_write( s, n ); return n; }
+
+        virtual inline int overflow( int c = EOF ) {
+            if ( c == EOF ) return 0;
+            const char ch = static_cast<char>(c);
+            console_write( &ch, 1 );
+            return c;
+        }
 
-        virtual inline int overflow( int c = EOF )
-            { if (c != EOF) mexPrintf("%.1s", &c); return 1; }
+        virtual inline int sync()
+            { console_flush(); return 0; }
     };
 
     // ------------------------------------------------------------------------
 
+    /**
+     * These classes allow to redirect the standard output std::cout to the Matlab console.
+     * They essentially replace the stream buffer of std::cout with a custom buffer.
+     *
+     * To enable the redirection _temporarily_, you just need to instanciate an object of
+     * type coutRedirection at the beginning of the scope in your code.
+     *
+     * If you want to redirect _permanently_ (until the end of execution), you can call
+     * cout_redirect() at the beginning of your main. Note that there is no way to
+     * restore the standard output after that.
+     */
     template <class B = mexPrintf_ostream>
     class coutRedirection
     {
@@ -60,7 +156,7 @@ namespace jmx {
         inline void enable()
             { m_backup = std::cout.rdbuf( &m_buf ); }
         inline void disable()
-            { std::cout.rdbuf( m_backup ); }
+            { std::cout.flush(); std::cout.rdbuf( m_backup ); }
     };
 
     // ------------------------------------------------------------------------
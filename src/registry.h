@@ -0,0 +1,97 @@
+#ifndef JMX_REGISTRY_H_INCLUDED
+#define JMX_REGISTRY_H_INCLUDED
+
+//==================================================
+// @title        registry.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <typeindex>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Registry of C++ objects which persist between calls (e.g. search trees, factorisations),
+ * referred to in Matlab by uint64 handles.
+ *
+ * A handle contains the index of a slot (low 32 bits), and the generation of the object
+ * (high 32 bits), taken from a counter shared by all registries of the process, so that it
+ * changes whenever a slot is reused, even after the runtime is torn down. Stale handles (to
+ * objects already destroyed) and handles of the wrong type are therefore detected.
+ *
+ * Each object records the Mex file which created it (owner), so that its objects can be
+ * released when it is cleared (see handles.h).
+ */
+namespace jmx {
+
+    using handle_t = uint64_t;
+
+    class Registry
+    {
+    public:
+
+        struct Info
+        {
+            handle_t handle;
+            std::string type, label;
+            index_t bytes;
+        };
+
+        template <class T>
+        handle_t create( std::shared_ptr<T> obj, const void *owner, index_t bytes=sizeof(T), const std::string& label="" )
+        {
+            return _create( std::static_pointer_cast<void>(obj), std::type_index(typeid(T)), owner, bytes, label );
+        }
+
+        // the object of a handle, or an exception if it is stale or has a different type
+        template <class T>
+        std::shared_ptr<T> get( handle_t h ) const
+        {
+            return std::static_pointer_cast<T>( _get( h, std::type_index(typeid(T)) ) );
+        }
+
+        bool valid( handle_t h ) const;
+        bool destroy( handle_t h );
+
+        // update the memory usage of an object
+        void set_bytes( handle_t h, index_t bytes );
+
+        // destroy all objects of an owner, or all objects
+        index_t release( const void *owner );
+        void clear();
+
+        index_t size() const;
+        index_t size( const void *owner ) const;
+        index_t bytes() const;
+        std::vector<Info> info() const;
+
+    private:
+
+        struct Slot
+        {
+            std::shared_ptr<void> ptr;
+            std::type_index type = std::type_index(typeid(void));
+            const void *owner = nullptr;
+            uint32_t gen = 0;
+            index_t bytes = 0;
+            std::string label;
+        };
+
+        handle_t _create( std::shared_ptr<void> ptr, std::type_index type, const void *owner, index_t bytes, const std::string& label );
+        std::shared_ptr<void> _get( handle_t h, std::type_index type ) const;
+        Slot* _slot( handle_t h );
+        const Slot* _slot( handle_t h ) const;
+
+        mutable std::mutex m_mutex;
+        std::vector<Slot> m_slot;
+        std::vector<uint32_t> m_free;
+    };
+
+}
+
+#endif
@@ -0,0 +1,130 @@
+//==================================================
+// @title        J.H. Mex Library
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+/**
+ * Gateway of a bundle (see router.h).
+ *
+ * This file should be compiled with the sources of the commands, instead of defining a
+ * mexFunction manually. The registry of commands is defined here (and not in main.cpp),
+ * so that each bundle has its own commands, even when linked against a shared runtime.
+ */
+
+#include "main.h"
+
+#include <cstring>
+
+// ------------------------------------------------------------------------
+
+namespace jmx {
+
+    Router& router()
+    {
+        static Router r;
+        return r;
+    }
+
+    // ----------  =====  ----------
+
+    void Router::add( const char *name, uint64_t hash, command_t fn )
+    {
+        if ( !name || !fn ) { m_error += "Null command. "; return; }
+        for ( auto& c: m_cmd )
+            if ( std::strcmp(c.name,name) == 0 ) {
+                m_error += "Duplicate command '" + std::string(name) + "'. ";
+                return;
+            }
+
+        m_cmd.push_back(Command{ name, hash, fn });
+        m_built = false; // rebuilt on next dispatch
+    }
+
+    void Router::build()
+    {
+        const index_t n = m_cmd.size();
+        m_built = true;
+
+        // find the smallest table for which the hashes do not collide
+        for ( uint64_t len = 2; len <= (1 << 20); len *= 2 )
+        {
+            if ( len < 2*n ) continue;
+
+            m_mask = len-1;
+            m_table.assign( len, -1 );
+
+            bool perfect = true;
+            for ( index_t k = 0; perfect && k < n; ++k )
+            {
+                int32_t& slot = m_table[ m_cmd[k].hash & m_mask ];
+                perfect = slot < 0;
+                slot = static_cast<int32_t>(k);
+            }
+            if ( perfect ) return;
+        }
+
+        // hashes collide in the low bits: fall back to linear search
+        m_table.clear();
+    }
+
+    const Router::Command* Router::find( const char *name ) const
+    {
+        if ( !m_built ) return nullptr;
+
+        if ( m_table.empty() ) {
+            for ( auto& c: m_cmd )
+                if ( std::strcmp( c.name, name ) == 0 ) return &c;
+            return nullptr;
+        }
+
+        const int32_t k = m_table[ hash_name(name) & m_mask ];
+        if ( k >= 0 && std::strcmp( m_cmd[k].name, name ) == 0 )
+            return &m_cmd[k];
+        else
+            return nullptr;
+    }
+
+    void Router::dispatch( int nargout, mxArray *out[], int nargin, const mxArray *in[] )
+    {
+        JMX_ASSERT( m_error.empty(), "Invalid bundle: %s", m_error.c_str() );
+        if ( !m_built ) build();
+        if ( nargin == 0 ) { usage(); return; }
+
+        JMX_ASSERT( mxIsChar(in[0]), "First input should be a command name." );
+        const std::string name = get_string(in[0]);
+        const Command *cmd = find(name.c_str());
+        JMX_ASSERT( cmd, "Unknown command '%s'.", name.c_str() );
+
+        Arguments args( nargout, out, nargin-1, in+1 );
+        args.command = cmd->name;
+        JMX_ALLOC_TAG( cmd->name );
+        cmd->fn(args);
+    }
+
+    void Router::usage() const
+    {
+        println( "Available commands (%zu):", m_cmd.size() );
+        for ( auto& c: m_cmd )
+            println( "\t%s", c.name );
+    }
+
+}
+
+// ------------------------------------------------------------------------
+
+void mexFunction( int nargout, mxArray *out[],
+                  int nargin, const mxArray *in[] )
+{
+    // copy the message, so the exception is destroyed before returning control to Matlab
+    jmx::ErrorRecord err = {};
+
+    try {
+        jmx::router().dispatch( nargout, out, nargin, in );
+    }
+    catch (...) {
+        err.capture();
+    }
+
+    if ( !err.empty() ) jmx::raise(err);
+}
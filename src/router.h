@@ -0,0 +1,97 @@
+#ifndef JMX_ROUTER_H_INCLUDED
+#define JMX_ROUTER_H_INCLUDED
+
+//==================================================
+// @title        router.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+
+// ------------------------------------------------------------------------
+
+/**
+ * A bundle is a single Mex file which implements several commands. The first input
+ * of the Mex function should be the name of the command, and the remaining inputs are
+ * forwarded to that command:
+ *
+ *      JMX_COMMAND( norm ) {
+ *          auto x = args.getvec(0);
+ *          ...
+ *      }
+ *
+ * Called from Matlab as:
+ *
+ *      y = mybundle( 'norm', x );
+ *
+ * All commands in a bundle are loaded once, and share the same runtime (see runtime.h).
+ * The gateway function is implemented in router.cpp; see jmx.m to compile a bundle.
+ */
+namespace jmx {
+
+    using command_t = void (*)( Arguments& );
+
+    // FNV-1a hash of command names, evaluated at compile-time
+    constexpr uint64_t hash_name( const char *s, uint64_t h = 14695981039346656037ULL ) {
+        return *s ? hash_name( s+1, (h ^ static_cast<uint8_t>(*s)) * 1099511628211ULL ) : h;
+    }
+
+    class Router
+    {
+    public:
+
+        struct Command
+        {
+            const char *name;
+            uint64_t hash;
+            command_t fn;
+        };
+
+        Router()
+            : m_mask(0), m_built(false) {}
+
+        void add( const char *name, uint64_t hash, command_t fn );
+        const Command* find( const char *name ) const;
+        void dispatch( int nargout, mxArray *out[], int nargin, const mxArray *in[] );
+        void usage() const;
+
+        inline index_t size() const { return m_cmd.size(); }
+
+    private:
+
+        void build();
+
+        // table of indices into m_cmd, without collisions (perfect hash), or empty if none
+        // was found (linear search)
+        std::vector<Command> m_cmd;
+        std::vector<int32_t> m_table;
+        uint64_t m_mask;
+        bool m_built;
+
+        // errors of registration (at load-time, where throwing would terminate the process),
+        // reported by dispatch
+        std::string m_error;
+    };
+
+    Router& router();
+
+    // registration at load-time (see JMX_COMMAND)
+    struct _CommandRegistrar
+    {
+        _CommandRegistrar( const char *name, uint64_t hash, command_t fn )
+            { router().add( name, hash, fn ); }
+    };
+
+}
+
+#define JMX_COMMAND( name ) \
+    static void jmx_command_##name( jmx::Arguments& args ); \
+    static const jmx::_CommandRegistrar jmx_register_##name( #name, \
+        std::integral_constant< uint64_t, jmx::hash_name(#name) >::value, &jmx_command_##name ); \
+    static void jmx_command_##name( jmx::Arguments& args )
+
+#endif
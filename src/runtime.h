@@ -0,0 +1,241 @@
+#ifndef JMX_RUNTIME_H_INCLUDED
+#define JMX_RUNTIME_H_INCLUDED
+
+//==================================================
+// @title        runtime.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "pool.h"
+#include "arena.h"
+#include "registry.h"
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Version of the binary interface of the runtime library (libjmx.so.<version>).
+ * This should be incremented whenever the layout of the runtime classes changes,
+ * so that Mex files linked against an older library fail cleanly on first call.
+ */
+#ifndef JMX_ABI_VERSION
+#define JMX_ABI_VERSION 3
+#endif
+
+// symbols local to each shared object (i.e. one instance per Mex file)
+#ifdef __GNUC__
+    #define JMX_LOCAL __attribute__((visibility("hidden")))
+#else
+    #define JMX_LOCAL
+#endif
+
+extern "C" int jmx_abi_version();
+
+namespace jmx {
+
+    /**
+     * Thread-safe store of arbitrary C++ objects, indexed by name.
+     * Objects are held by shared pointer, so a value can safely be erased
+     * while another thread still uses it.
+     */
+    class Cache
+    {
+    public:
+
+        template <class T>
+        std::shared_ptr<T> get( const std::string& key ) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_map.find(key);
+            if ( it == m_map.end() )
+                return std::shared_ptr<T>();
+
+            JMX_ASSERT( it->second.type == std::type_index(typeid(T)),
+                "Cached value '%s' has a different type.", key.c_str() );
+            return std::static_pointer_cast<T>( it->second.ptr );
+        }
+
+        template <class T>
+        std::shared_ptr<T> set( const std::string& key, std::shared_ptr<T> val )
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_map[key] = Item{ val, std::type_index(typeid(T)) };
+            return val;
+        }
+
+        // value for key, created with the default constructor if it does not exist
+        template <class T>
+        std::shared_ptr<T> get_or_create( const std::string& key )
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Item& it = m_map.emplace( key, Item{ nullptr, std::type_index(typeid(T)) } ).first->second;
+            if ( !it.ptr ) {
+                it.ptr = std::make_shared<T>();
+                it.type = std::type_index(typeid(T));
+            }
+
+            JMX_ASSERT( it.type == std::type_index(typeid(T)),
+                "Cached value '%s' has a different type.", key.c_str() );
+            return std::static_pointer_cast<T>( it.ptr );
+        }
+
+        bool has( const std::string& key ) const;
+        bool erase( const std::string& key );
+        void clear();
+        index_t size() const;
+
+    private:
+
+        struct Item
+        {
+            std::shared_ptr<void> ptr;
+            std::type_index type;
+        };
+
+        mutable std::mutex m_mutex;
+        std::unordered_map< std::string, Item > m_map;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // instrumentation counters, updated by the runtime
+    struct Counters
+    {
+        std::atomic<uint64_t> calls;    // gateway calls
+        std::atomic<uint64_t> loops;    // parallel loops
+        std::atomic<uint64_t> tasks;    // tasks submitted to the pool
+        std::atomic<uint64_t> inits;    // service initialisations
+
+        Counters()
+            { reset(); }
+
+        inline void reset()
+            { calls = loops = tasks = inits = 0; }
+    };
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * Process-wide services, shared by all the Mex files linked against the runtime.
+     *
+     * When the runtime is compiled as a shared library (see jmx_build), a single instance
+     * exists per Matlab session. When it is linked statically (inc/jmx.o), each Mex file has
+     * its own instance, and all commands in a bundle (see router.h) share it.
+     *
+     * Each service is initialised on first access. Mex files attach to the runtime on their
+     * first call (see session below), and detach when they are cleared; the services are
+     * torn down when the last client detaches.
+     */
+    class Runtime
+    {
+    public:
+
+        Runtime()
+            : m_pool(nullptr), m_arena(nullptr), m_cache(nullptr), m_registry(nullptr), m_clients(0) {}
+        ~Runtime()
+            { teardown(); }
+
+        ThreadPool& pool();
+        Arena& arena();
+        Cache& cache();
+        Registry& registry();
+        inline Counters& counters() { return m_counters; }
+
+        // destroy the objects created by a Mex file (if any)
+        void release_objects( const void *owner );
+
+        // number of threads available to parallel loops (workers + calling thread)
+        inline index_t nthreads() { return pool().size() + 1; }
+
+        void attach();
+        void detach();
+        void teardown();
+
+        inline index_t nclients() const { return m_clients; }
+
+    private:
+
+        template <class T>
+        T& _service( std::atomic<T*>& ptr );
+
+        std::mutex m_mutex;
+        std::atomic<ThreadPool*> m_pool;
+        std::atomic<Arena*> m_arena;
+        std::atomic<Cache*> m_cache;
+        std::atomic<Registry*> m_registry;
+        Counters m_counters;
+        index_t m_clients;
+    };
+
+    Runtime& runtime();
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * The following functions have one instance per Mex file, even when the runtime is shared.
+     *
+     * session() attaches the calling Mex file to the runtime on first call, and registers
+     * a mexAtExit handler to detach it. It is called when constructing Arguments.
+     *
+     * Because Matlab only keeps one exit handler per Mex file, functions which need to run
+     * when the Mex file is cleared should be registered with on_exit, not mexAtExit.
+     */
+    using exit_t = void (*)();
+
+    JMX_LOCAL inline std::vector<exit_t>& _exit_handlers() {
+        static std::vector<exit_t> h;
+        return h;
+    }
+
+    JMX_LOCAL inline void on_exit( exit_t fn ) {
+        _exit_handlers().push_back(fn);
+    }
+
+    // address identifying the calling Mex file
+    JMX_LOCAL inline const void* _session_id() {
+        static const char id = 0;
+        return &id;
+    }
+
+    JMX_LOCAL inline bool& _session_attached() {
+        static bool attached = false;
+        return attached;
+    }
+
+    JMX_LOCAL inline void _session_exit() 
+    {
+        auto& h = _exit_handlers();
+        for ( auto it = h.rbegin(); it != h.rend(); ++it ) (*it)();
+        h.clear();
+
+        _session_attached() = false;
+        runtime().release_objects( _session_id() );
+        runtime().detach();
+    }
+
+    JMX_LOCAL inline Runtime& session()
+    {
+        bool& attached = _session_attached();
+        if ( !attached )
+        {
+            JMX_ASSERT( jmx_abi_version() == JMX_ABI_VERSION, 
+                "Runtime ABI mismatch (library %d, expected %d); please rebuild with jmx_build.", 
+                jmx_abi_version(), JMX_ABI_VERSION );
+
+            runtime().attach();
+            mexAtExit( &_session_exit );
+            attached = true;
+        }
+        return runtime();
+    }
+
+}
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef JMX_SHARED_H_INCLUDED
+#define JMX_SHARED_H_INCLUDED
+
+//==================================================
+// @title        shared.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Named POSIX shared memory segments (shm_open/mmap), to exchange arrays between Matlab
+ * processes (e.g. parfor workers on the same node) without copy.
+ *
+ * A segment starts with a header (class, size, and a reference count across processes),
+ * followed by the data on the next page, so that read-only attachments can protect it.
+ * Each process holding a SharedSegment counts as one reference; the name is unlinked when
+ * the last reference is released. Segments left by processes which crashed can be removed
+ * with SharedSegment::remove.
+ *
+ *      // publisher (the handle keeps the segment alive between calls, see handles.h)
+ *      args.mkhandle( 0, publish_shared( "mydata", args.getraw(0) ) );
+ *
+ *      // workers (read-only, no copy)
+ *      auto X = attach_matrix<double>( "mydata" );
+ *
+ * Containers with SharedMemory allocate anonymous segments (named /jmx.<pid>.<nonce>.<count>),
+ * which can be attached by other processes using their name.
+ */
+namespace jmx {
+
+    #ifndef JMX_SHARED_MAXDIMS
+    #define JMX_SHARED_MAXDIMS 8
+    #endif
+
+    class SharedSegment
+    {
+    public:
+
+        struct Header
+        {
+            std::atomic<uint64_t> magic, refs;
+            uint64_t bytes, offset; // offset of the data (page size of the creator)
+            int32_t cls;
+            uint32_t complex, ndims, _pad;
+            uint64_t dims[JMX_SHARED_MAXDIMS];
+        };
+
+        static_assert( sizeof(Header) <= 128, "Header too large." );
+
+        // create a new segment (fails if the name exists); complex data is interleaved
+        static std::shared_ptr<SharedSegment> create( const std::string& name, mxClassID cls, bool cplx,
+            const std::vector<index_t>& dims );
+
+        // attach an existing segment
+        static std::shared_ptr<SharedSegment> attach( const std::string& name, bool readonly=true );
+
+        // unlink a segment by name, regardless of references
+        static bool remove( const std::string& name );
+
+        ~SharedSegment();
+
+        SharedSegment( const SharedSegment& ) = delete;
+        SharedSegment& operator= ( const SharedSegment& ) = delete;
+
+        inline const std::string& name() const { return m_name; }
+        inline bool readonly() const { return m_readonly; }
+        inline void* data() const { return m_base + m_head->offset; }
+        inline index_t bytes() const { return m_head->bytes; }
+        inline index_t refs() const { return m_head->refs.load(); }
+
+        inline mxClassID classid() const { return static_cast<mxClassID>(m_head->cls); }
+        inline bool is_complex() const { return m_head->complex; }
+        inline index_t ndims() const { return m_head->ndims; }
+        inline index_t dim( index_t k ) const { return k < ndims() ? m_head->dims[k] : 1; }
+        index_t numel() const;
+
+        // type of the data, and number of dimensions (at most)
+        template <class T>
+        void check( index_t nd ) const
+        {
+            JMX_ASSERT( classid() == cpp2mex<T>::classid && is_complex() == jmx_types::is_complex<T>::value,
+                "Shared segment '%s' has a different type.", m_name.c_str() );
+            for ( index_t k = nd; k < ndims(); ++k )
+                JMX_ASSERT( dim(k) == 1, "Shared segment '%s' has too many dimensions.", m_name.c_str() );
+        }
+
+    private:
+
+        SharedSegment( const std::string& name, uint8_t *base, index_t size, bool readonly )
+            : m_name(name), m_base(base), m_size(size), m_readonly(readonly),
+              m_head(reinterpret_cast<Header*>(base)) {}
+
+        std::string m_name;
+        uint8_t *m_base;
+        index_t m_size;
+        bool m_readonly;
+        Header *m_head;
+    };
+
+    // unique name for anonymous segments
+    std::string shared_name();
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * Memory policies backed by shared segments; copies of a container share the segment,
+     * which is released with the last copy (or explicitly with free).
+     */
+    template <class T>
+    struct SharedMemory : public AbstractMemory<T>
+    {
+        using value_type = T;
+        std::shared_ptr<SharedSegment> segment;
+
+        void alloc( index_t n )
+        {
+            segment = SharedSegment::create( shared_name(), cpp2mex<T>::classid,
+                jmx_types::is_complex<T>::value, {n,1} );
+            this->assign( static_cast<T*>(segment->data()), n );
+        }
+
+        void free()
+            { segment.reset(); this->clear(); }
+
+        inline const char* name() const { return segment ? segment->name().c_str() : ""; }
+        inline T& operator[] ( index_t k ) const { return this->data[k]; }
+    };
+
+    template <class T>
+    struct SharedReadOnlyMemory : public AbstractMemory<T>
+    {
+        using value_type = typename std::add_const<T>::type;
+        std::shared_ptr<SharedSegment> segment;
+
+        void alloc( index_t n )
+            { JMX_THROW( "Read-only memory cannot be allocated." ); }
+
+        void free()
+            { segment.reset(); this->clear(); }
+
+        inline const char* name() const { return segment ? segment->name().c_str() : ""; }
+        inline value_type& operator[] ( index_t k ) const { return this->data[k]; }
+    };
+
+    template <class T> using Vector_sh = Vector<T, SharedMemory<T> >;
+    template <class T> using Matrix_sh = Matrix<T, SharedMemory<T> >;
+    template <class T> using Volume_sh = Volume<T, SharedMemory<T> >;
+
+    template <class T> using Vector_shro = Vector<T, SharedReadOnlyMemory<T> >;
+    template <class T> using Matrix_shro = Matrix<T, SharedReadOnlyMemory<T> >;
+    template <class T> using Volume_shro = Volume<T, SharedReadOnlyMemory<T> >;
+
+    // ----------  =====  ----------
+
+    // create named segments, with the shape of the container
+    template <class T>
+    Matrix_sh<T> shared_matrix( const std::string& name, index_t nr, index_t nc )
+    {
+        Matrix_sh<T> out;
+        out.mem.segment = SharedSegment::create( name, cpp2mex<T>::classid,
+            jmx_types::is_complex<T>::value, {nr,nc} );
+        out.assign( static_cast<T*>(out.mem.segment->data()), nr, nc );
+        return out;
+    }
+
+    template <class T>
+    Volume_sh<T> shared_volume( const std::string& name, index_t nr, index_t nc, index_t ns )
+    {
+        Volume_sh<T> out;
+        out.mem.segment = SharedSegment::create( name, cpp2mex<T>::classid,
+            jmx_types::is_complex<T>::value, {nr,nc,ns} );
+        out.assign( static_cast<T*>(out.mem.segment->data()), nr, nc, ns );
+        return out;
+    }
+
+    // attach named segments read-only, checking their type
+    template <class T>
+    Vector_shro<T> attach_vector( const std::string& name )
+    {
+        Vector_shro<T> out;
+        out.mem.segment = SharedSegment::attach(name);
+        out.mem.segment->template check<T>(2);
+        JMX_ASSERT( out.mem.segment->dim(0) == 1 || out.mem.segment->dim(1) == 1, "Not a vector." );
+        out.assign( static_cast<T*>(out.mem.segment->data()), out.mem.segment->numel() );
+        return out;
+    }
+
+    template <class T>
+    Matrix_shro<T> attach_matrix( const std::string& name )
+    {
+        Matrix_shro<T> out;
+        out.mem.segment = SharedSegment::attach(name);
+        out.mem.segment->template check<T>(2);
+        out.assign( static_cast<T*>(out.mem.segment->data()), out.mem.segment->dim(0), out.mem.segment->dim(1) );
+        return out;
+    }
+
+    template <class T>
+    Volume_shro<T> attach_volume( const std::string& name )
+    {
+        Volume_shro<T> out;
+        out.mem.segment = SharedSegment::attach(name);
+        out.mem.segment->template check<T>(3);
+        out.assign( static_cast<T*>(out.mem.segment->data()),
+            out.mem.segment->dim(0), out.mem.segment->dim(1), out.mem.segment->dim(2) );
+        return out;
+    }
+
+    // ----------  =====  ----------
+
+    /**
+     * Copy a numeric or logical array into a new named segment, kept alive by a persistent
+     * object of the calling Mex file (see handles.h); destroy the handle to release it.
+     */
+    JMX_LOCAL inline handle_t publish_shared( const std::string& name, const mxArray *ms )
+    {
+        JMX_ASSERT( ms, "Null pointer." );
+        JMX_ASSERT( (mxIsNumeric(ms) || mxIsLogical(ms)) && !mxIsSparse(ms),
+            "Only dense numeric or logical arrays can be shared." );
+
+        const mwSize *d = mxGetDimensions(ms);
+        auto seg = SharedSegment::create( name, mxGetClassID(ms), mxIsComplex(ms),
+            std::vector<index_t>( d, d + mxGetNumberOfDimensions(ms) ) );
+
+    #if MX_HAS_INTERLEAVED_COMPLEX
+        std::memcpy( seg->data(), mxGetData(ms), seg->bytes() );
+    #else
+        const index_t n = mxGetNumberOfElements(ms), esize = class_size(mxGetClassID(ms));
+        // complex data is interleaved in shared segments
+        if ( mxIsComplex(ms) ) {
+            const uint8_t *re = static_cast<const uint8_t*>(mxGetData(ms));
+            const uint8_t *im = static_cast<const uint8_t*>(mxGetImagData(ms));
+            uint8_t *out = static_cast<uint8_t*>(seg->data());
+            for ( index_t k = 0; k < n; ++k ) {
+                std::memcpy( out + 2*k*esize, re + k*esize, esize );
+                std::memcpy( out + (2*k+1)*esize, im + k*esize, esize );
+            }
+        }
+        else std::memcpy( seg->data(), mxGetData(ms), n*esize );
+    #endif
+
+        return create_handle( seg, seg->bytes(), "shared:" + seg->name() );
+    }
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef JMX_SNAPSHOT_H_INCLUDED
+#define JMX_SNAPSHOT_H_INCLUDED
+
+//==================================================
+// @title        snapshot.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Binary snapshots of mxArray trees (numeric, logical, char, sparse, struct and cell),
+ * for fast checkpointing without libmat:
+ *
+ *      save_snapshot( "result.jmx", ms );          // or save_snapshot( ..., true ) to compress
+ *
+ *      Snapshot s("result.jmx");                   // mmap
+ *      auto x = s.mat<double>( s.field(s.root(),"x") );   // zero-copy Matrix_ro
+ *      mxArray *y = s.materialize( s.field(s.root(),"y") );
+ *
+ * Layout: a header of 64 bytes, the data segments (each aligned to 64 bytes), then the
+ * tables of nodes and segments, the dimensions and the field names. Nodes are numbered
+ * breadth-first from the root (0), and the children of a node (cell elements, or the
+ * fields of each struct element) are contiguous.
+ * The tables are validated when the file is opened (sizes of the segments against the
+ * dimensions of each node), so corrupt or truncated files throw instead of being read
+ * out of bounds.
+ *
+ * Compressed segments are split in chunks of JMX_SNAPSHOT_CHUNK bytes, which are
+ * byte-shuffled by element size and run-length encoded (chunks which do not compress
+ * are stored as is). Chunks are compressed and written in parallel, and decompressed in
+ * parallel on first access.
+ */
+namespace jmx {
+
+    #ifndef JMX_SNAPSHOT_CHUNK
+    #define JMX_SNAPSHOT_CHUNK (1 << 20)
+    #endif
+
+    // write an mxArray tree to file (throws on error)
+    void save_snapshot( const char *path, const mxArray *ms, bool compress=false );
+
+    // ------------------------------------------------------------------------
+
+    class Snapshot
+    {
+    public:
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version, flags;
+            uint64_t nnodes, nsegs, ndims, nnames, tables, bytes;
+        };
+
+        struct Node
+        {
+            int32_t cls;        // mxClassID, or -1 for empty slots in struct or cell arrays
+            uint32_t flags;
+            uint32_t ndims, nfields, nseg, _pad;
+            uint64_t dims, child, nchild, names, seg;
+        };
+
+        struct Segment
+        {
+            uint64_t offset, bytes, stored;
+            uint32_t esize, flags;
+        };
+
+        enum : uint32_t {
+            Complex = 1, Sparse = 2,        // node flags
+            Compressed = 1,                 // segment flags
+            Interleaved = 1                 // header flags
+        };
+
+        Snapshot()
+            : m_data(nullptr), m_size(0) {}
+        Snapshot( const char *path )
+            : m_data(nullptr), m_size(0) { open(path); }
+        ~Snapshot()
+            { close(); }
+
+        Snapshot( const Snapshot& ) = delete;
+        Snapshot& operator= ( const Snapshot& ) = delete;
+
+        bool open( const char *path );
+        void close();
+
+        inline bool valid() const { return m_data; }
+        inline index_t size() const { return m_node.size(); }
+        inline index_t root() const { return 0; }
+        inline const Node& node( index_t n ) const { return m_node.at(n); }
+
+        // ----------  =====  ----------
+
+        inline mxClassID classid( index_t n ) const { return static_cast<mxClassID>(node(n).cls); }
+        inline bool is_complex( index_t n ) const { return node(n).flags & Complex; }
+        inline bool is_sparse( index_t n ) const { return node(n).flags & Sparse; }
+        inline bool is_struct( index_t n ) const { return node(n).cls == mxSTRUCT_CLASS; }
+        inline bool is_cell( index_t n ) const { return node(n).cls == mxCELL_CLASS; }
+
+        inline index_t ndims( index_t n ) const { return node(n).ndims; }
+        inline index_t dim( index_t n, index_t k ) const { return k < ndims(n) ? m_dims[ node(n).dims + k ] : 1; }
+        index_t numel( index_t n ) const;
+
+        // struct fields
+        inline index_t nfields( index_t n ) const { return node(n).nfields; }
+        inline const char* field_name( index_t n, index_t f ) const { return m_fields.at(n).at(f); }
+        bool has_field( index_t n, const char *name ) const;
+        index_t field( index_t n, const char *name, index_t elem=0 ) const;
+
+        // k-th child (cell element, or struct element*nfields + field)
+        index_t child( index_t n, index_t k ) const;
+
+        // ----------  =====  ----------
+
+        // zero-copy access to numeric data (decompressed once if needed)
+        template <class T> Vector_ro<T> vec( index_t n ) const;
+        template <class T> Matrix_ro<T> mat( index_t n ) const;
+        template <class T> Volume_ro<T> vol( index_t n ) const;
+
+        // create an mxArray (copy) for a node and its children
+        mxArray* materialize( index_t n=0 ) const;
+
+    private:
+
+        template <class T> const T* _numeric( index_t n ) const;
+        const void* _segment( index_t s ) const;
+
+        const uint8_t *m_data;
+        index_t m_size;
+        Header m_head;
+
+        std::vector<Node> m_node;
+        std::vector<Segment> m_seg;
+        std::vector<uint64_t> m_dims;
+        std::vector<std::vector<const char*>> m_fields;
+
+        // decompressed segments
+        mutable std::mutex m_mutex;
+        mutable std::unordered_map< index_t, std::unique_ptr<uint8_t[]> > m_unpacked;
+    };
+
+    // ------------------------------------------------------------------------
+
+    template <class T>
+    const T* Snapshot::_numeric( index_t n ) const
+    {
+        const Node& x = node(n);
+        JMX_ASSERT( x.cls == cpp2mex<T>::classid && bool(x.flags & Complex) == jmx_types::is_complex<T>::value,
+            "Incompatible types." );
+        JMX_ASSERT( !(x.flags & Sparse), "Sparse node." );
+        JMX_REJECT( jmx_types::is_complex<T>::value && !(m_head.flags & Interleaved),
+            "Complex data is stored separately in this snapshot; use materialize instead." );
+        return static_cast<const T*>( _segment(x.seg) );
+    }
+
+    template <class T>
+    Vector_ro<T> Snapshot::vec( index_t n ) const
+    {
+        JMX_ASSERT( ndims(n) == 2 && (dim(n,0) == 1 || dim(n,1) == 1), "Not a vector." );
+        return Vector_ro<T>( const_cast<T*>(_numeric<T>(n)), numel(n) );
+    }
+
+    template <class T>
+    Matrix_ro<T> Snapshot::mat( index_t n ) const
+    {
+        JMX_ASSERT( ndims(n) == 2, "Not a matrix." );
+        return Matrix_ro<T>( const_cast<T*>(_numeric<T>(n)), dim(n,0), dim(n,1) );
+    }
+
+    template <class T>
+    Volume_ro<T> Snapshot::vol( index_t n ) const
+    {
+        JMX_ASSERT( ndims(n) <= 3, "Not a volume." );
+        return Volume_ro<T>( const_cast<T*>(_numeric<T>(n)), dim(n,0), dim(n,1), dim(n,2) );
+    }
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef JMX_SPARSE_H_INCLUDED
+#define JMX_SPARSE_H_INCLUDED
+
+//==================================================
+// @title        sparse.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include "memory.h"
+
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+namespace jmx {
+
+    /**
+     * Sparse matrix in compressed sparse column (CSC) format, as stored by Matlab:
+     *  - val[k]   value of the k-th non-zero,
+     *  - ir[k]    row of the k-th non-zero,
+     *  - jc[c]    index of the first non-zero in column c (jc[nc] is the number of non-zeros).
+     *
+     * The row indices and column offsets use the same memory policy as the values,
+     * so SparseMatrix_ro wraps the arrays of an input without copy.
+     */
+    template <class T, class M = CppMemory<T> >
+    struct SparseMatrix
+    {
+        using value_type = typename M::value_type;
+        using index_memory = typename rebind_memory<M,index_t>::type;
+        using index_type = typename index_memory::value_type;
+
+        index_t nr, nc;
+        M val;
+        index_memory ir, jc;
+
+        SparseMatrix()
+            { clear(); }
+        SparseMatrix( index_t nrows, index_t ncols, index_t nzmax )
+            { alloc(nrows,ncols,nzmax); }
+        SparseMatrix( T *v, index_t *r, index_t *c, index_t nrows, index_t ncols, index_t nzmax )
+            { assign(v,r,c,nrows,ncols,nzmax); }
+
+        inline index_t ndims() const { return 2; }
+        inline index_t nrows() const { return nr; }
+        inline index_t ncols() const { return nc; }
+        inline index_t nzmax() const { return val.size; }
+        inline index_t nnz() const { return jc.data ? jc[nc] : 0; }
+
+        inline void clear()
+            { val.clear(); ir.clear(); jc.clear(); nr = nc = 0; }
+        inline void free()
+            { val.free(); ir.free(); jc.free(); clear(); }
+
+        inline void assign( T *v, index_t *r, index_t *c, index_t nrows, index_t ncols, index_t nzmax ) {
+            val.assign(v,nzmax); ir.assign(r,nzmax); jc.assign(c,ncols+1);
+            nr = nrows; nc = ncols;
+        }
+        inline void alloc( index_t nrows, index_t ncols, index_t nzmax ) {
+            val.alloc(nzmax); ir.alloc(nzmax); jc.alloc(ncols+1);
+            nr = nrows; nc = ncols;
+        }
+
+        // non-zeros of column c are in [col_begin(c), col_end(c))
+        inline index_t col_begin( index_t c ) const { return jc[c]; }
+        inline index_t col_end( index_t c ) const { return jc[c+1]; }
+        inline index_t col_nnz( index_t c ) const { return jc[c+1] - jc[c]; }
+
+        inline index_type& row( index_t k ) const { return ir[k]; }
+        inline value_type& value( index_t k ) const { return val[k]; }
+
+        // random access (binary search in column c), zero if the element is not stored
+        T operator() ( index_t r, index_t c ) const
+        {
+            const index_t *b = ir.data + jc[c];
+            const index_t *e = ir.data + jc[c+1];
+            const index_t *p = std::lower_bound( b, e, r );
+            return (p != e && *p == r) ? val[ p - ir.data ] : T(0);
+        }
+    };
+
+    template <class T> using SparseMatrix_ro = SparseMatrix<T, ReadOnlyMemory<T> >;
+    template <class T> using SparseMatrix_mx = SparseMatrix<T, MatlabMemory<T> >;
+
+}
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef JMX_STREAM_H_INCLUDED
+#define JMX_STREAM_H_INCLUDED
+
+//==================================================
+// @title        stream.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Stream a volume in slabs of consecutive slices, processed by the workers of the runtime
+ * pool, with a bounded number of slabs in flight:
+ *
+ *      SlabStream<float> s( vol, 16 );                 // or s( "stack.bin", nr, nc, ns, 16 )
+ *      s.run(
+ *          []( const Slab<float>& b, index_t tid ) { ... },    // on a worker
+ *          []( const Slab<float>& b ) { ... },                 // on the calling thread
+ *          true                                                // in order
+ *      );
+ *
+ * The next slabs are prefetched while the current ones are processed: pages of containers
+ * (in memory or mapped, see mmap.h) are requested with madvise(WILLNEED), and files with
+ * posix_fadvise(WILLNEED). With staging (always for files), slabs are first copied into
+ * aligned scratch buffers from the runtime arena, which are reused across slabs.
+ *
+ * The completion callback runs on the calling thread (so it can use the Mex API), either
+ * in slab order, or as soon as each slab is done.
+ *
+ * The tid passed to process is the slot of the slab in flight, which is unique among the
+ * slabs processed concurrently, and smaller than depth(); use it to index per-slot buffers.
+ */
+namespace jmx {
+
+    // hints that a range will be needed soon (errors are ignored)
+    void prefetch_memory( const void *ptr, index_t bytes );
+    void prefetch_file( int fd, index_t offset, index_t bytes );
+
+    // read exactly bytes from offset (throws on error)
+    void read_file( int fd, void *buf, index_t bytes, index_t offset );
+
+    // ------------------------------------------------------------------------
+
+    template <class T>
+    struct Slab
+    {
+        index_t index;          // slab number
+        index_t first, count;   // slices [first, first+count)
+        Volume_ro<T> data;      // nrows x ncols x count
+    };
+
+    template <class T>
+    class SlabStream
+    {
+    public:
+
+        // stream a container; slabs are views of its memory unless staged
+        template <class M>
+        SlabStream( const Volume<T,M>& vol, index_t nslices, bool stage=false )
+            : m_ptr(vol.memptr()), m_fd(-1), m_offset(0), m_stage(stage)
+            { _init( vol.nr, vol.nc, vol.ns, nslices ); }
+
+        // stream a raw binary file (column-major, native endianness)
+        SlabStream( const std::string& path, index_t nr, index_t nc, index_t ns, index_t nslices, index_t offset=0 );
+
+        ~SlabStream();
+
+        SlabStream( const SlabStream& ) = delete;
+        SlabStream& operator= ( const SlabStream& ) = delete;
+
+        inline index_t nslabs() const { return (m_ns + m_slab - 1) / m_slab; }
+        inline index_t slab_size() const { return m_slab; }
+
+        // maximum number of slabs in flight (default: workers + 2)
+        inline index_t depth() const { return m_depth; }
+        inline void set_depth( index_t d ) { m_depth = std::max<index_t>(d,1); }
+
+        template <class F, class G>
+        void run( F&& process, G&& complete, bool ordered=true );
+
+        template <class F>
+        void run( F&& process )
+            { run( std::forward<F>(process), []( const Slab<T>& ) {}, false ); }
+
+    private:
+
+        void _init( index_t nr, index_t nc, index_t ns, index_t nslices )
+        {
+            JMX_ASSERT( nslices > 0, "Slabs should contain at least one slice." );
+            m_nr = nr; m_nc = nc; m_ns = ns;
+            m_slab = nslices;
+            m_depth = runtime().pool().size() + 2;
+        }
+
+        inline index_t _first( index_t k ) const { return k*m_slab; }
+        inline index_t _count( index_t k ) const { return std::min( m_slab, m_ns - k*m_slab ); }
+        inline index_t _bytes( index_t k ) const { return m_nr*m_nc*_count(k)*sizeof(T); }
+        inline index_t _pos( index_t k ) const { return m_nr*m_nc*_first(k); }
+
+        void _prefetch( index_t k ) const;
+        const T* _load( index_t k, T *buf ) const;
+
+        const T *m_ptr;
+        int m_fd;
+        index_t m_offset;
+        bool m_stage;
+        index_t m_nr, m_nc, m_ns, m_slab, m_depth;
+    };
+
+    // ------------------------------------------------------------------------
+
+    template <class T>
+    SlabStream<T>::SlabStream( const std::string& path, index_t nr, index_t nc, index_t ns, index_t nslices, index_t offset )
+        : m_ptr(nullptr), m_fd(-1), m_offset(offset), m_stage(true)
+    {
+        _init( nr, nc, ns, nslices );
+        m_fd = ::open( path.c_str(), O_RDONLY );
+        JMX_ASSERT( m_fd >= 0, "Error opening file: %s", path.c_str() );
+    }
+
+    template <class T>
+    SlabStream<T>::~SlabStream()
+    {
+        if ( m_fd >= 0 ) ::close(m_fd);
+    }
+
+    template <class T>
+    void SlabStream<T>::_prefetch( index_t k ) const
+    {
+        if ( k >= nslabs() ) return;
+        if ( m_fd >= 0 )
+            prefetch_file( m_fd, m_offset + _pos(k)*sizeof(T), _bytes(k) );
+        else
+            prefetch_memory( m_ptr + _pos(k), _bytes(k) );
+    }
+
+    template <class T>
+    const T* SlabStream<T>::_load( index_t k, T *buf ) const
+    {
+        JMX_TRACE_SCOPE( "slab_load", "io" );
+        if ( m_fd >= 0 )
+            read_file( m_fd, buf, _bytes(k), m_offset + _pos(k)*sizeof(T) );
+        else if ( m_stage )
+            std::copy( m_ptr + _pos(k), m_ptr + _pos(k) + m_nr*m_nc*_count(k), buf );
+        else
+            return m_ptr + _pos(k);
+        return buf;
+    }
+
+    template <class T>
+    template <class F, class G>
+    void SlabStream<T>::run( F&& process, G&& complete, bool ordered )
+    {
+        const index_t ns = nslabs();
+        const index_t nbuf = m_stage ? m_nr*m_nc*m_slab : 0;
+        if ( ns == 0 ) return;
+
+        // nested in a worker, or without workers: serial
+        if ( is_worker_thread() || runtime().pool().size() == 0 )
+        {
+            std::unique_ptr<Scratch<T>> buf( nbuf ? new Scratch<T>( runtime().arena(), nbuf ) : nullptr );
+            for ( index_t k = 0; k < ns; ++k ) {
+                _prefetch(k+1);
+                Slab<T> s{ k, _first(k), _count(k),
+                    Volume_ro<T>( const_cast<T*>(_load( k, buf ? buf->data() : nullptr )), m_nr, m_nc, _count(k) ) };
+                { JMX_TRACE_SCOPE( "slab_process", "stream" ); process( s, 0 ); }
+                { JMX_TRACE_SCOPE( "slab_complete", "stream" ); complete( s ); }
+            }
+            return;
+        }
+
+        Runtime& rt = runtime();
+        ++rt.counters().loops;
+        rt.counters().tasks += ns;
+
+        // one staging buffer per slab in flight
+        const index_t depth = std::min( m_depth, ns );
+        std::vector< std::unique_ptr<Scratch<T>> > buffers;
+        std::vector<index_t> free_buffers;
+        for ( index_t b = 0; b < depth; ++b ) {
+            buffers.emplace_back( nbuf ? new Scratch<T>( rt.arena(), nbuf ) : nullptr );
+            free_buffers.push_back(b);
+        }
+
+        std::vector< std::unique_ptr<Slab<T>> > slabs(ns);
+        std::vector<index_t> slab_buffer(ns);
+        std::vector<char> finished(ns,0);
+        std::deque<index_t> done;
+        std::mutex mutex;
+        std::condition_variable cv;
+        ErrorChannel errors;
+
+        auto task = [&,this]( index_t k, index_t tid ) {
+            const ErrorChannel*& current = _thread_channel();
+            const ErrorChannel *outer = current;
+            current = &errors;
+
+            try {
+                if ( !errors.cancelled() ) {
+                    Scratch<T> *buf = buffers[ slab_buffer[k] ].get();
+                    const T *ptr = _load( k, buf ? buf->data() : nullptr );
+                    slabs[k].reset(new Slab<T>{ k, _first(k), _count(k),
+                        Volume_ro<T>( const_cast<T*>(ptr), m_nr, m_nc, _count(k) ) });
+
+                    JMX_TRACE_SCOPE( "slab_process", "stream" );
+                    process( *slabs[k], tid );
+                }
+            } catch (...) {
+                errors.capture();
+            }
+
+            current = outer;
+            console_flush();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push_back(k);
+            }
+            cv.notify_one();
+        };
+
+        ThreadPool& pool = rt.pool();
+        index_t next = 0, inflight = 0, ncomplete = 0;
+        try
+        {
+            while ( ncomplete < ns || inflight > 0 )
+            {
+                // submit slabs while buffers are available
+                while ( next < ns && !free_buffers.empty() && !errors.cancelled() ) {
+                    const index_t k = next++;
+                    slab_buffer[k] = free_buffers.back();
+                    free_buffers.pop_back();
+                    _prefetch(k+1);
+
+                    const index_t tid = slab_buffer[k];
+                    pool.submit( [&task,k,tid]() { task(k,tid); } );
+                    ++inflight;
+                }
+                if ( inflight == 0 ) break;
+
+                std::deque<index_t> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait( lock, [&done](){ return !done.empty(); } );
+                    batch.swap(done);
+                }
+                inflight -= batch.size();
+                console().drain();
+
+                // complete in order, or as soon as done
+                for ( index_t k: batch ) {
+                    finished[k] = 1;
+                    if ( !ordered && !errors.cancelled() ) {
+                        JMX_TRACE_SCOPE( "slab_complete", "stream" );
+                        complete( *slabs[k] );
+                        ++ncomplete;
+                    }
+                    if ( !ordered ) {
+                        free_buffers.push_back( slab_buffer[k] );
+                        slabs[k].reset();
+                    }
+                }
+                if ( ordered )
+                    while ( ncomplete < ns && finished[ncomplete] ) {
+                        const index_t k = ncomplete++;
+                        if ( !errors.cancelled() ) {
+                            JMX_TRACE_SCOPE( "slab_complete", "stream" );
+                            complete( *slabs[k] );
+                        }
+                        free_buffers.push_back( slab_buffer[k] );
+                        slabs[k].reset();
+                    }
+            }
+        }
+        catch (...) {
+            // error on the calling thread: cancel, and wait for the slabs in flight
+            errors.capture();
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait( lock, [&](){ inflight -= done.size(); done.clear(); return inflight == 0; } );
+        }
+
+        console_flush();
+        errors.rethrow();
+    }
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef JMX_STRINGS_H_INCLUDED
+#define JMX_STRINGS_H_INCLUDED
+
+//==================================================
+// @title        strings.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <ostream>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+// ------------------------------------------------------------------------
+
+/**
+ * Matlab stores characters as UTF-16 code units (mxChar). Reading a cellstr with get_string
+ * allocates one std::string per element; instead, CellStr reads the mxChar data of all
+ * elements directly, and transcodes it to UTF-8 in parallel into one contiguous buffer
+ * (ASCII runs are converted with SSE2). Elements are exposed as string_view, and are also
+ * null-terminated.
+ *
+ * Conversely, make_cellstr (or mkcellstr) creates a cellstr from a vector of strings or
+ * string_views; the elements are allocated first, and transcoded in parallel.
+ */
+namespace jmx {
+
+#if __cplusplus >= 201703L
+
+    using string_view = std::string_view;
+
+#else
+
+    // minimal version of std::string_view
+    class string_view
+    {
+    public:
+
+        using value_type = char;
+        using const_iterator = const char*;
+
+        string_view()
+            : m_data(nullptr), m_size(0) {}
+        string_view( const char *s )
+            : m_data(s), m_size(std::strlen(s)) {}
+        string_view( const char *s, index_t n )
+            : m_data(s), m_size(n) {}
+        string_view( const std::string& s )
+            : m_data(s.data()), m_size(s.size()) {}
+
+        inline const char* data() const { return m_data; }
+        inline index_t size() const { return m_size; }
+        inline index_t length() const { return m_size; }
+        inline bool empty() const { return m_size == 0; }
+
+        inline const char* begin() const { return m_data; }
+        inline const char* end() const { return m_data + m_size; }
+        inline const char& operator[] ( index_t k ) const { return m_data[k]; }
+
+        inline std::string to_string() const { return std::string(m_data,m_size); }
+        inline explicit operator std::string() const { return to_string(); }
+
+        inline int compare( const string_view& that ) const {
+            const int c = std::memcmp( m_data, that.m_data, std::min(m_size,that.m_size) );
+            return c ? c : (m_size < that.m_size ? -1 : (m_size > that.m_size));
+        }
+
+    private:
+        const char *m_data;
+        index_t m_size;
+    };
+
+    inline bool operator== ( const string_view& a, const string_view& b )
+        { return a.size() == b.size() && std::memcmp( a.data(), b.data(), a.size() ) == 0; }
+    inline bool operator!= ( const string_view& a, const string_view& b ) { return !(a == b); }
+    inline bool operator< ( const string_view& a, const string_view& b ) { return a.compare(b) < 0; }
+
+    inline std::ostream& operator<< ( std::ostream& os, const string_view& s )
+        { return os.write( s.data(), s.size() ); }
+
+#endif
+
+    // FNV-1a hash of a string (same as hash_name)
+    inline uint64_t hash_string( const char *s, index_t n ) {
+        uint64_t h = 14695981039346656037ULL;
+        for ( index_t k = 0; k < n; ++k ) h = (h ^ static_cast<uint8_t>(s[k])) * 1099511628211ULL;
+        return h;
+    }
+    inline uint64_t hash_string( const string_view& s ) { return hash_string( s.data(), s.size() ); }
+
+    // ------------------------------------------------------------------------
+
+    /**
+     * Conversions between UTF-16 and UTF-8. The lengths are in code units (mxChar or char).
+     * Invalid sequences (e.g. unpaired surrogates) are replaced with U+FFFD.
+     */
+    index_t utf8_length( const mxChar *in, index_t n );
+    char* utf16_to_utf8( const mxChar *in, index_t n, char *out );
+
+    index_t utf16_length( const char *in, index_t n );
+    mxChar* utf8_to_utf16( const char *in, index_t n, mxChar *out );
+
+    // ----------  =====  ----------
+
+    class CellStr
+    {
+    public:
+
+        CellStr() {}
+        CellStr( const mxArray *ms )
+            { wrap(ms); }
+
+        // cell of char row-vectors (or empty chars)
+        void wrap( const mxArray *ms );
+        void clear();
+
+        inline index_t size() const { return m_off.empty() ? 0 : m_off.size()-1; }
+        inline bool empty() const { return size() == 0; }
+
+        // total number of bytes in the buffer (including terminating nulls)
+        inline index_t nbytes() const { return m_buf.size(); }
+
+        inline index_t length( index_t k ) const { return m_off[k+1] - m_off[k] - 1; }
+        inline const char* c_str( index_t k ) const { return m_buf.data() + m_off[k]; }
+        inline string_view operator[] ( index_t k ) const { return string_view( c_str(k), length(k) ); }
+
+        std::vector<string_view> views() const;
+        std::vector<uint64_t> hashes() const;
+
+        /**
+         * Interning (e.g. for categorical data): each element is assigned the 0-based code
+         * of its label, and labels are listed in order of first occurrence.
+         * Returns the number of distinct labels.
+         */
+        index_t intern( std::vector<index_t>& codes, std::vector<string_view>& labels ) const;
+
+    private:
+        std::vector<char> m_buf;
+        std::vector<index_t> m_off;
+    };
+
+    inline CellStr get_cellstr( const mxArray *ms ) {
+        return CellStr(ms);
+    }
+
+    // ----------  =====  ----------
+
+    // create a 1xn cellstr from a vector of std::string or string_view
+    template <class S>
+    mxArray* make_cellstr( const std::vector<S>& strs )
+    {
+        const index_t n = strs.size();
+
+        // UTF-16 lengths
+        std::vector<index_t> len(n);
+        parallel_for( 0, n, [&]( index_t k ) {
+            len[k] = utf16_length( strs[k].data(), strs[k].size() );
+        });
+
+        // allocate on the calling thread
+        mxArray *out = make_cell(n);
+        std::vector<mxChar*> dst(n);
+        for ( index_t k = 0; k < n; ++k ) {
+            const index_t size[2] = { len[k] ? 1u : 0u, len[k] };
+            mxArray *s = mxCreateCharArray( 2, size );
+            dst[k] = mxGetChars(s);
+            mxSetCell( out, k, s );
+        }
+
+        parallel_for( 0, n, [&]( index_t k ) {
+            utf8_to_utf16( strs[k].data(), strs[k].size(), dst[k] );
+        });
+        return out;
+    }
+
+    // forwarded from extractor.h and creator.h
+    template <class K>
+    inline CellStr Extractor<K>::getcellstr( key_t k ) { return get_cellstr(_extractor_get(k)); }
+
+    template <class K>
+    template <class S>
+    inline mxArray* Creator<K>::mkcellstr( key_t k, const std::vector<S>& strs ) {
+        return _creator_assign(k, make_cellstr(strs));
+    }
+
+}
+
+#endif
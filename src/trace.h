@@ -0,0 +1,93 @@
+#ifndef JMX_TRACE_H_INCLUDED
+#define JMX_TRACE_H_INCLUDED
+
+//==================================================
+// @title        trace.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Timeline of events per thread, exported as Chrome trace-event JSON (chrome://tracing,
+ * or ui.perfetto.dev), to diagnose load imbalance and serialisation:
+ *
+ *      JMX_COMMAND(start) { jmx::trace_start(); }           // optional capacity per thread
+ *      JMX_COMMAND(stop)  { jmx::trace_write( args.getstr(0) ); jmx::trace_stop(); }
+ *
+ *      JMX_TRACE_SCOPE( "solve", "kernel" );               // name and category (literals)
+ *
+ * Each thread records complete events (start, duration) into its own ring buffer of fixed
+ * capacity (JMX_TRACE_CAPACITY events by default), without locks; the oldest events are
+ * overwritten when the buffer is full. When tracing is off, a scope costs one relaxed load.
+ * Names are copied by the runtime when first recorded, so the trace can still be written
+ * after the Mex file which recorded them is cleared.
+ *
+ * Tasks of the thread pool, chunks of parallel loops, stages of slab streams and snapshots,
+ * and profiled scopes (see profile.h) are recorded.
+ */
+
+#ifndef JMX_TRACE_CAPACITY
+#define JMX_TRACE_CAPACITY 65536    // events per thread
+#endif
+
+#define JMX_TRACE_SCOPE( name, cat ) \
+    jmx::TraceScope JMX_CONCAT(_jmx_trace_,__LINE__)( name, cat )
+
+namespace jmx {
+
+    using trace_clock = std::chrono::steady_clock;
+
+    inline std::atomic<bool>& _trace_flag() {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    inline bool trace_enabled() {
+        return _trace_flag().load( std::memory_order_relaxed );
+    }
+
+    // clear the buffers, and start recording (capacity in events per thread)
+    void trace_start( index_t capacity=JMX_TRACE_CAPACITY );
+    void trace_stop();
+
+    // write the events recorded so far (throws on error); recording is paused meanwhile
+    void trace_write( const std::string& path );
+
+    // number of events recorded since trace_start, and number overwritten
+    index_t trace_count();
+    index_t trace_dropped();
+
+    // record an event on the calling thread (name and cat should be literals)
+    void trace_event( const char *name, const char *cat, trace_clock::time_point start, trace_clock::time_point stop );
+
+    // ----------  =====  ----------
+
+    class TraceScope
+    {
+    public:
+
+        TraceScope( const char *name, const char *cat )
+            : m_name(trace_enabled() ? name : nullptr), m_cat(cat)
+            { if ( m_name ) m_start = trace_clock::now(); }
+
+        ~TraceScope()
+            { if ( m_name ) trace_event( m_name, m_cat, m_start, trace_clock::now() ); }
+
+        TraceScope( const TraceScope& ) = delete;
+        TraceScope& operator= ( const TraceScope& ) = delete;
+
+    private:
+
+        const char *m_name, *m_cat;
+        trace_clock::time_point m_start;
+    };
+
+}
+
+#endif
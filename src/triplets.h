@@ -0,0 +1,221 @@
+#ifndef JMX_TRIPLETS_H_INCLUDED
+#define JMX_TRIPLETS_H_INCLUDED
+
+//==================================================
+// @title        triplets.h
+// @author       Jonathan Hadida
+// @contact      Jhadida87 [at] gmail
+//==================================================
+
+#include <vector>
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+/**
+ * Assembly of sparse outputs from (row,col,value) triplets, with 0-based indices.
+ *
+ * Each thread of a parallel loop appends to its own buffer (indexed by the tid of
+ * parallel_chunks), so no synchronisation is needed. The buffers are then sorted into
+ * compressed columns in parallel (in-place bucketing by column range, counting sort by
+ * column, then sort by row within each column), and each buffer is released as soon as
+ * it is scattered; duplicates are summed (or OR-ed for logical matrices) and zeros are
+ * dropped, as with Matlab's sparse(). The output is allocated once, with the exact number
+ * of non-zeros.
+ *
+ *      SparseBuilder<double> sb( nr, nc );
+ *      parallel_chunks( 0, n, [&]( index_t b, index_t e, index_t tid ) {
+ *          for ( index_t k = b; k < e; ++k ) sb.add( tid, r[k], c[k], v[k] );
+ *      });
+ *      args.mksparse( 0, sb );
+ */
+
+#ifndef JMX_TRIPLETS_RANGES
+#define JMX_TRIPLETS_RANGES 8 // column ranges per thread during assembly
+#endif
+
+namespace jmx {
+
+    template <class T = real_t>
+    class SparseBuilder
+    {
+        static_assert( is_sparse_type<T>::value, "Sparse matrices should be double, complex double or bool." );
+
+    public:
+
+        using value_type = T;
+
+        SparseBuilder()
+            : m_nr(0), m_nc(0) {}
+        SparseBuilder( index_t nrows, index_t ncols )
+            { init(nrows,ncols); }
+
+        inline void init( index_t nrows, index_t ncols ) {
+            m_nr = nrows; m_nc = ncols;
+            m_buf.assign( runtime().nthreads(), Buffer() );
+        }
+
+        inline index_t nrows() const { return m_nr; }
+        inline index_t ncols() const { return m_nc; }
+        inline index_t nbuffers() const { return m_buf.size(); }
+
+        // number of triplets added so far
+        index_t size() const;
+
+        // expected number of triplets for one thread
+        inline void reserve( index_t tid, index_t n ) {
+            Buffer& b = m_buf[tid];
+            b.r.reserve(n); b.c.reserve(n); b.v.reserve(n);
+        }
+
+        inline void add( index_t tid, index_t r, index_t c, const T& v ) {
+            Buffer& b = m_buf[tid];
+            b.r.push_back(r); b.c.push_back(c); b.v.push_back(v);
+        }
+        inline void add( index_t r, index_t c, const T& v )
+            { add( 0, r, c, v ); }
+
+        // assemble a new sparse mxArray, and clear the buffers
+        mxArray* build();
+
+    private:
+
+        struct Buffer {
+            std::vector<index_t> r, c;
+            std::vector<T> v;
+            char _pad[64]; // avoid false sharing between threads
+        };
+
+        struct Entry {
+            index_t r; T v;
+            inline bool operator< ( const Entry& that ) const { return r < that.r; }
+        };
+
+        index_t m_nr, m_nc;
+        std::vector<Buffer> m_buf;
+    };
+
+    // ------------------------------------------------------------------------
+
+    template <class T>
+    index_t SparseBuilder<T>::size() const
+    {
+        index_t n = 0;
+        for ( auto& b: m_buf ) n += b.r.size();
+        return n;
+    }
+
+    template <class T>
+    mxArray* SparseBuilder<T>::build()
+    {
+        const index_t nb = m_buf.size();
+        const index_t nc = m_nc;
+
+        // columns are split into ranges, processed in parallel without a table per buffer
+        const index_t nrg = std::max<index_t>( 1, std::min<index_t>( nc, JMX_TRIPLETS_RANGES * runtime().nthreads() ) );
+        const index_t width = std::max<index_t>( 1, (nc + nrg-1) / nrg );
+
+        // sort each buffer by range in place; seg[t*(nrg+1)+j] is the start of range j in buffer t
+        std::vector<index_t> seg( nb*(nrg+1), 0 );
+        parallel_for( 0, nb, [&]( index_t t ) {
+            Buffer& b = m_buf[t];
+            index_t *off = &seg[t*(nrg+1)];
+            for ( index_t k = 0; k < b.r.size(); ++k ) {
+                JMX_ASSERT( b.r[k] < m_nr && b.c[k] < nc, "Index out of bounds (%zu,%zu).", b.r[k], b.c[k] );
+                ++off[ b.c[k]/width + 1 ];
+            }
+            for ( index_t j = 0; j < nrg; ++j ) off[j+1] += off[j];
+
+            std::vector<index_t> next( off, off+nrg );
+            for ( index_t j = 0; j < nrg; ++j )
+                while ( next[j] < off[j+1] ) {
+                    const index_t k = next[j], d = b.c[k]/width;
+                    if ( d != j ) {
+                        const index_t x = next[d]++;
+                        std::swap( b.r[k], b.r[x] );
+                        std::swap( b.c[k], b.c[x] );
+                        const T v = b.v[k]; b.v[k] = b.v[x]; b.v[x] = v; // vector<bool>
+                    }
+                    else ++next[j];
+                }
+        }, 1 );
+
+        // count the triplets in each column; col[c] is the start of column c
+        std::vector<index_t> col( nc+1, 0 );
+        parallel_for( 0, nrg, [&]( index_t j ) {
+            for ( index_t t = 0; t < nb; ++t ) {
+                const Buffer& b = m_buf[t];
+                const index_t *off = &seg[t*(nrg+1)];
+                for ( index_t k = off[j]; k < off[j+1]; ++k ) ++col[ b.c[k]+1 ];
+            }
+        }, 1 );
+        for ( index_t c = 0; c < nc; ++c ) col[c+1] += col[c];
+        const index_t n = col[nc];
+
+        // scatter each buffer into columns, and release it
+        std::vector<Entry> entry(n);
+        std::vector<index_t> pos( col.begin(), col.end()-1 );
+        for ( index_t t = 0; t < nb; ++t ) {
+            Buffer& b = m_buf[t];
+            const index_t *off = &seg[t*(nrg+1)];
+            parallel_for( 0, nrg, [&]( index_t j ) {
+                for ( index_t k = off[j]; k < off[j+1]; ++k )
+                    entry[ pos[b.c[k]]++ ] = Entry{ b.r[k], b.v[k] };
+            }, 1 );
+
+            std::vector<index_t>().swap(b.r);
+            std::vector<index_t>().swap(b.c);
+            std::vector<T>().swap(b.v);
+        }
+        std::vector<index_t>().swap(pos);
+
+        // sort rows within each column, sum duplicates and drop zeros (in place)
+        std::vector<index_t> nnz( nc+1, 0 );
+        parallel_chunks( 0, nc, [&]( index_t cb, index_t ce, index_t ) {
+            for ( index_t c = cb; c < ce; ++c ) {
+                Entry *b = entry.data() + col[c];
+                Entry *e = entry.data() + col[c+1];
+                std::sort( b, e );
+
+                Entry *out = b;
+                for ( Entry *p = b; p != e; ) {
+                    Entry acc = *p;
+                    for ( ++p; p != e && p->r == acc.r; ++p ) acc.v = acc.v + p->v;
+                    if ( acc.v != T(0) ) *out++ = acc;
+                }
+                nnz[c+1] = out - b;
+            }
+        });
+        for ( index_t c = 0; c < nc; ++c ) nnz[c+1] += nnz[c];
+
+        // allocate the output once, and copy the columns
+        mxArray *ms = make_sparse( m_nr, nc, std::max<index_t>(1,nnz[nc]), cpp2mex<T>::classid, complexity<T>() );
+        SparseMatrix_mx<T> S( data_ptr<T>(ms), mxGetIr(ms), mxGetJc(ms), m_nr, nc, mxGetNzmax(ms) );
+
+        S.jc[0] = 0;
+        parallel_chunks( 0, nc, [&]( index_t cb, index_t ce, index_t ) {
+            for ( index_t c = cb; c < ce; ++c ) {
+                const Entry *in = entry.data() + col[c];
+                for ( index_t k = nnz[c]; k < nnz[c+1]; ++k, ++in ) {
+                    S.ir[k] = in->r;
+                    S.val[k] = in->v;
+                }
+                S.jc[c+1] = nnz[c+1];
+            }
+        });
+
+        return ms;
+    }
+
+    // ----------  =====  ----------
+
+    // forwarded from creator.h
+    template <class K>
+    template <class T>
+    inline mxArray* Creator<K>::mksparse( key_t k, SparseBuilder<T>& b ) {
+        return _creator_assign(k, b.build());
+    }
+
+}
+
+#endif